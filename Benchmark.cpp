@@ -0,0 +1,246 @@
+#include <version>
+
+import sequence;
+
+import std;
+
+// Benchmark - Times the basic operations of the sequence configurations and of the standard containers they can
+// replace, and writes the results to stdout as CSV (one line per container, operation and size).
+//
+// Usage: Benchmark [max_size [filter]]
+//
+// Sizes above 'max_size' (default 10,000,000) are skipped, and so are the containers whose description does not
+// contain 'filter' (e.g. "VARIABLE,MIDDLE" or "std::"). The times are the best of several runs, in nanoseconds
+// per element handled, so that they can be compared across sizes and against earlier runs.
+
+constexpr std::array sizes{ 8uz, 64uz, 1'000uz, 10'000uz, 100'000uz, 1'000'000uz, 10'000'000uz };
+
+// The number of elements BUFFERED configurations keep internally (i.e. the small vector size).
+constexpr size_t buffer_size = 16;
+
+// Middle insertion and erasure take linear time, as does adding at the end a location does not grow toward (the
+// front of FRONT and the back of BACK), so they are run fewer times for larger sizes, and adding n elements at
+// that end is only timed while it is not quadratic.
+constexpr size_t middle_work = 100'000'000;
+constexpr size_t linear_add_limit = 10'000;
+
+template<typename C, sequence_location_lits END>
+constexpr bool linear_add = false;
+template<typename C, sequence_location_lits END> requires requires { C::traits; }
+constexpr bool linear_add<C, END> = C::traits.location == END;
+
+// Each operation is run (and set up) for at least 'min_time', but at least 'min_runs' times.
+constexpr auto min_time = std::chrono::milliseconds(20);
+constexpr int min_runs = 3;
+
+size_t max_size = sizes.back();
+std::string filter;
+volatile size_t sink;			// Keeps the results of the operations from being optimized away.
+
+// timed - Returns the best time (in nanoseconds per element) of 'op', which handles 'count' elements of a
+// container returned by 'setup'. The setup is not timed.
+
+template<typename SETUP, typename OP>
+double timed(size_t count, SETUP setup, OP op)
+{
+	using clock = std::chrono::steady_clock;
+
+	auto best = clock::duration::max();
+	auto begin = clock::now();
+	for (int runs = 0; runs < min_runs || clock::now() - begin < min_time; ++runs)
+	{
+		auto c = setup();
+		auto start = clock::now();
+		op(*c);
+		best = std::min(best, clock::now() - start);
+	}
+	return std::chrono::duration<double, std::nano>(best).count() / std::max<size_t>(count, 1);
+}
+
+// bench - Times the operations for one container type and size.
+
+template<typename C>
+void bench(const std::string& name, size_t n)
+{
+	if (!name.contains(filter))
+		return;
+
+	auto report = [&](std::string_view operation, double ns) { std::println("{},{},{},{:.3f}", name, operation, n, ns); };
+	auto fill = [](C& c, size_t size)
+	{
+		// The elements are added at the end the location grows toward, so that the setup is linear.
+		if constexpr (linear_add<C, sequence_location_lits::BACK>)
+			for (size_t i = size; i-- > 0;)
+				c.push_front(static_cast<int>(i));
+		else
+			for (size_t i = 0; i < size; ++i)
+				c.push_back(static_cast<int>(i));
+	};
+	auto empty = [] { return std::make_unique<C>(); };
+	auto filled = [=](size_t size)
+	{
+		return [=]
+		{
+			auto c = std::make_unique<C>();
+			fill(*c, size);
+			return c;
+		};
+	};
+
+	if (!linear_add<C, sequence_location_lits::BACK> || n <= linear_add_limit)
+		report("push_back", timed(n, empty, [=](C& c)
+		{
+			for (size_t i = 0; i < n; ++i)
+				c.push_back(static_cast<int>(i));
+			sink = c.size();
+		}));
+
+	if constexpr (requires(C& c) { c.push_front(0); })
+	{
+		if (!linear_add<C, sequence_location_lits::FRONT> || n <= linear_add_limit)
+			report("push_front", timed(n, empty, [=](C& c)
+			{
+				for (size_t i = 0; i < n; ++i)
+					c.push_front(static_cast<int>(i));
+				sink = c.size();
+			}));
+	}
+
+	// The size stays at n - 1 or n, so that the fixed capacity configurations have room.
+	auto middle_ops = std::clamp<size_t>(middle_work / n, 1, 1'000);
+	report("insert_erase_middle", timed(middle_ops, filled(n - 1), [=](C& c)
+	{
+		for (size_t i = 0; i < middle_ops; ++i)
+		{
+			c.insert(c.begin() + c.size() / 2, static_cast<int>(i));
+			c.erase(c.begin() + c.size() / 2);
+		}
+		sink = c.size();
+	}));
+
+	report("iterate", timed(n, filled(n), [](C& c)
+	{
+		size_t sum = 0;
+		for (auto e : c)
+			sum += e;
+		sink = sum;
+	}));
+	report("copy", timed(n, filled(n), [](C& c)
+	{
+		auto copy = std::make_unique<C>(c);
+		sink = copy->size();
+	}));
+	report("move", timed(n, filled(n), [](C& c)
+	{
+		auto moved = std::make_unique<C>(std::move(c));
+		sink = moved->size();
+	}));
+	report("swap", timed(n, [=]
+	{
+		auto pair = std::make_unique<std::array<C, 2>>();
+		fill((*pair)[0], n);
+		fill((*pair)[1], n / 2);
+		return pair;
+	},
+	[](std::array<C, 2>& pair)
+	{
+		pair[0].swap(pair[1]);
+		sink = pair[0].size();
+	}));
+	report("resize", timed(n, empty, [=](C& c)
+	{
+		c.resize(n);
+		sink = c.size();
+		c.resize(n / 2);
+		sink = c.size();
+	}));
+}
+
+// Describes a sequence configuration as CSV fields (to match the standard containers, whose fields are empty).
+
+constexpr std::string_view storage_name(sequence_storage_lits storage)
+{
+	switch (storage)
+	{
+		case sequence_storage_lits::STATIC:		return "STATIC";
+		case sequence_storage_lits::FIXED:		return "FIXED";
+		case sequence_storage_lits::VARIABLE:	return "VARIABLE";
+		case sequence_storage_lits::BUFFERED:	return "BUFFERED";
+		default:								return "OTHER";
+	}
+}
+constexpr std::string_view location_name(sequence_location_lits location)
+{
+	switch (location)
+	{
+		case sequence_location_lits::FRONT:		return "FRONT";
+		case sequence_location_lits::BACK:		return "BACK";
+		case sequence_location_lits::MIDDLE:	return "MIDDLE";
+		default:								return "OTHER";
+	}
+}
+
+// Each sequence configuration is timed with each size type which can count N elements.
+
+template<size_t N, sequence_storage_lits STORAGE, sequence_location_lits LOCATION, typename SIZE>
+void bench_sequence(std::string_view size_name)
+{
+	if constexpr (N <= std::numeric_limits<SIZE>::max())
+	{
+		constexpr size_t capacity =
+			STORAGE == sequence_storage_lits::STATIC || STORAGE == sequence_storage_lits::FIXED ? N :
+			STORAGE == sequence_storage_lits::BUFFERED ? buffer_size : 1;
+		constexpr sequence_traits<SIZE> traits{ .storage = STORAGE, .location = LOCATION, .capacity = capacity };
+
+		bench<sequence<int, traits>>(std::format("sequence,{},{},{}", storage_name(STORAGE), location_name(LOCATION), size_name), N);
+	}
+}
+
+template<size_t N, sequence_storage_lits STORAGE, sequence_location_lits LOCATION>
+void bench_size_types()
+{
+	bench_sequence<N, STORAGE, LOCATION, std::uint8_t>("uint8_t");
+	bench_sequence<N, STORAGE, LOCATION, std::uint16_t>("uint16_t");
+	bench_sequence<N, STORAGE, LOCATION, std::uint32_t>("uint32_t");
+	bench_sequence<N, STORAGE, LOCATION, std::size_t>("size_t");
+}
+
+template<size_t N, sequence_storage_lits STORAGE>
+void bench_locations()
+{
+	bench_size_types<N, STORAGE, sequence_location_lits::FRONT>();
+	bench_size_types<N, STORAGE, sequence_location_lits::BACK>();
+	bench_size_types<N, STORAGE, sequence_location_lits::MIDDLE>();
+}
+
+template<size_t N>
+void bench_size()
+{
+	if (N > max_size)
+		return;
+
+	bench<std::vector<int>>("std::vector,,,", N);
+	bench<std::deque<int>>("std::deque,,,", N);
+#ifdef __cpp_lib_inplace_vector
+	bench<std::inplace_vector<int, N>>("std::inplace_vector,,,", N);
+#endif
+
+	bench_locations<N, sequence_storage_lits::STATIC>();
+	bench_locations<N, sequence_storage_lits::FIXED>();
+	bench_locations<N, sequence_storage_lits::VARIABLE>();
+	bench_locations<N, sequence_storage_lits::BUFFERED>();
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1)
+		max_size = std::stoull(argv[1]);
+	if (argc > 2)
+		filter = argv[2];
+
+	std::println("container,storage,location,size_type,operation,size,ns_per_element");
+	[]<size_t... I>(std::index_sequence<I...>)
+	{
+		(bench_size<sizes[I]>(), ...);
+	}(std::make_index_sequence<sizes.size()>());
+}
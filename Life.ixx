@@ -1,43 +1,81 @@
 // Lifetime metered object for testing containers and such. This monitors all
 // contruction, destruction and assignment, and it keeps track of lifetimes with
-// a static counter.
+// a static counter. Each kind of operation is also counted, and the output can
+// be turned off, so that the element operations done by a container operation
+// can be checked (see life_meter).
 
 export module life;
 
 import <print>;
+import <utility>;
 
 
 #define NOEX noexcept
 
+// life_counts - Totals of the operations on life objects.
+
+export struct life_counts
+{
+	int constructions = 0;			// Default and int constructions.
+	int copies = 0;					// Copy constructions.
+	int moves = 0;					// Move constructions.
+	int copy_assignments = 0;
+	int move_assignments = 0;
+	int destructions = 0;
+
+	int operations() const
+	{
+		return constructions + copies + moves + copy_assignments + move_assignments + destructions;
+	}
+
+	life_counts operator-(const life_counts& rhs) const
+	{
+		return {
+			constructions - rhs.constructions,
+			copies - rhs.copies,
+			moves - rhs.moves,
+			copy_assignments - rhs.copy_assignments,
+			move_assignments - rhs.move_assignments,
+			destructions - rhs.destructions
+		};
+	}
+	bool operator==(const life_counts&) const = default;
+};
+
 export struct life
 {
-	life() : birth(++count) { std::println("  life() {}/{}", i, birth); }
-	life(int i) : i(i), birth(++count) { std::println("  life(int) {}/{}", i, birth); }
+	life() : birth(++count) { ++counts.constructions; show("  life() {}/{}", i, birth); }
+	life(int i) : i(i), birth(++count) { ++counts.constructions; show("  life(int) {}/{}", i, birth); }
 	life(const life& l) : i(l.i), birth(++count)
 	{
-		std::println("  life(const life&) {}/{}", i, birth);
+		++counts.copies;
+		show("  life(const life&) {}/{}", i, birth);
 	}
 	life(life&& l) NOEX : i(l.i), birth(++count)
 	{
-		std::println("  life(life&&) {}/{}", i, birth);
+		++counts.moves;
+		show("  life(life&&) {}/{}", i, birth);
 		l.i = 666;
 	}
 	~life()
 	{
-		std::println("  ~life {}/{}", i, birth);
+		++counts.destructions;
+		show("  ~life {}/{}", i, birth);
 		i = 99999;
 	}
 
 	life& operator=(const life& l)
 	{
 		i = l.i;
-		std::println("  op=(const life&) {}/{}", i, birth);
+		++counts.copy_assignments;
+		show("  op=(const life&) {}/{}", i, birth);
 		return *this;
 	}
 	life& operator=(life&& l)
 	{
 		i = l.i;
-		std::println("  op=(life&&) {}/{}", i, birth);
+		++counts.move_assignments;
+		show("  op=(life&&) {}/{}", i, birth);
 		l.i = 666;
 		return *this;
 	}
@@ -45,7 +83,39 @@ export struct life
 	operator int() const { return i; }
 
 	static int count;
+	static life_counts counts;
+	static bool quiet;				// Turns off the output (the operations are still counted).
 	int i = 42, birth;
+
+private:
+
+	template<typename... ARGS>
+	static void show(std::format_string<ARGS...> fmt, ARGS&&... args)
+	{
+		if (!quiet)
+			std::println(fmt, std::forward<ARGS>(args)...);
+	}
 };
 
 int life::count = 0;
+life_counts life::counts;
+bool life::quiet = false;
+
+// life_meter - Silences life while it is in scope, and returns the operations done since it was constructed
+// (or last reset).
+
+export class life_meter
+{
+public:
+	life_meter() : m_start(life::counts), m_quiet(std::exchange(life::quiet, true)) {}
+	~life_meter() { life::quiet = m_quiet; }
+	life_meter(const life_meter&) = delete;
+	life_meter& operator=(const life_meter&) = delete;
+
+	life_counts operator()() const { return life::counts - m_start; }
+	void reset() { m_start = life::counts; }
+
+private:
+	life_counts m_start;
+	bool m_quiet;
+};
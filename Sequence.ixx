@@ -5,17 +5,72 @@
 *	Alan Talbot
 */
 
+module;
+
+// MAPPED storage gets its capacity from the POSIX memory mapping functions, which are not available as
+// header units. It is only provided where they exist.
+
+#if __has_include(<sys/mman.h>)
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define SEQUENCE_MAPPED_STORAGE
+#endif
+
+// The file descriptor versions of write_to and read_from use the POSIX scatter-gather functions, and are also
+// only provided where they exist.
+
+#if __has_include(<sys/uio.h>)
+#include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define SEQUENCE_POSIX_IO
+#endif
+
 export module sequence;
 
 //import std;
 import <assert.h>;
 import <concepts>;
+import <bit>;
+import <numeric>;
+import <algorithm>;
 import <utility>;
 import <span>;
+import <iterator>;
+import <compare>;
+import <functional>;
+import <string_view>;
+import <ranges>;
 import <memory>;
-import <variant>;
+import <memory_resource>;
+import <atomic>;
+import <execution>;
+import <thread>;
+import <exception>;
+import <chrono>;
+import <new>;
+import <cstring>;
+import <cstdlib>;
+import <cstdint>;
 import <stdexcept>;
+import <system_error>;
 import <format>;
+import <istream>;
+import <ostream>;
+import <tuple>;
+import <array>;
+import <vector>;
+
+// MSVC ignores the standard attribute and has its own spelling of it.
+#ifdef _MSC_VER
+#define NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#else
+#define NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
 
 // ==============================================================================================================
 // Traits - Control structure template parameter.
@@ -24,26 +79,39 @@ import <format>;
 // These are hoisted out of the class template to avoid template dependencies.
 // See sequence_traits below for a detailed discussion of these values.
 
-export enum class sequence_storage_lits { STATIC, FIXED, VARIABLE, BUFFERED };	// See sequence_traits::storage.
-export enum class sequence_location_lits { FRONT, BACK, MIDDLE };				// See sequence_traits::location.
-export enum class sequence_growth_lits { LINEAR, EXPONENTIAL, VECTOR };			// See sequence_traits::growth.
+export enum class sequence_storage_lits { STATIC, FIXED, VARIABLE, BUFFERED, SEGMENTED, MAPPED };	// See sequence_traits::storage.
+export enum class sequence_location_lits { FRONT, BACK, MIDDLE, CIRCULAR };		// See sequence_traits::location.
+export enum class sequence_growth_lits { LINEAR, EXPONENTIAL, VECTOR, CUSTOM };	// See sequence_traits::growth.
+export enum class mapped_pages_lits { NORMAL, HUGE_PAGES };						// See mapped_allocator.
+export enum class mapped_advice_lits { NORMAL, SEQUENTIAL, RANDOM, WILLNEED };	// See mapped_allocator::advise.
 
 // sequence_traits - Structure used to supply the sequence traits. This is fully documented in the README.md file.
 
-export template<std::unsigned_integral SIZE = size_t>
+export template<std::unsigned_integral SIZE = size_t, typename GROWTH = void>
 struct sequence_traits
 {
 	using size_type = SIZE;
+	using growth_policy = GROWTH;
 
 	sequence_storage_lits storage = sequence_storage_lits::VARIABLE;
 	sequence_location_lits location = sequence_location_lits::FRONT;
-	sequence_growth_lits growth = sequence_growth_lits::VECTOR;
+	sequence_growth_lits growth = std::is_void_v<GROWTH> ? sequence_growth_lits::VECTOR : sequence_growth_lits::CUSTOM;
 
 	size_t capacity = 1;
 	size_t increment = 1;
 	float factor = 1.5;
-
-	constexpr size_t grow(size_t cap) const
+	bool size_classes = false;
+	size_t alignment = 0;
+	size_t tail_padding = 0;
+	size_t retain_limit = std::numeric_limits<size_t>::max();
+	bool compact = false;
+	float front_bias = 0.5f;
+	bool adaptive_bias = false;
+	bool statistics = false;
+	bool in_place_emplace = false;
+	size_t parallel_threshold = 100'000;
+
+	constexpr size_t grow(size_t cap, size_t element_size = 1) const
 	{
 		if (cap < capacity) return capacity;
 		else switch (growth)
@@ -52,6 +120,10 @@ struct sequence_traits
 				return cap + increment;
 			case sequence_growth_lits::EXPONENTIAL:
 				return cap + std::max(size_t(cap * (factor - 1.f)), increment);
+			case sequence_growth_lits::CUSTOM:
+				if constexpr (!std::is_void_v<GROWTH>)
+					return GROWTH()(cap, element_size);
+				[[fallthrough]];
 			default:
 			case sequence_growth_lits::VECTOR:
 				return cap + std::max<size_t>(cap / 2, 1u);
@@ -59,2168 +131,8029 @@ struct sequence_traits
 	};
 
 	// 'is_variable' returns true iff the capacity can change size
-	// (i.e. storage is VARIABLE or BUFFERED).
+	// (i.e. storage is VARIABLE, BUFFERED, SEGMENTED or MAPPED).
 
 	constexpr bool is_variable() const { return storage >= sequence_storage_lits::VARIABLE; }
 
 	// 'front_gap' returns the location of the start of the data given a capacity and size.
-	// The formula is based on the 'location' value.
+	// The formula is based on the 'location' value. MIDDLE placement puts 'front_bias' of the
+	// free space at the front (see middle_gap).
 
-	constexpr size_t front_gap(size_t cap, size_t size) const
+	constexpr size_t front_gap(size_t cap, size_t size, size_t element_size = 1) const
 	{
 		switch (location)
 		{
 		default:
 		case sequence_location_lits::FRONT:		return 0;
 		case sequence_location_lits::BACK:		return cap - size;
-		case sequence_location_lits::MIDDLE:	return (cap - size) / 2;
+		case sequence_location_lits::MIDDLE:	return middle_gap(cap - size, front_bias, element_size);
 		}
 	}
 	constexpr size_t front_gap(size_t size = 0) const
 	{
 		return front_gap(capacity, size);
 	}
+
+	// 'middle_gap' returns the part of 'room' free elements that is put in front of MIDDLE data
+	// given the fraction 'bias'. Given the element size, the result is rounded down so that the
+	// start of the data keeps the requested 'alignment'.
+
+	constexpr size_t middle_gap(size_t room, float bias, size_t element_size = 1) const
+	{
+		auto gap = bias == 0.5f ? room / 2 : std::min(room, static_cast<size_t>(room * static_cast<double>(bias)));
+		return gap / granularity(element_size) * granularity(element_size);
+	}
+
+	// 'granularity' returns the number of elements between positions with the requested 'alignment'
+	// (assuming the capacity itself is aligned).
+
+	constexpr size_t granularity(size_t element_size) const
+	{
+		return alignment > 1 ? alignment / std::gcd(alignment, element_size) : 1;
+	}
 };
 
-// ==============================================================================================================
-// Utility functions - Not publically available.
+// is_trivially_relocatable - Trait which allows sequence to relocate elements (move them and end the lifetime of
+// the originals) with memcpy/memmove rather than element by element. It is true for trivially copyable types
+// and may be specialized for other types which can be relocated bitwise (e.g. types holding a std::unique_ptr).
+// This is fully documented in the README.md file.
 
-namespace {
+export template<typename T>
+struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
 
-// This provides the needed additional uninitialized memory function to handle moving of types.
+export template<typename T>
+constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
 
-template<typename InpIt, typename FwdIt>
-auto uninitialized_move_if_noexcept(InpIt src, InpIt end, FwdIt dst)
+// sequence_buffer - Describes a raw capacity and the constructed elements within it. A variable capacity sequence
+// can adopt a buffer (obtained from an allocator equal to its own) and can release its capacity as one, which
+// allows elements to be handed to and from other code without being copied. This is fully documented in the
+// README.md file.
+
+export template<typename T>
+struct sequence_buffer
 {
-	using value_type = std::iterator_traits<InpIt>::value_type;
-	if constexpr (!std::is_nothrow_move_constructible_v<value_type> && std::is_copy_constructible_v<value_type>)
-		return std::uninitialized_copy(src, end, dst);
-	else
-		return std::uninitialized_move(src, end, dst);
-}
+	T* capacity_begin = nullptr;		// The capacity (as returned by the allocator).
+	size_t capacity = 0;				// The size of the capacity (as passed to the allocator).
+	T* data_begin = nullptr;			// The constructed elements, which must lie within the capacity.
+	T* data_end = nullptr;
+};
 
+// sequence_header - Written in front of the elements of a serialized sequence (see sequence::write_to). The
+// fingerprint identifies the format of the element bytes which follow: the element size and the byte order of
+// the machine which wrote them (and a tag and version for the format itself). It does not depend on the other
+// traits, so elements written by one sequence configuration can be read by any other. This is fully documented
+// in the README.md file.
 
-// The add functions implement the algorithms for adding an element at the front
-// or back. These algorithms are used for both fixed and dynamic storage.
-
-template<typename T, std::regular_invocable FUNC, typename... ARGS>
-inline T* front_add_at(T* dst, T* pos, FUNC adjust, ARGS&&... args)
-{
-	T temp(std::forward<ARGS>(args)...);	// Do this first in case the T ctor throws.
-	new(dst - 1) T(std::move(*dst));
-	adjust();
-	--pos;
-	for (auto src = dst + 1; dst != pos;)
-		*dst++ = std::move(*src++);
-	*pos = std::move(temp);
-	return pos;
-}
+export struct sequence_header
+{
+	std::uint64_t fingerprint = 0;
+	std::uint64_t size = 0;				// The number of elements which follow.
+};
 
-template<typename T, std::regular_invocable FUNC, typename... ARGS>
-inline T* back_add_at(T* dst, T* pos, FUNC adjust, ARGS&&... args)
+export template<typename T>
+constexpr std::uint64_t sequence_fingerprint = []
 {
-	T temp(std::forward<ARGS>(args)...);	// Do this first in case the T ctor throws.
-	new(dst) T(std::move(*(dst - 1)));
-	adjust();
-	for (auto src = --dst - 1; dst != pos;)
-		*dst-- = std::move(*src--);
-	*pos = std::move(temp);
-	return pos;
-}
+	static_assert(sizeof(T) <= std::numeric_limits<std::uint32_t>::max(), "Element too large to serialize.");
+	return std::uint64_t(0x5351) << 48							// "SQ"
+		| std::uint64_t(1) << 40								// Format version.
+		| std::uint64_t(std::endian::native == std::endian::little) << 32
+		| sizeof(T);
+}();
 
-// The destroy_data function encapsulates calling the element destructors. It is called
-// in the sequence destructor and elsewhere when elements are either going away or have
-// been moved somewhere else.
+// ==============================================================================================================
+// sequence_stats - Counters of the slow paths taken by all of the sequences with a given traits value (whatever
+// their element type). They are only kept when the 'statistics' trait is set, otherwise the recording functions
+// do nothing and the counters are never instantiated. The counters are relaxed atomics, so they may be updated
+// from any number of threads. This is fully documented in the README.md file.
 
-template<typename T>
-inline void destroy_data(T* data_begin, T* data_end)
+export struct sequence_statistics
 {
-	for (auto&& element : std::span<T>(data_begin, data_end))
-		element.~T();
-}
-
-// The erase functions implement the erase element and erase range algorithms for front
-// and back erasure. These algorithms are used for both fixed and dynamic storage.
+	size_t reallocations = 0;					// Capacity changes (growth, reserve and shrink_to_fit).
+	size_t allocations = 0;						// Dynamic capacities allocated (or resized in place) by them.
+	size_t allocated_bytes = 0;					// The total size of those capacities.
+	size_t buffer_to_heap = 0;					// BUFFERED elements moving from the buffer to a dynamic capacity.
+	size_t heap_to_buffer = 0;					// And back again.
+	size_t recenters = 0;						// MIDDLE elements shifted to make room at the end which ran out.
+	size_t grow_moves = 0;						// Elements relocated by reallocations.
+	size_t recenter_moves = 0;					// Elements shifted by recenters.
+	size_t erase_moves = 0;						// Elements shifted to close up erased elements.
+	size_t peak_size = 0;
+	size_t peak_capacity = 0;
+	std::chrono::nanoseconds slow_path_time{};	// Time spent in reallocations and recenters.
+};
 
-template<typename T>
-inline void front_erase(T* data_begin, T* erase_begin, T* erase_end)
+export template<sequence_traits TRAITS>
+class sequence_stats
 {
-	assert(erase_begin >= data_begin);
-	assert(erase_end >= erase_begin);
+public:
 
-	if (erase_begin != erase_end)
+	static constexpr bool enabled = TRAITS.statistics;
+
+	static inline sequence_statistics snapshot() requires (enabled)
+	{
+		return {
+			.reallocations = s_reallocations.load(std::memory_order_relaxed),
+			.allocations = s_allocations.load(std::memory_order_relaxed),
+			.allocated_bytes = s_allocated_bytes.load(std::memory_order_relaxed),
+			.buffer_to_heap = s_buffer_to_heap.load(std::memory_order_relaxed),
+			.heap_to_buffer = s_heap_to_buffer.load(std::memory_order_relaxed),
+			.recenters = s_recenters.load(std::memory_order_relaxed),
+			.grow_moves = s_grow_moves.load(std::memory_order_relaxed),
+			.recenter_moves = s_recenter_moves.load(std::memory_order_relaxed),
+			.erase_moves = s_erase_moves.load(std::memory_order_relaxed),
+			.peak_size = s_peak_size.load(std::memory_order_relaxed),
+			.peak_capacity = s_peak_capacity.load(std::memory_order_relaxed),
+			.slow_path_time = std::chrono::nanoseconds(s_slow_path_time.load(std::memory_order_relaxed))
+		};
+	}
+	static inline void reset() requires (enabled)
 	{
-		auto beg = data_begin - 1;
-		auto dst = erase_end - 1;
-		auto src = erase_begin - 1;
-		while (src != beg)
-			*dst-- = std::move(*src--);
-		destroy_data(data_begin, ++dst);
+		for (auto counter : {&s_reallocations, &s_allocations, &s_allocated_bytes, &s_buffer_to_heap, &s_heap_to_buffer,
+			&s_recenters, &s_grow_moves, &s_recenter_moves, &s_erase_moves, &s_peak_size, &s_peak_capacity})
+			counter->store(0, std::memory_order_relaxed);
+		s_slow_path_time.store(0, std::memory_order_relaxed);
 	}
-}
 
-template<typename T>
-inline void front_erase(T* data_begin, T* element)
-{
-	assert(element >= data_begin);
+	// The recording functions are used by sequence and its storage.
 
-	auto src = element - 1;
-	while (element != data_begin)
-		*element-- = std::move(*src--);
-	element->~T();
-}
+	static constexpr void reallocated(size_t moved, size_t capacity)
+	{
+		if constexpr (enabled)
+		{
+			count(s_reallocations, 1);
+			count(s_grow_moves, moved);
+			raise(s_peak_capacity, capacity);
+		}
+	}
+	static constexpr void allocated(size_t bytes)
+	{
+		if constexpr (enabled)
+		{
+			count(s_allocations, 1);
+			count(s_allocated_bytes, bytes);
+		}
+	}
+	static constexpr void rebuffered(bool to_heap)
+	{
+		if constexpr (enabled)
+			count(to_heap ? s_buffer_to_heap : s_heap_to_buffer, 1);
+	}
+	static constexpr void recentered(size_t moved)
+	{
+		if constexpr (enabled)
+		{
+			count(s_recenters, 1);
+			count(s_recenter_moves, moved);
+		}
+	}
+	static constexpr void erased(size_t moved)
+	{
+		if constexpr (enabled)
+			count(s_erase_moves, moved);
+	}
+	static constexpr void resized(size_t size)
+	{
+		if constexpr (enabled)
+			raise(s_peak_size, size);
+	}
 
-template<typename T>
-inline void back_erase(T* data_end, T* erase_begin, T* erase_end)
-{
-	assert(erase_end <= data_end);
-	assert(erase_end >= erase_begin);
+	// Adds the time until it goes out of scope to the slow path time.
 
-	if (erase_begin != erase_end)
+	class timer
 	{
-		auto dst = erase_begin;
-		auto src = erase_end;
-		while (src != data_end)
-			*dst++ = std::move(*src++);
-		destroy_data(dst, data_end);
+	public:
+		constexpr timer() : m_start(now()) {}
+		constexpr ~timer()
+		{
+			if constexpr (enabled)
+				s_slow_path_time.fetch_add((now() - m_start).count(), std::memory_order_relaxed);
+		}
+		timer(const timer&) = delete;
+		timer& operator=(const timer&) = delete;
+
+	private:
+		static constexpr auto now()
+		{
+			if constexpr (enabled)
+				return std::chrono::steady_clock::now();
+			else
+				return 0;
+		}
+
+		decltype(now()) m_start;
+	};
+
+private:
+
+	static inline void count(std::atomic<size_t>& counter, size_t n)
+	{
+		if (n)
+			counter.fetch_add(n, std::memory_order_relaxed);
 	}
-}
+
+	// Only stores when there is a new peak, so that reaching the same size again is just a load.
+	static inline void raise(std::atomic<size_t>& peak, size_t value)
+	{
+		auto current = peak.load(std::memory_order_relaxed);
+		while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed));
+	}
+
+	static inline std::atomic<size_t> s_reallocations;
+	static inline std::atomic<size_t> s_allocations;
+	static inline std::atomic<size_t> s_allocated_bytes;
+	static inline std::atomic<size_t> s_buffer_to_heap;
+	static inline std::atomic<size_t> s_heap_to_buffer;
+	static inline std::atomic<size_t> s_recenters;
+	static inline std::atomic<size_t> s_grow_moves;
+	static inline std::atomic<size_t> s_recenter_moves;
+	static inline std::atomic<size_t> s_erase_moves;
+	static inline std::atomic<size_t> s_peak_size;
+	static inline std::atomic<size_t> s_peak_capacity;
+	static inline std::atomic<std::chrono::nanoseconds::rep> s_slow_path_time;
+};
+
+// ==============================================================================================================
+// ring_iterator - The iterator type of CIRCULAR location sequences, whose elements wrap around the end of the
+// capacity. The position is kept as an offset from the start of the capacity which is not reduced, so
+// iterators into the same data compare and subtract directly; it is only wrapped when an element is accessed.
+// The offset may be up to one capacity past either end, which covers everything the storage needs.
 
 template<typename T>
-inline void back_erase(T* data_end, T* element)
+class ring_iterator
 {
-	assert(element < data_end);
+	template<typename> friend class ring_iterator;
 
-	auto src = element + 1;
-	while (src != data_end)
-		*element++ = std::move(*src++);
-	element->~T();
-}
+public:
 
-// The recenter function shifts the elements in a MIDDLE location capacity to prepare for size growth.
-// If the remaining space is odd, then the extra space will be at the front if we are making space at
-// the front, otherwise it will be at the back. It returns the new front and back gaps.
+	using iterator_concept = std::random_access_iterator_tag;
+	using iterator_category = std::random_access_iterator_tag;
+	using value_type = std::remove_cv_t<T>;
+	using difference_type = std::ptrdiff_t;
+	using pointer = T*;
+	using reference = T&;
+
+	ring_iterator() = default;
+	ring_iterator(pointer capacity_begin, size_t capacity, difference_type offset) :
+		m_capacity_begin(capacity_begin),
+		m_capacity(static_cast<difference_type>(capacity)),
+		m_offset(offset)
+	{}
+	template<typename U> requires std::same_as<const U, T>
+	ring_iterator(const ring_iterator<U>& rhs) :
+		m_capacity_begin(rhs.m_capacity_begin),
+		m_capacity(rhs.m_capacity),
+		m_offset(rhs.m_offset)
+	{}
 
-template<typename CAPACITY, typename T>
-inline std::pair<size_t, size_t> recenter(T* capacity_begin, T* capacity_end, T* data_begin, T* data_end)
-{
-	assert(data_begin == capacity_begin || data_end == capacity_end);
-	assert(data_begin != capacity_begin || data_end != capacity_end);
+	reference operator*() const { return *element(); }
+	pointer operator->() const { return element(); }
+	reference operator[](difference_type n) const { return *(*this + n); }
 
-	auto capacity = capacity_end - capacity_begin;
-	auto size = data_end - data_begin;
+	ring_iterator& operator++() { ++m_offset; return *this; }
+	ring_iterator& operator--() { --m_offset; return *this; }
+	ring_iterator operator++(int) { auto it = *this; ++m_offset; return it; }
+	ring_iterator operator--(int) { auto it = *this; --m_offset; return it; }
+	ring_iterator& operator+=(difference_type n) { m_offset += n; return *this; }
+	ring_iterator& operator-=(difference_type n) { m_offset -= n; return *this; }
 
-	CAPACITY temp(size);
-	std::uninitialized_move(data_begin, data_end, temp.capacity_begin());
-	destroy_data(data_begin, data_end);
+	friend ring_iterator operator+(ring_iterator it, difference_type n) { return it += n; }
+	friend ring_iterator operator+(difference_type n, ring_iterator it) { return it += n; }
+	friend ring_iterator operator-(ring_iterator it, difference_type n) { return it -= n; }
+	friend difference_type operator-(const ring_iterator& lhs, const ring_iterator& rhs) { return lhs.m_offset - rhs.m_offset; }
+	friend bool operator==(const ring_iterator& lhs, const ring_iterator& rhs) { return lhs.m_offset == rhs.m_offset; }
+	friend auto operator<=>(const ring_iterator& lhs, const ring_iterator& rhs) { return lhs.m_offset <=> rhs.m_offset; }
 
-	auto fg = sequence_traits{.location = sequence_location_lits::MIDDLE}.front_gap(capacity, size);
-	auto bg = capacity - (fg + size);
-	if (data_begin == capacity_begin) std::swap(fg, bg);
-	std::uninitialized_move(temp.capacity_begin(), temp.capacity_begin() + size, capacity_begin + fg);
+	// Returns the index in the capacity of the element.
+	size_t position() const { return element() - m_capacity_begin; }
 
-	return {fg, bg};
-}
+	// Returns the (at most two) contiguous pieces of the capacity which hold [first, last).
+	friend std::pair<std::span<T>, std::span<T>> data_spans(ring_iterator first, ring_iterator last)
+	{
+		auto count = static_cast<size_t>(last - first);
+		auto start = first.position();
+		auto first_count = std::min(count, static_cast<size_t>(first.m_capacity) - start);
+		return {{first.m_capacity_begin + start, first_count}, {first.m_capacity_begin, count - first_count}};
+	}
 
-}
+private:
+
+	pointer element() const
+	{
+		auto offset = m_offset;
+		if (offset >= m_capacity) offset -= m_capacity;
+		else if (offset < 0) offset += m_capacity;
+		return m_capacity_begin + offset;
+	}
+
+	pointer m_capacity_begin = nullptr;
+	difference_type m_capacity = 0;
+	difference_type m_offset = 0;
+};
 
 // ==============================================================================================================
-// fixed_capacity - This is the base class for fixed_storage instantiations. It handles the raw capacity.
+// segment_iterator - The iterator type of SEGMENTED storage sequences, whose elements are kept in separately
+// allocated segments of SEG elements listed in a segment table. The position is kept as an index, which is only
+// split into a segment and an offset when an element is accessed, so iterator arithmetic is as cheap as for
+// pointers and indexing is constant time.
 
-template<typename T, size_t CAP> requires (CAP != 0)
-class fixed_capacity
+template<typename T, size_t SEG>
+class segment_iterator
 {
-	using value_type = T;
+	template<typename, size_t> friend class segment_iterator;
 
 public:
 
-	fixed_capacity() {}
-	fixed_capacity(size_t cap) {}
-	~fixed_capacity() {}
+	using iterator_concept = std::random_access_iterator_tag;
+	using iterator_category = std::random_access_iterator_tag;
+	using value_type = std::remove_cv_t<T>;
+	using difference_type = std::ptrdiff_t;
+	using pointer = T*;
+	using reference = T&;
+
+	segment_iterator() = default;
+	segment_iterator(T* const* segments, difference_type index) :
+		m_segments(segments),
+		m_index(index)
+	{}
+	template<typename U> requires std::same_as<const U, T>
+	segment_iterator(const segment_iterator<U, SEG>& rhs) :
+		m_segments(rhs.m_segments),
+		m_index(rhs.m_index)
+	{}
 
-	constexpr static size_t capacity() { return CAP; }
+	reference operator*() const { return *element(); }
+	pointer operator->() const { return element(); }
+	reference operator[](difference_type n) const { return *(*this + n); }
+
+	segment_iterator& operator++() { ++m_index; return *this; }
+	segment_iterator& operator--() { --m_index; return *this; }
+	segment_iterator operator++(int) { auto it = *this; ++m_index; return it; }
+	segment_iterator operator--(int) { auto it = *this; --m_index; return it; }
+	segment_iterator& operator+=(difference_type n) { m_index += n; return *this; }
+	segment_iterator& operator-=(difference_type n) { m_index -= n; return *this; }
 
-	inline value_type* capacity_begin() { return elements; }
-	inline value_type* capacity_end() { return elements + CAP; }
-	inline const value_type* capacity_begin() const { return elements; }
-	inline const value_type* capacity_end() const { return elements + CAP; }
+	friend segment_iterator operator+(segment_iterator it, difference_type n) { return it += n; }
+	friend segment_iterator operator+(difference_type n, segment_iterator it) { return it += n; }
+	friend segment_iterator operator-(segment_iterator it, difference_type n) { return it -= n; }
+	friend difference_type operator-(const segment_iterator& lhs, const segment_iterator& rhs) { return lhs.m_index - rhs.m_index; }
+	friend bool operator==(const segment_iterator& lhs, const segment_iterator& rhs) { return lhs.m_index == rhs.m_index; }
+	friend auto operator<=>(const segment_iterator& lhs, const segment_iterator& rhs) { return lhs.m_index <=> rhs.m_index; }
 
 private:
 
-	union
+	pointer element() const
 	{
-		value_type elements[CAP];
-		unsigned char unused;
-	};
+		auto index = static_cast<size_t>(m_index);
+		return m_segments[index / SEG] + index % SEG;
+	}
+
+	T* const* m_segments = nullptr;
+	difference_type m_index = 0;
 };
 
+// sequence_iterator - The iterator type for a given location and storage: a pointer, except for CIRCULAR
+// sequences and SEGMENTED storage.
+
+template<typename T, sequence_traits TRAITS>
+using sequence_iterator = std::conditional_t<TRAITS.storage == sequence_storage_lits::SEGMENTED, segment_iterator<T, TRAITS.capacity>,
+	std::conditional_t<TRAITS.location == sequence_location_lits::CIRCULAR, ring_iterator<T>, T*>>;
 
 // ==============================================================================================================
-// fixed_storage - This is the base class for the fixed_sequence_storage class. It provides
-// the three different element management strategies for fixed capacity sequences
+// Utility functions - Not publically available.
 
-template<typename T, sequence_traits TRAITS, sequence_location_lits LOC = TRAITS.location>
-class fixed_storage
-{
-	static_assert(false, "An unimplemented specialization of fixed_storage was instantiated.");
-};
+namespace {
 
+// This provides the needed additional uninitialized memory function to handle moving of types.
 
-template<typename T, sequence_traits TRAITS>
-class fixed_storage<T, TRAITS, sequence_location_lits::FRONT> : public fixed_capacity<T, TRAITS.capacity>
+template<typename InpIt, typename FwdIt>
+auto uninitialized_move_if_noexcept(InpIt src, InpIt end, FwdIt dst)
 {
-	using inherited = fixed_capacity<T, TRAITS.capacity>;
-	using value_type = T;
-	using iterator = value_type*;
-	using const_iterator = const value_type*;
-	using size_type = typename decltype(TRAITS)::size_type;
-
-public:
-
-	using inherited::capacity;
-	using inherited::capacity_begin;
-	using inherited::capacity_end;
+	using value_type = std::iterator_traits<InpIt>::value_type;
+	if constexpr (!std::is_nothrow_move_constructible_v<value_type> && std::is_copy_constructible_v<value_type>)
+		return std::uninitialized_copy(src, end, dst);
+	else
+		return std::uninitialized_move(src, end, dst);
+}
 
-	inline iterator data_begin() { return capacity_begin(); }
-	inline iterator data_end() { return capacity_begin() + m_size; }
-	inline const_iterator data_begin() const { return capacity_begin(); }
-	inline const_iterator data_end() const { return capacity_begin() + m_size; }
-	inline size_t size() const { return m_size; }
-	inline bool empty() const { return m_size == 0; }
+// The uninitialized_copy_data and uninitialized_move_data functions are std::uninitialized_copy and
+// std::uninitialized_move, except that they can also be used during constant evaluation (where the elements
+// are simply constructed one at a time, since nothing can throw).
 
-	template<typename... ARGS>
-	inline iterator add_at(iterator pos, ARGS&&... args)
+template<typename IT, typename OUT>
+constexpr OUT uninitialized_copy_data(IT src, IT end, OUT dst)
+{
+	if consteval
 	{
-		assert(size() < capacity());
-		assert(pos >= data_begin() && pos <= data_end());
-
-		if (empty() || pos == data_end())
-			add_back(std::forward<ARGS>(args)...);
-		else
-			pos = back_add_at(data_end(), pos, [this](){ ++m_size; }, std::forward<ARGS>(args)...);
-		return pos;
+		for (; src != end; ++src, ++dst)
+			std::construct_at(std::addressof(*dst), *src);
+		return dst;
 	}
-	template<typename... ARGS>
-	inline void add_front(ARGS&&... args)
+	else
 	{
-		add_at(data_begin(), std::forward<ARGS>(args)...);
+		return std::uninitialized_copy(src, end, dst);
 	}
-	template<typename... ARGS>
-	inline void add_back(ARGS&&... args)
+}
+template<typename IT, typename OUT>
+constexpr OUT uninitialized_move_data(IT src, IT end, OUT dst)
+{
+	if consteval
 	{
-		assert(size() < capacity());
-		new(data_end()) value_type(std::forward<ARGS>(args)...);
-		++m_size;
+		for (; src != end; ++src, ++dst)
+			std::construct_at(std::addressof(*dst), std::move(*src));
+		return dst;
 	}
-
-	inline void erase(value_type* erase_begin, value_type* erase_end)
+	else
 	{
-		back_erase(data_end(), erase_begin, erase_end);
-		m_size -= erase_end - erase_begin;
+		return std::uninitialized_move(src, end, dst);
 	}
-	inline void erase(value_type* element)
+}
+
+// The destroy_data function encapsulates calling the element destructors. It is called
+// in the sequence destructor and elsewhere when elements are either going away or have
+// been moved somewhere else. During constant evaluation trivially destructible elements are
+// left alone, so that a constexpr sequence has no elements outside their lifetime.
+
+template<typename T>
+constexpr void destroy_data(T* data_begin, T* data_end)
+{
+	if consteval
 	{
-		back_erase(data_end(), element);
-		--m_size;
+		if constexpr (std::is_trivially_destructible_v<T>)
+			return;
 	}
-	inline void pop_front()
+	for (auto&& element : std::span<T>(data_begin, data_end))
+		element.~T();
+}
+template<typename T>
+inline void destroy_data(ring_iterator<T> data_begin, ring_iterator<T> data_end)
+{
+	auto [first, second] = data_spans(data_begin, data_end);
+	destroy_data(first.data(), first.data() + first.size());
+	destroy_data(second.data(), second.data() + second.size());
+}
+template<typename T, size_t SEG>
+inline void destroy_data(segment_iterator<T, SEG> data_begin, segment_iterator<T, SEG> data_end)
+{
+	for (; data_begin != data_end; ++data_begin)
+		data_begin->~T();
+}
+
+// The data_spans function returns the contiguous pieces of memory which hold [data_begin, data_end). This is
+// always one piece for pointers; ring_iterator provides an overload which may return two.
+
+template<typename T>
+inline std::pair<std::span<T>, std::span<T>> data_spans(T* data_begin, T* data_end)
+{
+	return {{data_begin, data_end}, {}};
+}
+
+// The relocate_bytes function relocates trivially relocatable elements with a single memmove (so the ranges
+// may overlap). The originals must be treated as no longer existing. Constant evaluation cannot copy bytes, so
+// there trivially copyable elements are copied one at a time, in the order which is safe for the overlap.
+
+template<typename T>
+constexpr void relocate_bytes(T* dst, const T* src, size_t count)
+{
+	if consteval
 	{
-		erase(data_begin());
+		if constexpr (std::is_trivially_copyable_v<T>)
+		{
+			if (dst < src)
+				for (size_t i = 0; i < count; ++i)
+					std::construct_at(dst + i, src[i]);
+			else
+				for (size_t i = count; i-- > 0;)
+					std::construct_at(dst + i, src[i]);
+		}
 	}
-	inline void pop_back()
+	else
 	{
-		--m_size;
-		data_end()->~value_type();
+		if (count)
+			std::memmove(static_cast<void*>(dst), static_cast<const void*>(src), count * sizeof(T));
 	}
+}
 
-	void prepare_for(size_type size) {}
-
-protected:
+// bytewise_comparable is true for the types whose values are equal exactly when their bytes are, so that they
+// can be compared and hashed as bytes (with memcmp and memchr, and the standard algorithms which the library
+// vectorizes for them). Floating point types are excluded since 0.0 == -0.0 and NaN != NaN.
 
-	auto new_data_start(size_type size) { return capacity_begin(); }
-	auto data_area() const { return m_size; }
-	void set_data_area(size_type size) { m_size = size; }
-	void set_size(size_type size) { m_size = size; }
+template<typename T>
+constexpr bool bytewise_comparable = (std::is_integral_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>) &&
+	std::has_unique_object_representations_v<T>;
 
-private:
+// The find_data function finds the first element equal to 'value' in [data_begin, data_end), or returns data_end.
+// Single byte elements are found with memchr (except during constant evaluation).
 
-	size_type m_size = 0;
-};
-
-template<typename T, sequence_traits TRAITS>
-class fixed_storage<T, TRAITS, sequence_location_lits::BACK> : public fixed_capacity<T, TRAITS.capacity>
+template<typename T>
+constexpr T* find_data(T* data_begin, T* data_end, const std::remove_const_t<T>& value)
 {
-	using inherited = fixed_capacity<T, TRAITS.capacity>;
-	using value_type = T;
-	using iterator = value_type*;
-	using const_iterator = const value_type*;
-	using size_type = typename decltype(TRAITS)::size_type;
-
-public:
-
-	using inherited::capacity;
-	using inherited::capacity_begin;
-	using inherited::capacity_end;
+	if constexpr (sizeof(T) == 1 && bytewise_comparable<std::remove_const_t<T>>)
+	{
+		if !consteval
+		{
+			if (data_begin == data_end)
+				return data_end;
+			auto found = std::memchr(data_begin, static_cast<unsigned char>(value), data_end - data_begin);
+			return found ? static_cast<T*>(found) : data_end;
+		}
+	}
+	return std::find(data_begin, data_end, value);
+}
 
-	inline iterator data_begin() { return capacity_end() - m_size; }
-	inline iterator data_end() { return capacity_end(); }
-	inline const_iterator data_begin() const { return capacity_end() - m_size; }
-	inline const_iterator data_end() const { return capacity_end(); }
-	inline size_t size() const { return m_size; }
-	inline bool empty() const { return m_size == 0; }
+// The uninitialized_relocate function moves elements into uninitialized memory and destroys the originals.
+// For trivially relocatable types this is a memmove (of each contiguous piece of the source), otherwise the
+// elements are moved (or copied if the move might throw). The ranges must not overlap. It returns the end
+// of the relocated data.
 
-	template<typename... ARGS>
-	inline iterator add_at(iterator pos, ARGS&&... args)
+template<typename IT, typename T>
+inline T* uninitialized_relocate(IT src, IT end, T* dst)
+{
+	if constexpr (is_trivially_relocatable_v<T>)
 	{
-		assert(size() < capacity());
-		assert(pos >= data_begin() && pos <= data_end());
-
-		if (empty() || pos == data_begin())
-			add_front(std::forward<ARGS>(args)...);
-		else
-			pos = front_add_at(data_begin(), pos, [this](){ ++m_size; }, std::forward<ARGS>(args)...);
-		return pos;
+		auto [first, second] = data_spans(src, end);
+		relocate_bytes(dst, first.data(), first.size());
+		relocate_bytes(dst + first.size(), second.data(), second.size());
+		return dst + (end - src);
 	}
-	template<typename... ARGS>
-	inline void add_front(ARGS&&... args)
+	else
 	{
-		assert(size() < capacity());
-		new(data_begin() - 1) value_type(std::forward<ARGS>(args)...);
-		++m_size;
+		auto dst_end = uninitialized_move_if_noexcept(src, end, dst);
+		destroy_data(src, end);
+		return dst_end;
 	}
-	template<typename... ARGS>
-	inline void add_back(ARGS&&... args)
+}
+
+// This overload leaves an uninitialized gap of 'count' elements in the destination where 'pos' was. Nothing
+// is destroyed until all of the elements have been moved, so if a move throws the source is unchanged.
+// It returns the start of the gap.
+
+template<typename IT, typename T>
+inline T* uninitialized_relocate(IT src, IT pos, IT end, T* dst, size_t count)
+{
+	if constexpr (is_trivially_relocatable_v<T>)
 	{
-		add_at(data_end(), std::forward<ARGS>(args)...);
+		uninitialized_relocate(src, pos, dst);
+		uninitialized_relocate(pos, end, dst + (pos - src) + count);
+		return dst + (pos - src);
 	}
-
-	inline void erase(value_type* erase_begin, value_type* erase_end)
+	else
 	{
-		front_erase(data_begin(), erase_begin, erase_end);
-		m_size -= erase_end - erase_begin;
+		auto gap = uninitialized_move_if_noexcept(src, pos, dst);
+		try
+		{
+			uninitialized_move_if_noexcept(pos, end, gap + count);
+		}
+		catch (...)
+		{
+			destroy_data(dst, gap);
+			throw;
+		}
+		destroy_data(src, end);
+		return gap;
 	}
-	inline void erase(value_type* element)
+}
+
+// The shift_data function moves the elements in [begin, end) by 'offset' positions within a capacity.
+// The destination slots outside of [begin, end) must be uninitialized, and the vacated slots are left
+// uninitialized. The elements are moved in a single pass (a memmove for trivially relocatable types in
+// contiguous memory) starting from the far end so that no element is overwritten before it has been moved.
+// This and the following element algorithms take iterators so that they also work on ring_iterators.
+// The memmove and placement new shortcuts they take are skipped during constant evaluation.
+
+template<typename IT>
+constexpr void shift_data(IT begin, IT end, std::ptrdiff_t offset)
+{
+	using T = std::iter_value_t<IT>;
+
+	if constexpr (std::is_pointer_v<IT> && is_trivially_relocatable_v<T>)
 	{
-		front_erase(data_begin(), element);
-		--m_size;
+		if !consteval
+		{
+			relocate_bytes(begin + offset, begin, end - begin);
+			return;
+		}
 	}
-	inline void pop_front()
+
+	// Shifting toward the back: elements landing beyond the old data are constructed, the others
+	// are assigned, and the ones left behind are destroyed.
+	if (offset > 0)
 	{
-		data_begin()->~value_type();
-		--m_size;
+		auto src = end;
+		auto dst = end + offset;
+		while (src != begin)
+		{
+			if (--dst >= end)
+				std::construct_at(std::addressof(*dst), std::move(*--src));
+			else
+				*dst = std::move(*--src);
+		}
+		destroy_data(begin, std::min(begin + offset, end));
 	}
-	inline void pop_back()
+
+	// Shifting toward the front.
+	else if (offset < 0)
 	{
-		erase(data_end() - 1);
+		auto src = begin;
+		auto dst = begin + offset;
+		while (src != end)
+		{
+			if (dst < begin)
+				std::construct_at(std::addressof(*dst++), std::move(*src++));
+			else
+				*dst++ = std::move(*src++);
+		}
+		destroy_data(std::max(end + offset, begin), end);
 	}
+}
 
-	void prepare_for(size_type size) {}
+// The size_class function rounds an allocation size in bytes up to the size class a typical allocator
+// (e.g. jemalloc or mimalloc) would actually provide for it. There are four classes for each power of two
+// (with a minimum spacing of 16 bytes), so the rounding never adds more than a quarter.
 
-protected:
+constexpr size_t size_class(size_t bytes)
+{
+	if (bytes <= 16)
+		return 16;
+	auto spacing = std::max<size_t>(std::bit_floor(bytes - 1) / 4, 16);
+	return (bytes + spacing - 1) / spacing * spacing;
+}
 
-	auto new_data_start(size_type size) { return capacity_end() - size; }
-	auto data_area() const { return m_size; }
-	void set_data_area(size_type size) { m_size = size; }
-	void set_size(size_type size) { m_size = size; }
+// The adopt_data function moves the elements of an adopted buffer so that they start at 'new_begin' (which
+// is within the buffer's capacity) and returns their new end.
 
-private:
+template<typename T>
+inline T* adopt_data(const sequence_buffer<T>& buffer, T* new_begin)
+{
+	assert(buffer.data_begin <= buffer.data_end);
+	assert(buffer.data_begin == buffer.data_end ||
+		(buffer.data_begin >= buffer.capacity_begin && buffer.data_end <= buffer.capacity_begin + buffer.capacity));
+
+	if (buffer.data_begin == buffer.data_end)
+		return new_begin;
+	if (new_begin != buffer.data_begin)
+		shift_data(buffer.data_begin, buffer.data_end, new_begin - buffer.data_begin);
+	return new_begin + (buffer.data_end - buffer.data_begin);
+}
 
-	size_type m_size = 0;
-};
+// The gap functions open and close an uninitialized gap of 'count' elements at 'pos'. The elements
+// before the gap move to 'new_begin' and the elements after it move by the same amount plus (or minus)
+// the gap size. Whichever block is moving toward the back is moved first so they never collide.
+// open_gap returns the new location of the gap.
 
-template<typename T, sequence_traits TRAITS>
-class fixed_storage<T, TRAITS, sequence_location_lits::MIDDLE> : public fixed_capacity<T, TRAITS.capacity>
+template<typename IT>
+constexpr IT open_gap(IT data_begin, IT data_end, IT pos, IT new_begin, size_t count)
 {
-	using inherited = fixed_capacity<T, TRAITS.capacity>;
-	using value_type = T;
-	using iterator = value_type*;
-	using const_iterator = const value_type*;
-	using size_type = typename decltype(TRAITS)::size_type;
-	using area_type = std::pair<size_type, size_type>;
-
-public:
+	auto head_shift = new_begin - data_begin;
+	auto tail_shift = head_shift + static_cast<std::ptrdiff_t>(count);
 
-	using inherited::capacity;
-	using inherited::capacity_begin;
-	using inherited::capacity_end;
+	if (tail_shift > 0)
+	{
+		shift_data(pos, data_end, tail_shift);
+		shift_data(data_begin, pos, head_shift);
+	}
+	else
+	{
+		shift_data(data_begin, pos, head_shift);
+		shift_data(pos, data_end, tail_shift);
+	}
+	return pos + head_shift;
+}
 
-	inline iterator data_begin() { return capacity_begin() + m_front_gap; }
-	inline iterator data_end() { return capacity_end() - m_back_gap; }
-	inline const_iterator data_begin() const { return capacity_begin() + m_front_gap; }
-	inline const_iterator data_end() const { return capacity_end() - m_back_gap; }
-	inline size_t size() const { return capacity() - (m_front_gap + m_back_gap); }
-	inline bool empty() const { return m_front_gap + m_back_gap == capacity(); }
+template<typename IT>
+constexpr void close_gap(IT data_begin, IT data_end, IT gap, IT new_begin, size_t count)
+{
+	auto head_shift = new_begin - data_begin;
+	auto tail_shift = head_shift - static_cast<std::ptrdiff_t>(count);
 
-	template<typename... ARGS>
-	inline iterator add_at(iterator pos, ARGS&&... args)
+	if (tail_shift > 0)
 	{
-		assert(size() < capacity());
-		assert(pos >= data_begin() && pos <= data_end());
+		shift_data(gap + count, data_end, tail_shift);
+		shift_data(data_begin, gap, head_shift);
+	}
+	else
+	{
+		shift_data(data_begin, gap, head_shift);
+		shift_data(gap + count, data_end, tail_shift);
+	}
+}
 
-		if (empty() || pos == data_end())
-			add_back(std::forward<ARGS>(args)...);
-		else if (pos == data_begin())
-			add_front(std::forward<ARGS>(args)...);
+// The middle_gap_begin function decides where the elements of a MIDDLE location capacity will start when
+// a gap is opened at 'pos'. As when adding a single element, the shorter side is shifted if there
+// is room for the gap on that side, otherwise the elements are recentered around the gap.
+// The new elements of an empty sequence are always placed using 'bias' (see sequence_traits::middle_gap),
+// and recentered placements keep the 'alignment' of 'traits' for elements of 'element_size' bytes.
 
-		// Inserting closer to the end--add at back.
-		else if (pos - data_begin() >= data_end() - pos)
-		{
-			if (m_back_gap == 0)
-			{
-				recenter();
-				pos -= m_back_gap;
-			}
-			pos = back_add_at(data_end(), pos, [this](){ --m_back_gap; }, std::forward<ARGS>(args)...);
-		}
-		
-		// Inserting closer to the beginning--add at front.
-		else
+template<typename T, typename TRAITS = sequence_traits<>>
+constexpr T* middle_gap_begin(T* capacity_begin, T* capacity_end, T* data_begin, T* data_end, T* pos, size_t count,
+	float bias = 0.5f, const TRAITS& traits = {}, size_t element_size = sizeof(T))
+{
+	auto room = static_cast<std::ptrdiff_t>(count);
+
+	if (data_begin != data_end)
+	{
+		if (pos - data_begin >= data_end - pos)
 		{
-			if (m_front_gap == 0)
-			{
-				recenter();
-				pos += m_front_gap;
-			}
-			pos = front_add_at(data_begin(), pos, [this](){ --m_front_gap; }, std::forward<ARGS>(args)...);
+			if (capacity_end - data_end >= room)
+				return data_begin;
 		}
-		return pos;
-	}
-	template<typename... ARGS>
-	inline void add_front(ARGS&&... args)
-	{
-		assert(size() < capacity());
-		if (m_front_gap == 0)
-			recenter();
-		new(data_begin() - 1) value_type(std::forward<ARGS>(args)...);
-		--m_front_gap;
+		else if (data_begin - capacity_begin >= room)
+			return data_begin - room;
 	}
-	template<typename... ARGS>
-	inline void add_back(ARGS&&... args)
+
+	auto capacity = capacity_end - capacity_begin;
+	auto size = (data_end - data_begin) + room;
+	return capacity_begin + traits.middle_gap(capacity - size, bias, element_size);
+}
+
+// The uninitialized_construct_n function constructs 'count' elements from 'args' (which are not forwarded,
+// since they are used for every element). Value-initialization and copying use the standard algorithms,
+// which reduce to memset and memcpy/fill for trivial types. If a constructor throws, the elements
+// constructed so far are destroyed. It returns the end of the constructed elements.
+
+template<typename IT, typename... ARGS>
+constexpr IT uninitialized_construct_n(IT dst, size_t count, ARGS&... args)
+{
+	using T = std::iter_value_t<IT>;
+
+	if consteval
 	{
-		assert(size() < capacity());
-		if (m_back_gap == 0)
-			recenter();
-		new(data_end()) value_type(std::forward<ARGS>(args)...);
-		--m_back_gap;
+		for (; count; --count, ++dst)
+			std::construct_at(std::addressof(*dst), args...);
+		return dst;
 	}
-
-	inline void erase(value_type* erase_begin, value_type* erase_end)
+	if constexpr (sizeof...(ARGS) == 0)
+		return std::uninitialized_value_construct_n(dst, count);
+	else if constexpr (sizeof...(ARGS) == 1 && (std::same_as<std::remove_cv_t<ARGS>, T> && ...))
+		return std::uninitialized_fill_n(dst, count, args...);
+	else
 	{
-		// If we are erasing nearer the back or dead center, erase at the back.
-		if (erase_begin - data_begin() >= data_end() - erase_end)
+		auto end = dst;
+		try
 		{
-			back_erase(data_end(), erase_begin, erase_end);
-			m_back_gap += erase_end - erase_begin;
+			for (; count; --count, ++end)
+				std::construct_at(std::addressof(*end), args...);
 		}
-		//  Otherwise erase at the front.
-		else
+		catch (...)
 		{
-			front_erase(data_begin(), erase_begin, erase_end);
-			m_front_gap += erase_end - erase_begin;
+			destroy_data(dst, end);
+			throw;
 		}
+		return end;
 	}
-	inline void erase(value_type* element)
+}
+
+// execution_policy is satisfied by the standard execution policies (e.g. std::execution::par), which select
+// the parallel overloads of some sequence functions.
+
+template<typename POLICY>
+concept execution_policy = std::is_execution_policy_v<std::remove_cvref_t<POLICY>>;
+
+// The parallel_pieces function returns how many pieces to split 'count' elements into so that all the cores
+// are kept busy, and parallel_piece returns where piece 'i' of them begins.
+
+inline size_t parallel_pieces(size_t count)
+{
+	return std::min<size_t>(count, 4 * std::max(std::thread::hardware_concurrency(), 1u));
+}
+inline size_t parallel_piece(size_t count, size_t pieces, size_t i)
+{
+	return count * i / pieces;
+}
+
+// The parallel_construct function constructs 'count' elements at 'dst' in pieces which run concurrently under
+// 'policy'. 'construct(first, last)' constructs the elements with the indexes [first, last) (and destroys them
+// if it throws). If any piece throws, the pieces which did not are destroyed and the first exception is
+// rethrown, so that (unlike with the standard parallel algorithms, which terminate) no elements are left
+// behind. It returns the end of the constructed elements.
+
+template<execution_policy POLICY, typename T, typename FUNC>
+inline T* parallel_construct(POLICY&& policy, T* dst, size_t count, FUNC construct)
+{
+	auto pieces = parallel_pieces(count);
+	auto indexes = std::make_unique<size_t[]>(pieces);
+	auto errors = std::make_unique<std::exception_ptr[]>(pieces);
+	std::iota(indexes.get(), indexes.get() + pieces, size_t(0));
+
+	std::for_each(policy, indexes.get(), indexes.get() + pieces, [&](size_t i)
 	{
-		// If we are erasing nearer the back or dead center, erase at the back. Otherwise erase at the front.
-		if (element - data_begin() >= data_end() - element)
+		try
 		{
-			back_erase(data_end(), element);
-			++m_back_gap;
+			construct(parallel_piece(count, pieces, i), parallel_piece(count, pieces, i + 1));
 		}
-		//  Otherwise erase at the front.
-		else
+		catch (...)
 		{
-			front_erase(data_begin(), element);
-			++m_front_gap;
+			errors[i] = std::current_exception();
 		}
-	}
-	inline void pop_front()
-	{
-		data_begin()->~value_type();
-		++m_front_gap;
-	}
-	inline void pop_back()
-	{
-		++m_back_gap;
-		data_end()->~value_type();
-	}
+	});
 
-	void prepare_for(size_type size)
+	if (auto failed = std::find_if(errors.get(), errors.get() + pieces, [](auto& error) { return error != nullptr; });
+		failed != errors.get() + pieces)
 	{
-		assert(empty());
-		m_front_gap = static_cast<size_type>(TRAITS.front_gap(size));
-		m_back_gap = static_cast<size_type>(TRAITS.capacity - m_front_gap);
+		for (size_t i = 0; i < pieces; ++i)
+			if (!errors[i])
+				destroy_data(dst + parallel_piece(count, pieces, i), dst + parallel_piece(count, pieces, i + 1));
+		std::rethrow_exception(*failed);
 	}
+	return dst + count;
+}
 
-protected:
-
-	// Returns the location in the capacity to write to with uninitialized_copy or _move.
-	auto new_data_start(size_type size) { return capacity_begin() + TRAITS.front_gap(size); }
-
-	area_type data_area() const { return {m_front_gap, m_back_gap}; }
-	void set_data_area(area_type area) { m_front_gap = area.first; m_back_gap = area.second; }
+// The parallel_destroy function destroys [data_begin, data_end) in pieces which run concurrently under 'policy'.
 
-	void set_size(size_type size)
+template<execution_policy POLICY, typename T>
+inline void parallel_destroy(POLICY&& policy, T* data_begin, T* data_end)
+{
+	if constexpr (!std::is_trivially_destructible_v<T>)
 	{
-		m_front_gap = static_cast<size_type>(TRAITS.front_gap(size));
-		m_back_gap = static_cast<size_type>(TRAITS.capacity - (m_front_gap + size));
+		size_t count = data_end - data_begin;
+		auto pieces = parallel_pieces(count);
+		auto indexes = std::make_unique<size_t[]>(pieces);
+		std::iota(indexes.get(), indexes.get() + pieces, size_t(0));
+
+		std::for_each(policy, indexes.get(), indexes.get() + pieces, [=](size_t i)
+		{
+			destroy_data(data_begin + parallel_piece(count, pieces, i), data_begin + parallel_piece(count, pieces, i + 1));
+		});
 	}
+}
 
-private:
+#ifdef SEQUENCE_POSIX_IO
 
-	// Moves the elements to the (approximate) center of the capacity to prepare for size growth.
-	// If the remaining space is odd, then the extra space will be at the front if we are making
-	// space at the front, otherwise it will be at the back.
-	
-	inline void recenter()
-	{
-		auto [front_gap, back_gap] = ::recenter<inherited>(capacity_begin(), capacity_end(), data_begin(), data_end());
-		m_front_gap = static_cast<size_type>(front_gap);
-		m_back_gap = static_cast<size_type>(back_gap);
+// The io_pieces function writes the bytes of 'pieces' to 'fd' in order (with writev), or reads into them (with
+// readv), in as few calls as possible. It carries on after partial transfers and interruptions, and throws
+// std::system_error if a call fails. It returns the number of bytes transferred, which is only less than the
+// total if a read reaches the end of the file.
+
+template<bool READ, typename BYTE>
+inline size_t io_pieces(int fd, std::span<const std::span<BYTE>> pieces)
+{
+#ifdef IOV_MAX
+	constexpr size_t max_batch = std::min(IOV_MAX, 1024);
+#else
+	constexpr size_t max_batch = 16;
+#endif
+	iovec batch[max_batch];
+	size_t done = 0;
+	size_t piece = 0, offset = 0;			// The next byte is 'offset' into 'pieces[piece]'.
+
+	for (;;)
+	{
+		int count = 0;
+		for (size_t i = piece, skip = offset; i < pieces.size() && count < int(max_batch); ++i, skip = 0)
+			if (pieces[i].size() > skip)
+				batch[count++] = { const_cast<std::byte*>(pieces[i].data()) + skip, pieces[i].size() - skip };
+		if (count == 0)
+			return done;
+
+		auto result = READ ? ::readv(fd, batch, count) : ::writev(fd, batch, count);
+		if (result < 0 && errno == EINTR)
+			continue;
+		if (result < 0)
+			throw std::system_error(errno, std::generic_category(), READ ? "readv" : "writev");
+		if (result == 0)
+			return done;
+
+		done += result;
+		for (size_t left = result; left > 0; )
+		{
+			auto rest = std::min(left, pieces[piece].size() - offset);
+			left -= rest;
+			offset += rest;
+			if (offset == pieces[piece].size())
+				++piece, offset = 0;
+		}
 	}
+}
 
-	// Empty sequences with odd capacity will have the extra space at the back.
+// write_pieces - Writes the bytes of 'pieces' to the file descriptor 'fd' (see io_pieces). This lets any number
+// of serialized sequences be written together (see sequence::byte_pieces). This is fully documented in the
+// README.md file.
 
-	size_type m_front_gap = static_cast<size_type>(TRAITS.front_gap());
-	size_type m_back_gap = static_cast<size_type>(TRAITS.capacity - TRAITS.front_gap());
-};
+export inline void write_pieces(int fd, std::span<const std::span<const std::byte>> pieces)
+{
+	io_pieces<false>(fd, pieces);
+}
 
-// Forward declaration so that the sequence storage types can refer to each other.
+#endif
 
-template<sequence_location_lits LOC, typename T, sequence_traits TRAITS>
-class dynamic_sequence_storage;
+// The sequence_storage_implementation concept describes the storage classes which can be used as a source
+// of elements by the storage constructors which change the kind of storage (e.g. when going from a buffered
+// capacity to a dynamic one).
 
+template<typename T>
+concept sequence_storage_implementation = requires(T& t)
+{
+	t.capacity_begin();
+	t.capacity_end();
+	t.data_begin();
+	t.data_end();
+	t.size();
+};
 
-// ==============================================================================================================
-// fixed_sequence_storage - This class provides fixed capacity sequences (which may be static or
-// dynamically allocated). It offers three element management strategies.
+// The uninitialized_transfer function relocates (if it's an rvalue) or copies (otherwise) the elements of
+// a storage into uninitialized memory. A relocated source is left empty. It returns the end of the
+// transferred data.
 
-template<typename T, sequence_traits TRAITS>
-class fixed_sequence_storage : public fixed_storage<T, TRAITS>
+template<sequence_storage_implementation SEQ, typename T>
+inline T* uninitialized_transfer(SEQ&& src, T* dst)
 {
-	using value_type = T;
-	using iterator = value_type*;
+	if constexpr (std::is_rvalue_reference_v<SEQ&&>)
+	{
+		auto dst_end = uninitialized_relocate(src.data_begin(), src.data_end(), dst);
+		src.release_data();
+		return dst_end;
+	}
+	else
+		return std::uninitialized_copy(src.data_begin(), src.data_end(), dst);
+}
+
+
+// The add functions implement the algorithms for adding an element at the front
+// or back. These algorithms are used for both fixed and dynamic storage. Trivially relocatable
+// elements in contiguous memory are shifted with a single memmove, and the new element is built
+// in raw storage so that it can be relocated into place as well.
+// If IN_PLACE is true (see sequence_traits::in_place_emplace) the elements are shifted first and the
+// new element is constructed directly in the gap, so the arguments must not refer to the elements.
+// If the constructor throws the elements are shifted back, which cannot fail for trivially relocatable
+// elements (so the sequence is unchanged), otherwise it moves them again.
+
+template<bool IN_PLACE = false, typename IT, std::regular_invocable FUNC, typename... ARGS>
+constexpr IT front_add_at(IT dst, IT pos, FUNC adjust, ARGS&&... args)
+{
+	using T = std::iter_value_t<IT>;
+
+	if constexpr (std::is_pointer_v<IT> && is_trivially_relocatable_v<T>)
+	{
+		if !consteval
+		{
+			if constexpr (IN_PLACE)
+			{
+				relocate_bytes(dst - 1, dst, pos - dst);
+				try
+				{
+					new(pos - 1) T(std::forward<ARGS>(args)...);
+				}
+				catch (...)
+				{
+					relocate_bytes(dst, dst - 1, pos - dst);
+					throw;
+				}
+				adjust();
+				return --pos;
+			}
+			alignas(T) unsigned char temp[sizeof(T)];
+			new(temp) T(std::forward<ARGS>(args)...);	// Do this first in case the T ctor throws.
+			relocate_bytes(dst - 1, dst, pos - dst);
+			adjust();
+			relocate_bytes(--pos, reinterpret_cast<T*>(temp), 1);
+			return pos;
+		}
+	}
+	if constexpr (IN_PLACE)
+	{
+		auto first = dst - 1;
+		std::construct_at(std::addressof(*first), std::move(*dst));
+		--pos;
+		for (auto src = dst + 1; dst != pos;)
+			*dst++ = std::move(*src++);
+		std::destroy_at(std::addressof(*pos));
+		try
+		{
+			std::construct_at(std::addressof(*pos), std::forward<ARGS>(args)...);
+		}
+		catch (...)
+		{
+			std::construct_at(std::addressof(*pos), std::move(*(pos - 1)));
+			for (auto back = pos - 1; back != first; --back)
+				*back = std::move(*(back - 1));
+			std::destroy_at(std::addressof(*first));
+			throw;
+		}
+		adjust();
+		return pos;
+	}
+	else
+	{
+		T temp(std::forward<ARGS>(args)...);	// Do this first in case the T ctor throws.
+		std::construct_at(std::addressof(*(dst - 1)), std::move(*dst));
+		adjust();
+		--pos;
+		for (auto src = dst + 1; dst != pos;)
+			*dst++ = std::move(*src++);
+		*pos = std::move(temp);
+		return pos;
+	}
+}
+
+template<bool IN_PLACE = false, typename IT, std::regular_invocable FUNC, typename... ARGS>
+constexpr IT back_add_at(IT dst, IT pos, FUNC adjust, ARGS&&... args)
+{
+	using T = std::iter_value_t<IT>;
+
+	if constexpr (std::is_pointer_v<IT> && is_trivially_relocatable_v<T>)
+	{
+		if !consteval
+		{
+			if constexpr (IN_PLACE)
+			{
+				relocate_bytes(pos + 1, pos, dst - pos);
+				try
+				{
+					new(pos) T(std::forward<ARGS>(args)...);
+				}
+				catch (...)
+				{
+					relocate_bytes(pos, pos + 1, dst - pos);
+					throw;
+				}
+				adjust();
+				return pos;
+			}
+			alignas(T) unsigned char temp[sizeof(T)];
+			new(temp) T(std::forward<ARGS>(args)...);	// Do this first in case the T ctor throws.
+			relocate_bytes(pos + 1, pos, dst - pos);
+			adjust();
+			relocate_bytes(pos, reinterpret_cast<T*>(temp), 1);
+			return pos;
+		}
+	}
+	if constexpr (IN_PLACE)
+	{
+		auto last = dst;
+		std::construct_at(std::addressof(*last), std::move(*(dst - 1)));
+		for (auto src = --dst - 1; dst != pos;)
+			*dst-- = std::move(*src--);
+		std::destroy_at(std::addressof(*pos));
+		try
+		{
+			std::construct_at(std::addressof(*pos), std::forward<ARGS>(args)...);
+		}
+		catch (...)
+		{
+			std::construct_at(std::addressof(*pos), std::move(*(pos + 1)));
+			for (auto front = pos + 1; front != last; ++front)
+				*front = std::move(*(front + 1));
+			std::destroy_at(std::addressof(*last));
+			throw;
+		}
+		adjust();
+		return pos;
+	}
+	else
+	{
+		T temp(std::forward<ARGS>(args)...);	// Do this first in case the T ctor throws.
+		std::construct_at(std::addressof(*dst), std::move(*(dst - 1)));
+		adjust();
+		for (auto src = --dst - 1; dst != pos;)
+			*dst-- = std::move(*src--);
+		*pos = std::move(temp);
+		return pos;
+	}
+}
+
+// The erase functions implement the erase element and erase range algorithms for front
+// and back erasure. These algorithms are used for both fixed and dynamic storage. Trivially
+// relocatable elements in contiguous memory are destroyed and the remaining elements closed up
+// with a single memmove.
+
+template<typename IT>
+constexpr void front_erase(IT data_begin, IT erase_begin, IT erase_end)
+{
+	using T = std::iter_value_t<IT>;
+
+	assert(erase_begin >= data_begin);
+	assert(erase_end >= erase_begin);
+
+	if constexpr (std::is_pointer_v<IT> && is_trivially_relocatable_v<T>)
+	{
+		if !consteval
+		{
+			destroy_data(erase_begin, erase_end);
+			relocate_bytes(data_begin + (erase_end - erase_begin), data_begin, erase_begin - data_begin);
+			return;
+		}
+	}
+	if (erase_begin != erase_end)
+	{
+		auto beg = data_begin - 1;
+		auto dst = erase_end - 1;
+		auto src = erase_begin - 1;
+		while (src != beg)
+			*dst-- = std::move(*src--);
+		destroy_data(data_begin, ++dst);
+	}
+}
+
+template<typename IT>
+constexpr void front_erase(IT data_begin, IT element)
+{
+	using T = std::iter_value_t<IT>;
+
+	assert(element >= data_begin);
+
+	if constexpr (std::is_pointer_v<IT> && is_trivially_relocatable_v<T>)
+	{
+		if !consteval
+		{
+			element->~T();
+			relocate_bytes(data_begin + 1, data_begin, element - data_begin);
+			return;
+		}
+	}
+
+	auto src = element - 1;
+	while (element != data_begin)
+		*element-- = std::move(*src--);
+	destroy_data(element, element + 1);
+}
+
+template<typename IT>
+constexpr void back_erase(IT data_end, IT erase_begin, IT erase_end)
+{
+	using T = std::iter_value_t<IT>;
+
+	assert(erase_end <= data_end);
+	assert(erase_end >= erase_begin);
+
+	if constexpr (std::is_pointer_v<IT> && is_trivially_relocatable_v<T>)
+	{
+		if !consteval
+		{
+			destroy_data(erase_begin, erase_end);
+			relocate_bytes(erase_begin, erase_end, data_end - erase_end);
+			return;
+		}
+	}
+	if (erase_begin != erase_end)
+	{
+		auto dst = erase_begin;
+		auto src = erase_end;
+		while (src != data_end)
+			*dst++ = std::move(*src++);
+		destroy_data(dst, data_end);
+	}
+}
+
+template<typename IT>
+constexpr void back_erase(IT data_end, IT element)
+{
+	using T = std::iter_value_t<IT>;
+
+	assert(element < data_end);
+
+	if constexpr (std::is_pointer_v<IT> && is_trivially_relocatable_v<T>)
+	{
+		if !consteval
+		{
+			element->~T();
+			relocate_bytes(element, element + 1, data_end - (element + 1));
+			return;
+		}
+	}
+
+	auto src = element + 1;
+	while (src != data_end)
+		*element++ = std::move(*src++);
+	destroy_data(element, element + 1);
+}
+
+// The remove functions compact the elements kept by a removal (see sequence::remove_if and unique) toward the
+// front or back in a single pass, keeping their order. '*first' and '*last' are the first and last elements to
+// remove (possibly the same one), and 'test(it)' tells whether an element between them is removed, so only those
+// are tested and the elements outside them are simply shifted. The elements are tested in order from 'first'
+// (or down from 'last' when compacting toward the back, so the elements in front of the one being tested have
+// not moved). They return the new end (or begin) of the kept elements, and the elements beyond it are left
+// moved from. Contiguous trivially copyable elements are shifted a run of kept elements at a time.
+
+template<typename IT, typename TEST>
+constexpr IT remove_toward_front(IT first, IT last, IT data_end, TEST& test)
+{
+	using T = std::iter_value_t<IT>;
+
+	auto dst = first;
+	auto src = first;
+	if constexpr (std::is_pointer_v<IT> && std::is_trivially_copyable_v<T>)
+	{
+		while (src != last)
+		{
+			auto run = ++src;
+			while (run != last && !test(run))
+				++run;
+			relocate_bytes(dst, src, run - src);
+			dst += run - src;
+			src = run;
+		}
+		relocate_bytes(dst, last + 1, data_end - (last + 1));
+		return dst + (data_end - (last + 1));
+	}
+	else
+	{
+		while (src != last)
+			if (++src != last && !test(src))
+				*dst++ = std::move(*src);
+		while (++src != data_end)
+			*dst++ = std::move(*src);
+		return dst;
+	}
+}
+
+template<typename IT, typename TEST>
+constexpr IT remove_toward_back(IT data_begin, IT first, IT last, TEST& test)
+{
+	using T = std::iter_value_t<IT>;
+
+	auto dst = last + 1;
+	auto src = last;
+	if constexpr (std::is_pointer_v<IT> && std::is_trivially_copyable_v<T>)
+	{
+		while (src != first)
+		{
+			auto run = src;
+			while (--src != first && !test(src))
+				;
+			dst -= run - (src + 1);
+			relocate_bytes(dst, src + 1, run - (src + 1));
+		}
+		dst -= first - data_begin;
+		relocate_bytes(dst, data_begin, first - data_begin);
+		return dst;
+	}
+	else
+	{
+		while (src != first)
+			if (--src != first && !test(src))
+				*--dst = std::move(*src);
+		while (src != data_begin)
+			*--dst = std::move(*--src);
+		return dst;
+	}
+}
+
+// The recenter function shifts the elements in a MIDDLE location capacity to prepare for size growth.
+// The fraction 'bias' of the remaining space goes to the front (see sequence_traits::middle_gap). Any
+// rounding favours the side we are making space at, which always gets at least one element. The front gap
+// is also rounded to the granularity of 'traits' (unless the room is smaller), so that the shifted elements
+// start at an aligned position. It returns the new front and back gaps. The elements are shifted in place
+// (see shift_data), so no temporary capacity is needed.
+
+template<typename T, typename TRAITS = sequence_traits<>>
+constexpr std::pair<size_t, size_t> recenter(T* capacity_begin, T* capacity_end, T* data_begin, T* data_end,
+	float bias = 0.5f, const TRAITS& traits = {}, size_t element_size = sizeof(T))
+{
+	assert(data_begin == capacity_begin || data_end == capacity_end);
+	assert(data_begin != capacity_begin || data_end != capacity_end);
+
+	size_t capacity = capacity_end - capacity_begin;
+	size_t size = data_end - data_begin;
+	size_t room = capacity - size;
+	size_t unit = traits.granularity(element_size);
+
+	size_t fg;
+	if (data_begin == capacity_begin)
+	{
+		fg = std::min((room - traits.middle_gap(room, 1.f - bias, element_size) + unit - 1) / unit, room / unit) * unit;
+		fg = std::max<size_t>(fg, 1);
+	}
+	else
+		fg = std::min<size_t>(traits.middle_gap(room, bias, element_size), room - 1) / unit * unit;
+	auto bg = room - fg;
+
+	shift_data(data_begin, data_end, (capacity_begin + fg) - data_begin);
+	return {fg, bg};
+}
+
+// The linearize function makes the elements of a CIRCULAR location capacity contiguous in place, and returns
+// the index of the first element. If the data wraps around, the piece at the start of the capacity is shifted
+// up against the piece at the end, and then the two are rotated into order.
+
+template<typename T>
+inline size_t linearize(T* capacity_begin, size_t capacity, size_t head, size_t size)
+{
+	if (head + size <= capacity)
+		return head;
+
+	auto wrapped = head + size - capacity;
+	auto gap = capacity - size;
+	shift_data(capacity_begin, capacity_begin + wrapped, static_cast<std::ptrdiff_t>(gap));
+	std::rotate(capacity_begin + gap, capacity_begin + head, capacity_begin + capacity);
+	return gap;
+}
+
+}
+
+// ==============================================================================================================
+// fixed_capacity - This is the base class for fixed_storage instantiations. It handles the raw capacity.
+
+// The elements are aligned to at least ALIGN and followed by PAD bytes which are part of the object
+// (see sequence_traits::alignment and tail_padding).
+
+template<size_t PAD>
+struct tail_padding_bytes { unsigned char bytes[PAD]; };
+template<>
+struct tail_padding_bytes<0> {};
+
+template<typename T, size_t CAP, size_t ALIGN = 0, size_t PAD = 0> requires (CAP != 0)
+class fixed_capacity
+{
+	using value_type = T;
+
+public:
+
+	// Constant evaluation only allows access to the active member of a union, so there the elements are made
+	// the active member (and value-initialized). At run time they are left uninitialized.
+	constexpr fixed_capacity()
+	{
+		if consteval
+		{
+			if constexpr (std::is_default_constructible_v<T>)
+				std::construct_at(&elements);
+		}
+	}
+	constexpr fixed_capacity(size_t cap) : fixed_capacity() {}
+	constexpr ~fixed_capacity() {}
+
+	constexpr static size_t capacity() { return CAP; }
+
+	constexpr value_type* capacity_begin() { return elements; }
+	constexpr value_type* capacity_end() { return elements + CAP; }
+	constexpr const value_type* capacity_begin() const { return elements; }
+	constexpr const value_type* capacity_end() const { return elements + CAP; }
+
+private:
+
+	union
+	{
+		alignas(std::max(ALIGN, alignof(T))) value_type elements[CAP];
+		unsigned char unused;
+	};
+	NO_UNIQUE_ADDRESS tail_padding_bytes<PAD> padding;
+};
+
+
+// ==============================================================================================================
+// fixed_storage - This is the base class for the fixed_sequence_storage class. It provides
+// the three different element management strategies for fixed capacity sequences
+
+template<typename T, sequence_traits TRAITS, sequence_location_lits LOC = TRAITS.location>
+class fixed_storage
+{
+	static_assert(false, "An unimplemented specialization of fixed_storage was instantiated.");
+};
+
+
+template<typename T, sequence_traits TRAITS>
+class fixed_storage<T, TRAITS, sequence_location_lits::FRONT> : public fixed_capacity<T, TRAITS.capacity, TRAITS.alignment, TRAITS.tail_padding>
+{
+	using inherited = fixed_capacity<T, TRAITS.capacity, TRAITS.alignment, TRAITS.tail_padding>;
+	using value_type = T;
+	using iterator = value_type*;
 	using const_iterator = const value_type*;
-	using reference = value_type&;
 	using size_type = typename decltype(TRAITS)::size_type;
-	using inherited = fixed_storage<T, TRAITS>;
 
-	using inherited::new_data_start;
-	using inherited::data_area;
-	using inherited::set_data_area;
-	using inherited::set_size;
+public:
+
+	using inherited::capacity;
+	using inherited::capacity_begin;
+	using inherited::capacity_end;
+
+	constexpr iterator data_begin() { return capacity_begin(); }
+	constexpr iterator data_end() { return capacity_begin() + m_size; }
+	constexpr const_iterator data_begin() const { return capacity_begin(); }
+	constexpr const_iterator data_end() const { return capacity_begin() + m_size; }
+	constexpr size_t size() const { return m_size; }
+	constexpr bool empty() const { return m_size == 0; }
+
+	template<typename... ARGS>
+	constexpr iterator add_at(iterator pos, ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		if (empty() || pos == data_end())
+			add_back(std::forward<ARGS>(args)...);
+		else
+			pos = back_add_at<TRAITS.in_place_emplace>(data_end(), pos, [this](){ ++m_size; }, std::forward<ARGS>(args)...);
+		return pos;
+	}
+	template<typename... ARGS>
+	constexpr void add_front(ARGS&&... args)
+	{
+		add_at(data_begin(), std::forward<ARGS>(args)...);
+	}
+	template<typename... ARGS>
+	constexpr void add_back(ARGS&&... args)
+	{
+		assert(size() < capacity());
+		std::construct_at(data_end(), std::forward<ARGS>(args)...);
+		++m_size;
+	}
+
+	constexpr void erase(value_type* erase_begin, value_type* erase_end)
+	{
+		back_erase(data_end(), erase_begin, erase_end);
+		m_size -= erase_end - erase_begin;
+	}
+	constexpr void erase(value_type* element)
+	{
+		back_erase(data_end(), element);
+		--m_size;
+	}
+	constexpr void pop_front()
+	{
+		erase(data_begin());
+	}
+	constexpr void pop_back()
+	{
+		--m_size;
+		data_end()->~value_type();
+	}
+
+	constexpr void prepare_for(size_type size) {}
+
+	// Opens an uninitialized gap of 'count' elements at 'pos' (which is included in the size), or closes
+	// one again. The caller constructs the elements in the gap.
+	constexpr iterator open_gap(iterator pos, size_type count)
+	{
+		assert(size() + count <= capacity());
+		pos = ::open_gap(data_begin(), data_end(), pos, data_begin(), count);
+		m_size += count;
+		return pos;
+	}
+	constexpr void close_gap(iterator gap, size_type count)
+	{
+		::close_gap(data_begin(), data_end(), gap, data_begin(), count);
+		m_size -= count;
+	}
+
+protected:
+
+	constexpr auto new_data_start(size_type size) { return capacity_begin(); }
+	constexpr auto data_area() const { return m_size; }
+	constexpr void set_data_area(size_type size) { m_size = size; }
+	constexpr void set_size(size_type size) { m_size = size; }
+
+private:
+
+	size_type m_size = 0;
+};
+
+template<typename T, sequence_traits TRAITS>
+class fixed_storage<T, TRAITS, sequence_location_lits::BACK> : public fixed_capacity<T, TRAITS.capacity, TRAITS.alignment, TRAITS.tail_padding>
+{
+	using inherited = fixed_capacity<T, TRAITS.capacity, TRAITS.alignment, TRAITS.tail_padding>;
+	using value_type = T;
+	using iterator = value_type*;
+	using const_iterator = const value_type*;
+	using size_type = typename decltype(TRAITS)::size_type;
+
+public:
+
+	using inherited::capacity;
+	using inherited::capacity_begin;
+	using inherited::capacity_end;
+
+	constexpr iterator data_begin() { return capacity_end() - m_size; }
+	constexpr iterator data_end() { return capacity_end(); }
+	constexpr const_iterator data_begin() const { return capacity_end() - m_size; }
+	constexpr const_iterator data_end() const { return capacity_end(); }
+	constexpr size_t size() const { return m_size; }
+	constexpr bool empty() const { return m_size == 0; }
+
+	template<typename... ARGS>
+	constexpr iterator add_at(iterator pos, ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		if (empty() || pos == data_begin())
+		{
+			add_front(std::forward<ARGS>(args)...);
+			pos = data_begin();
+		}
+		else
+			pos = front_add_at<TRAITS.in_place_emplace>(data_begin(), pos, [this](){ ++m_size; }, std::forward<ARGS>(args)...);
+		return pos;
+	}
+	template<typename... ARGS>
+	constexpr void add_front(ARGS&&... args)
+	{
+		assert(size() < capacity());
+		std::construct_at(data_begin() - 1, std::forward<ARGS>(args)...);
+		++m_size;
+	}
+	template<typename... ARGS>
+	constexpr void add_back(ARGS&&... args)
+	{
+		add_at(data_end(), std::forward<ARGS>(args)...);
+	}
+
+	constexpr void erase(value_type* erase_begin, value_type* erase_end)
+	{
+		front_erase(data_begin(), erase_begin, erase_end);
+		m_size -= erase_end - erase_begin;
+	}
+	constexpr void erase(value_type* element)
+	{
+		front_erase(data_begin(), element);
+		--m_size;
+	}
+	constexpr void pop_front()
+	{
+		data_begin()->~value_type();
+		--m_size;
+	}
+	constexpr void pop_back()
+	{
+		erase(data_end() - 1);
+	}
+
+	constexpr void prepare_for(size_type size) {}
+
+	// Opens an uninitialized gap of 'count' elements at 'pos' (which is included in the size), or closes
+	// one again. The caller constructs the elements in the gap.
+	constexpr iterator open_gap(iterator pos, size_type count)
+	{
+		assert(size() + count <= capacity());
+		pos = ::open_gap(data_begin(), data_end(), pos, data_begin() - count, count);
+		m_size += count;
+		return pos;
+	}
+	constexpr void close_gap(iterator gap, size_type count)
+	{
+		::close_gap(data_begin(), data_end(), gap, data_begin() + count, count);
+		m_size -= count;
+	}
+
+protected:
+
+	constexpr auto new_data_start(size_type size) { return capacity_end() - size; }
+	constexpr auto data_area() const { return m_size; }
+	constexpr void set_data_area(size_type size) { m_size = size; }
+	constexpr void set_size(size_type size) { m_size = size; }
+
+private:
+
+	size_type m_size = 0;
+};
+
+template<typename T, sequence_traits TRAITS>
+class fixed_storage<T, TRAITS, sequence_location_lits::MIDDLE> : public fixed_capacity<T, TRAITS.capacity, TRAITS.alignment, TRAITS.tail_padding>
+{
+	using inherited = fixed_capacity<T, TRAITS.capacity, TRAITS.alignment, TRAITS.tail_padding>;
+	using value_type = T;
+	using iterator = value_type*;
+	using const_iterator = const value_type*;
+	using size_type = typename decltype(TRAITS)::size_type;
+	using area_type = std::pair<size_type, size_type>;
+
+public:
+
+	using inherited::capacity;
+	using inherited::capacity_begin;
+	using inherited::capacity_end;
+
+	constexpr iterator data_begin() { return capacity_begin() + m_front_gap; }
+	constexpr iterator data_end() { return capacity_end() - m_back_gap; }
+	constexpr const_iterator data_begin() const { return capacity_begin() + m_front_gap; }
+	constexpr const_iterator data_end() const { return capacity_end() - m_back_gap; }
+	constexpr size_t size() const { return capacity() - (m_front_gap + m_back_gap); }
+	constexpr bool empty() const { return m_front_gap + m_back_gap == capacity(); }
+
+	template<typename... ARGS>
+	constexpr iterator add_at(iterator pos, ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		if (empty() || pos == data_end())
+		{
+			add_back(std::forward<ARGS>(args)...);
+			pos = data_end() - 1;
+		}
+		else if (pos == data_begin())
+		{
+			add_front(std::forward<ARGS>(args)...);
+			pos = data_begin();
+		}
+
+		// Inserting closer to the end--add at back.
+		else if (pos - data_begin() >= data_end() - pos)
+		{
+			if (m_back_gap == 0)
+			{
+				recenter();
+				pos -= m_back_gap;
+			}
+			pos = back_add_at<TRAITS.in_place_emplace>(data_end(), pos, [this](){ --m_back_gap; }, std::forward<ARGS>(args)...);
+		}
+		
+		// Inserting closer to the beginning--add at front.
+		else
+		{
+			if (m_front_gap == 0)
+			{
+				recenter();
+				pos += m_front_gap;
+			}
+			pos = front_add_at<TRAITS.in_place_emplace>(data_begin(), pos, [this](){ --m_front_gap; }, std::forward<ARGS>(args)...);
+		}
+		return pos;
+	}
+	template<typename... ARGS>
+	constexpr void add_front(ARGS&&... args)
+	{
+		assert(size() < capacity());
+		if (m_front_gap == 0)
+			recenter();
+		std::construct_at(data_begin() - 1, std::forward<ARGS>(args)...);
+		--m_front_gap;
+	}
+	template<typename... ARGS>
+	constexpr void add_back(ARGS&&... args)
+	{
+		assert(size() < capacity());
+		if (m_back_gap == 0)
+			recenter();
+		std::construct_at(data_end(), std::forward<ARGS>(args)...);
+		--m_back_gap;
+	}
+
+	constexpr void erase(value_type* erase_begin, value_type* erase_end)
+	{
+		// If we are erasing nearer the back or dead center, erase at the back.
+		if (erase_begin - data_begin() >= data_end() - erase_end)
+		{
+			back_erase(data_end(), erase_begin, erase_end);
+			m_back_gap += erase_end - erase_begin;
+		}
+		//  Otherwise erase at the front.
+		else
+		{
+			front_erase(data_begin(), erase_begin, erase_end);
+			m_front_gap += erase_end - erase_begin;
+		}
+	}
+	constexpr void erase(value_type* element)
+	{
+		// If we are erasing nearer the back or dead center, erase at the back. Otherwise erase at the front.
+		if (element - data_begin() >= data_end() - element)
+		{
+			back_erase(data_end(), element);
+			++m_back_gap;
+		}
+		//  Otherwise erase at the front.
+		else
+		{
+			front_erase(data_begin(), element);
+			++m_front_gap;
+		}
+	}
+	constexpr void pop_front()
+	{
+		data_begin()->~value_type();
+		++m_front_gap;
+	}
+	constexpr void pop_back()
+	{
+		++m_back_gap;
+		data_end()->~value_type();
+	}
+
+	constexpr void prepare_for(size_type size)
+	{
+		assert(empty());
+		m_front_gap = static_cast<size_type>(TRAITS.front_gap(TRAITS.capacity, size, sizeof(T)));
+		m_back_gap = static_cast<size_type>(TRAITS.capacity - m_front_gap);
+	}
+
+	// Opens an uninitialized gap of 'count' elements at 'pos' (which is included in the size), or closes
+	// one again. The caller constructs the elements in the gap.
+	constexpr iterator open_gap(iterator pos, size_type count)
+	{
+		assert(size() + count <= capacity());
+		auto new_size = size() + count;
+		auto new_begin = middle_gap_begin(capacity_begin(), capacity_end(), data_begin(), data_end(), pos, count, TRAITS.front_bias, TRAITS);
+		pos = ::open_gap(data_begin(), data_end(), pos, new_begin, count);
+		m_front_gap = static_cast<size_type>(new_begin - capacity_begin());
+		m_back_gap = static_cast<size_type>(capacity() - (m_front_gap + new_size));
+		return pos;
+	}
+	constexpr void close_gap(iterator gap, size_type count)
+	{
+		// Close up the shorter side.
+		if (gap - data_begin() >= data_end() - (gap + count))
+		{
+			::close_gap(data_begin(), data_end(), gap, data_begin(), count);
+			m_back_gap += count;
+		}
+		else
+		{
+			::close_gap(data_begin(), data_end(), gap, data_begin() + count, count);
+			m_front_gap += count;
+		}
+	}
+
+protected:
+
+	// Returns the location in the capacity to write to with uninitialized_copy or _move.
+	constexpr auto new_data_start(size_type size) { return capacity_begin() + TRAITS.front_gap(TRAITS.capacity, size, sizeof(T)); }
+
+	constexpr area_type data_area() const { return {m_front_gap, m_back_gap}; }
+	constexpr void set_data_area(area_type area) { m_front_gap = area.first; m_back_gap = area.second; }
+
+	constexpr void set_size(size_type size)
+	{
+		m_front_gap = static_cast<size_type>(TRAITS.front_gap(TRAITS.capacity, size, sizeof(T)));
+		m_back_gap = static_cast<size_type>(TRAITS.capacity - (m_front_gap + size));
+	}
+
+private:
+
+	// Moves the elements to prepare for size growth, giving the fraction 'front_bias' of the
+	// remaining space to the front (see ::recenter).
+	
+	constexpr void recenter()
+	{
+		typename sequence_stats<TRAITS>::timer timer;
+		sequence_stats<TRAITS>::recentered(size());
+		auto [front_gap, back_gap] = ::recenter(capacity_begin(), capacity_end(), data_begin(), data_end(), TRAITS.front_bias, TRAITS);
+		m_front_gap = static_cast<size_type>(front_gap);
+		m_back_gap = static_cast<size_type>(back_gap);
+	}
+
+	// Empty sequences with odd capacity will have the extra space at the back.
+
+	size_type m_front_gap = static_cast<size_type>(TRAITS.front_gap(TRAITS.capacity, 0, sizeof(T)));
+	size_type m_back_gap = static_cast<size_type>(TRAITS.capacity - m_front_gap);
+};
+
+// CIRCULAR elements wrap around the end of the capacity (a ring buffer), so there is always room at both ends
+// and adding or removing an element at either end never shifts anything. Inserting or erasing in the middle
+// shifts the shorter side.
+
+template<typename T, sequence_traits TRAITS>
+class fixed_storage<T, TRAITS, sequence_location_lits::CIRCULAR> : public fixed_capacity<T, TRAITS.capacity, TRAITS.alignment, TRAITS.tail_padding>
+{
+	using inherited = fixed_capacity<T, TRAITS.capacity, TRAITS.alignment, TRAITS.tail_padding>;
+	using value_type = T;
+	using iterator = ring_iterator<value_type>;
+	using const_iterator = ring_iterator<const value_type>;
+	using size_type = typename decltype(TRAITS)::size_type;
+	using area_type = std::pair<size_type, size_type>;
+
+public:
+
+	using inherited::capacity;
+	using inherited::capacity_begin;
+	using inherited::capacity_end;
+
+	inline iterator data_begin() { return iterator(capacity_begin(), capacity(), m_head); }
+	inline iterator data_end() { return iterator(capacity_begin(), capacity(), m_head + m_size); }
+	inline const_iterator data_begin() const { return const_iterator(capacity_begin(), capacity(), m_head); }
+	inline const_iterator data_end() const { return const_iterator(capacity_begin(), capacity(), m_head + m_size); }
+	inline size_t size() const { return m_size; }
+	inline bool empty() const { return m_size == 0; }
+
+	template<typename... ARGS>
+	inline iterator add_at(iterator pos, ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		auto index = pos - data_begin();
+		if (pos == data_end())
+			add_back(std::forward<ARGS>(args)...);
+		else if (pos == data_begin())
+			add_front(std::forward<ARGS>(args)...);
+		else if (index >= data_end() - pos)
+			back_add_at<TRAITS.in_place_emplace>(data_end(), pos, [this](){ ++m_size; }, std::forward<ARGS>(args)...);
+		else
+			front_add_at<TRAITS.in_place_emplace>(data_begin(), pos, [this](){ move_head(-1); ++m_size; }, std::forward<ARGS>(args)...);
+		return data_begin() + index;
+	}
+	template<typename... ARGS>
+	inline void add_front(ARGS&&... args)
+	{
+		assert(size() < capacity());
+		new(std::addressof(*(data_begin() - 1))) value_type(std::forward<ARGS>(args)...);
+		move_head(-1);
+		++m_size;
+	}
+	template<typename... ARGS>
+	inline void add_back(ARGS&&... args)
+	{
+		assert(size() < capacity());
+		new(std::addressof(*data_end())) value_type(std::forward<ARGS>(args)...);
+		++m_size;
+	}
+
+	inline void erase(iterator erase_begin, iterator erase_end)
+	{
+		// If we are erasing nearer the back or dead center, erase at the back. Otherwise erase at the front.
+		if (erase_begin - data_begin() >= data_end() - erase_end)
+			back_erase(data_end(), erase_begin, erase_end);
+		else
+		{
+			front_erase(data_begin(), erase_begin, erase_end);
+			move_head(erase_end - erase_begin);
+		}
+		m_size -= static_cast<size_type>(erase_end - erase_begin);
+	}
+	inline void erase(iterator element)
+	{
+		if (element - data_begin() >= data_end() - element)
+			back_erase(data_end(), element);
+		else
+		{
+			front_erase(data_begin(), element);
+			move_head(1);
+		}
+		--m_size;
+	}
+	inline void pop_front()
+	{
+		data_begin()->~value_type();
+		move_head(1);
+		--m_size;
+	}
+	inline void pop_back()
+	{
+		--m_size;
+		data_end()->~value_type();
+	}
+
+	void prepare_for(size_type size) {}
+
+	// Opens an uninitialized gap of 'count' elements at 'pos' (which is included in the size), or closes
+	// one again. The caller constructs the elements in the gap. The shorter side is moved.
+	inline iterator open_gap(iterator pos, size_type count)
+	{
+		assert(size() + count <= capacity());
+		auto index = pos - data_begin();
+		auto new_begin = index >= data_end() - pos ? data_begin() : data_begin() - count;
+		::open_gap(data_begin(), data_end(), pos, new_begin, count);
+		m_head = static_cast<size_type>(new_begin.position());
+		m_size += count;
+		return data_begin() + index;
+	}
+	inline void close_gap(iterator gap, size_type count)
+	{
+		if (gap - data_begin() >= data_end() - (gap + count))
+			::close_gap(data_begin(), data_end(), gap, data_begin(), count);
+		else
+		{
+			::close_gap(data_begin(), data_end(), gap, data_begin() + count, count);
+			move_head(count);
+		}
+		m_size -= count;
+	}
+
+	// Makes the elements contiguous (see ::linearize).
+	inline void linearize()
+	{
+		m_head = static_cast<size_type>(::linearize(capacity_begin(), capacity(), m_head, m_size));
+	}
+
+protected:
+
+	auto new_data_start(size_type size) { return capacity_begin(); }
+	area_type data_area() const { return {m_head, m_size}; }
+	void set_data_area(area_type area) { m_head = area.first; m_size = area.second; }
+	void set_size(size_type size) { m_head = 0; m_size = size; }
+
+private:
+
+	// Moves the start of the data by 'offset' positions, wrapping around the capacity.
+	inline void move_head(std::ptrdiff_t offset) { m_head = static_cast<size_type>((data_begin() + offset).position()); }
+
+	size_type m_head = 0;
+	size_type m_size = 0;
+};
+
+// Forward declaration so that the sequence storage types can refer to each other.
+
+template<sequence_location_lits LOC, typename T, sequence_traits TRAITS, typename ALLOC>
+class dynamic_sequence_storage;
+
+
+// ==============================================================================================================
+// fixed_sequence_storage - This class provides fixed capacity sequences (which may be static or
+// dynamically allocated). It offers three element management strategies.
+
+template<typename T, sequence_traits TRAITS>
+class fixed_sequence_storage : public fixed_storage<T, TRAITS>
+{
+	using value_type = T;
+	using iterator = value_type*;
+	using const_iterator = const value_type*;
+	using reference = value_type&;
+	using size_type = typename decltype(TRAITS)::size_type;
+	using inherited = fixed_storage<T, TRAITS>;
+
+	using inherited::new_data_start;
+	using inherited::data_area;
+	using inherited::set_data_area;
+	using inherited::set_size;
+
+public:
+
+	using inherited::capacity;
+	using inherited::capacity_begin;
+	using inherited::capacity_end;
+	using inherited::data_begin;
+	using inherited::data_end;
+	using inherited::size;
+	using inherited::empty;
+	//using inherited::erase;
+	//using inherited::pop_front;
+	//using inherited::pop_back;
+
+	constexpr fixed_sequence_storage() = default;
+	constexpr fixed_sequence_storage(std::initializer_list<value_type> il)
+	{
+		if (il.size() > capacity())
+			throw std::bad_alloc();
+
+		uninitialized_copy_data(il.begin(), il.end(), new_data_start(static_cast<size_type>(il.size())));
+		set_size(static_cast<size_type>(il.size()));	// This must come last in case of a copy exception.
+	}
+	template<typename ALLOC>
+	fixed_sequence_storage(dynamic_sequence_storage<TRAITS.location, T, TRAITS, ALLOC>&&);
+
+	constexpr fixed_sequence_storage(const fixed_sequence_storage& rhs)
+	{
+		uninitialized_copy_data(rhs.data_begin(), rhs.data_end(), new_data_start(rhs.size()));
+		set_size(rhs.size());							// This must come last in case of a move exception.
+	}
+	constexpr fixed_sequence_storage(fixed_sequence_storage&& rhs)
+	{
+		uninitialized_move_data(rhs.data_begin(), rhs.data_end(), new_data_start(rhs.size()));
+		set_size(rhs.size());							// This must come last in case of a move exception.
+	}
+
+	constexpr fixed_sequence_storage& operator=(const fixed_sequence_storage& rhs)
+	{
+		clear();
+		uninitialized_copy_data(rhs.data_begin(), rhs.data_end(), new_data_start(rhs.size()));
+		set_size(rhs.size());
+		return *this;
+	}
+	constexpr fixed_sequence_storage& operator=(fixed_sequence_storage&& rhs)
+	{
+		clear();
+		uninitialized_move_data(rhs.data_begin(), rhs.data_end(), new_data_start(rhs.size()));
+		set_size(rhs.size());
+		return *this;
+	}
+
+	constexpr ~fixed_sequence_storage()
+	{
+		destroy_data(data_begin(), data_end());
+	}
+
+	constexpr void clear()
+	{
+		if (!empty())
+		{
+			destroy_data(data_begin(), data_end());
+			set_size(0);
+		}
+	}
+
+	// Forgets the elements without destroying them. This is used once they have been relocated elsewhere.
+	constexpr void release_data() { set_size(0); }
+};
+#ifdef NOTHERE
+template<typename T, sequence_traits TRAITS>
+class fixed_sequence_storage<sequence_location_lits::BACK, T, TRAITS> : fixed_capacity<T, TRAITS.capacity>
+{
+	using value_type = T;
+	using iterator = value_type*;
+	using size_type = typename decltype(TRAITS)::size_type;
+	using inherited = fixed_capacity<T, TRAITS.capacity>;
+
+public:
+
+	using inherited::capacity;
+	using inherited::capacity_begin;
+	using inherited::capacity_end;
+
+	inline fixed_sequence_storage() = default;
+	inline fixed_sequence_storage(std::initializer_list<value_type> il)
+	{
+		assert(il.size() <= capacity());
+
+		std::uninitialized_copy(il.begin(), il.end(), capacity_end() - il.size());
+		m_size = static_cast<size_type>(il.size());
+	}
+
+	inline fixed_sequence_storage(const fixed_sequence_storage& rhs)
+	{
+		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_end() - rhs.m_size);
+		m_size = rhs.m_size;
+	}
+	inline fixed_sequence_storage(fixed_sequence_storage&& rhs)
+	{
+		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_end() - rhs.m_size);
+		m_size = rhs.m_size;
+	}
+
+	inline fixed_sequence_storage& operator=(const fixed_sequence_storage& rhs)
+	{
+		clear();
+		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_end() - rhs.m_size);
+		m_size = rhs.m_size;
+		return *this;
+	}
+	inline fixed_sequence_storage& operator=(fixed_sequence_storage&& rhs)
+	{
+		clear();
+		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_end() - rhs.m_size);
+		m_size = rhs.m_size;
+		return *this;
+	}
+
+	inline ~fixed_sequence_storage()
+	{
+		destroy_data(data_begin(), data_end());
+	}
+
+	inline value_type* data_begin() { return capacity_end() - m_size; }
+	inline value_type* data_end() { return capacity_end(); }
+	inline const value_type* data_begin() const { return capacity_end() - m_size; }
+	inline const value_type* data_end() const { return capacity_end(); }
+	inline size_t size() const { return m_size; }
+	inline bool empty() const { return m_size == 0; }
+
+	template<typename... ARGS>
+	inline iterator add_at(iterator pos, ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		if (m_size == 0 || pos == data_begin())
+			add_front(std::forward<ARGS>(args)...);
+		else
+			pos = front_add_at(data_begin(), pos, [this](){ ++m_size; }, std::forward<ARGS>(args)...);
+		return pos;
+	}
+	template<typename... ARGS>
+	inline void add_front(ARGS&&... args)
+	{
+		assert(size() < capacity());
+
+		new(data_begin() - 1) value_type(std::forward<ARGS>(args)...);
+		++m_size;
+	}
+	template<typename... ARGS>
+	inline void add_back(ARGS&&... args)
+	{
+		add_at(data_end(), std::forward<ARGS>(args)...);
+	}
+	template<typename... ARGS>
+	inline void add(size_t count, ARGS&&... args)
+	{
+		while (count--)
+			add_front(std::forward<ARGS>(args)...);
+	}
+
+	inline void clear()
+	{
+		if (!empty())
+		{
+			destroy_data(data_begin(), data_end());
+			m_size = 0;
+		}
+	}
+	inline void erase(value_type* erase_begin, value_type* erase_end)
+	{
+		front_erase(data_begin(), data_end(), erase_begin, erase_end,
+					[this](size_t count){ m_size -= static_cast<size_type>(count); });
+	}
+	inline void erase(value_type* element)
+	{
+		front_erase(data_begin(), data_end(), element, [this](){ --m_size; });
+	}
+	inline void pop_front()
+	{
+		assert(size());
+
+		auto dst = data_begin();
+		--m_size;
+		dst->~value_type();
+	}
+	inline void pop_back()
+	{
+		assert(size());
+
+		erase(data_end() - 1);
+	}
+
+private:
+
+	size_type m_size = 0;
+};
+
+template<typename T, sequence_traits TRAITS>
+class fixed_sequence_storage<sequence_location_lits::MIDDLE, T, TRAITS> : fixed_capacity<T, TRAITS.capacity>
+{
+	using value_type = T;
+	using iterator = value_type*;
+	using size_type = typename decltype(TRAITS)::size_type;
+	using inherited = fixed_capacity<T, TRAITS.capacity>;
+
+public:
+
+	using inherited::capacity;
+	using inherited::capacity_begin;
+	using inherited::capacity_end;
+
+	inline fixed_sequence_storage() = default;
+	inline fixed_sequence_storage(std::initializer_list<value_type> il)
+	{
+		assert(il.size() <= capacity());
+
+		auto offset = TRAITS.front_gap(il.size());
+		std::uninitialized_copy(il.begin(), il.end(), capacity_begin() + offset);
+		m_front_gap = static_cast<size_type>(offset);
+		m_back_gap = static_cast<size_type>(TRAITS.capacity - (m_front_gap + il.size()));
+	}
+
+	inline fixed_sequence_storage(const fixed_sequence_storage& rhs)
+	{
+		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_begin() + rhs.m_front_gap);
+		m_front_gap = rhs.m_front_gap;
+		m_back_gap = rhs.m_back_gap;
+	}
+	inline fixed_sequence_storage(fixed_sequence_storage&& rhs)
+	{
+		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_begin() + rhs.m_front_gap);
+		m_front_gap = rhs.m_front_gap;
+		m_back_gap = rhs.m_back_gap;
+	}
+
+	inline fixed_sequence_storage& operator=(const fixed_sequence_storage& rhs)
+	{
+		clear();
+		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_begin() + rhs.m_front_gap);
+		m_front_gap = rhs.m_front_gap;
+		m_back_gap = rhs.m_back_gap;
+		return *this;
+	}
+	inline fixed_sequence_storage& operator=(fixed_sequence_storage&& rhs)
+	{
+		clear();
+		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_begin() + rhs.m_front_gap);
+		m_front_gap = rhs.m_front_gap;
+		m_back_gap = rhs.m_back_gap;
+		return *this;
+	}
+
+	inline ~fixed_sequence_storage()
+	{
+		destroy_data(data_begin(), data_end());
+	}
+
+	inline value_type* data_begin() { return capacity_begin() + m_front_gap; }
+	inline value_type* data_end() { return capacity_end() - m_back_gap; }
+	inline const value_type* data_begin() const { return capacity_begin() + m_front_gap; }
+	inline const value_type* data_end() const { return capacity_end() - m_back_gap; }
+	inline size_t size() const { return capacity() - (m_front_gap + m_back_gap); }
+	inline bool empty() const { return m_front_gap + m_back_gap == capacity(); }
+
+	template<typename... ARGS>
+	inline iterator add_at(iterator pos, ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		if (size() == 0 || pos == data_end())
+			add_back(std::forward<ARGS>(args)...);
+		else if (pos == data_begin())
+			add_front(std::forward<ARGS>(args)...);
+		else if (pos - data_begin() >= data_end() - pos)			// Inserting closer to the end--add at back.
+		{
+			if (m_back_gap == 0)
+			{
+				recenter();
+				pos -= m_back_gap;
+			}
+			pos = back_add_at(data_end(), pos, [this](){ --m_back_gap; }, std::forward<ARGS>(args)...);
+		}
+		else										// Inserting closer to the beginning--add at front.
+		{
+			if (m_front_gap == 0)
+			{
+				recenter();
+				pos += m_front_gap;
+			}
+			pos = front_add_at(data_begin(), pos, [this](){ --m_front_gap; }, std::forward<ARGS>(args)...);
+		}
+		return pos;
+	}
+	template<typename... ARGS>
+	inline void add_front(ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(m_front_gap || m_back_gap);
+
+		if (m_front_gap == 0)
+			recenter();
+		new(data_begin() - 1) value_type(std::forward<ARGS>(args)...);
+		--m_front_gap;
+	}
+	template<typename... ARGS>
+	inline void add_back(ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(m_front_gap || m_back_gap);
+
+		if (m_back_gap == 0)
+			recenter();
+		new(data_end()) value_type(std::forward<ARGS>(args)...);
+		--m_back_gap;
+	}
+	template<typename... ARGS>
+	inline void add(size_t count, ARGS&&... args)
+	{
+		// This is certainly not as optimized as it could be. The question is,
+		// how useful is resize for a middle location container?
+		while (count--)
+			add_back(std::forward<ARGS>(args)...);
+	}
+
+	inline void clear()
+	{
+		if (!empty())
+		{
+			destroy_data(data_begin(), data_end());
+			m_front_gap = static_cast<size_type>(TRAITS.front_gap());
+			m_back_gap = static_cast<size_type>(TRAITS.capacity - m_front_gap);
+		}
+	}
+	inline void erase(value_type* erase_begin, value_type* erase_end)
+	{
+		// If we are erasing nearer the back or dead center, erase at the back. Otherwise erase at the front.
+		if (erase_begin - data_begin() >= data_end() - erase_end)
+			back_erase(data_begin(), data_end(), erase_begin, erase_end,
+						[this](size_t count){ m_back_gap += static_cast<size_type>(count); });
+		else
+			front_erase(data_begin(), data_end(), erase_begin, erase_end,
+						[this](size_t count){ m_front_gap += static_cast<size_type>(count); });
+	}
+	inline void erase(value_type* element)
+	{
+		// If we are erasing nearer the back or dead center, erase at the back. Otherwise erase at the front.
+		if (element - data_begin() >= data_end() - element)
+			back_erase(data_begin(), data_end(), element, [this](){ ++m_back_gap; });
+		else
+			front_erase(data_begin(), data_end(), element, [this](){ ++m_front_gap; });
+	}
+	inline void pop_front()
+	{
+		assert(size());
+
+		auto dst = data_begin();
+		++m_front_gap;
+		dst->~value_type();
+	}
+	inline void pop_back()
+	{
+		assert(size());
+
+		++m_back_gap;
+		data_end()->~value_type();
+	}
+
+private:
+
+	// This function recenters the elements to prepare for size growth. If the remaining space is odd, then the
+	// extra space will be at the front if we are making space at the front, otherwise it will be at the back.
+	
+	inline void recenter()
+	{
+		auto [front_gap, back_gap] = ::recenter<inherited>(capacity_begin(), capacity_end(), data_begin(), data_end());
+		m_front_gap = static_cast<size_type>(front_gap);
+		m_back_gap = static_cast<size_type>(back_gap);
+	}
+
+	// Empty sequences with odd capacity will have the extra space at the back.
+
+	size_type m_front_gap = static_cast<size_type>(TRAITS.front_gap());
+	size_type m_back_gap = static_cast<size_type>(TRAITS.capacity - TRAITS.front_gap());
+};
+#endif
+
+// ==============================================================================================================
+// dynamic_capacity - This is the base class for dynamic_sequence_storage instantiations. It handles the raw capacity
+// and owns the allocator which provides it.
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class dynamic_capacity
+{
+	using value_type = T;
+	using pointer = value_type*;
+	using const_pointer = const value_type*;
+	using alloc_traits = std::allocator_traits<ALLOC>;
+
+public:
+
+	using allocator_type = ALLOC;
+
+	// True if the capacity is not simply an array of elements (so it cannot be adopted or released).
+	static constexpr bool is_padded = TRAITS.alignment > alignof(T) || TRAITS.tail_padding > 0;
+
+private:
+
+	// When the traits ask for over-alignment or tail padding, the capacity is allocated as aligned blocks
+	// of bytes (from the allocator rebound to the block type) which hold the elements followed by the padding.
+	// Otherwise the blocks are just the elements.
+
+	static constexpr size_t block_size = std::max(TRAITS.alignment, alignof(T));
+	struct alignas(block_size) padded_block { unsigned char bytes[block_size]; };
+	using block_type = std::conditional_t<is_padded, padded_block, T>;
+	using block_allocator = typename alloc_traits::template rebind_alloc<block_type>;
+	using block_traits = std::allocator_traits<block_allocator>;
+
+	static constexpr size_t blocks_for(size_t cap)
+	{
+		if constexpr (is_padded)
+			return (cap * sizeof(T) + TRAITS.tail_padding + block_size - 1) / block_size;
+		else return cap;
+	}
+	static constexpr size_t capacity_for(size_t blocks)
+	{
+		if constexpr (is_padded)
+			return (blocks * block_size - TRAITS.tail_padding) / sizeof(T);
+		else return blocks;
+	}
+
+public:
+
+	inline dynamic_capacity() = default;
+	inline explicit dynamic_capacity(const allocator_type& alloc) : m_allocator(alloc) {}
+	// The allocator may provide more than was asked for (allocate_at_least), in which case the capacity
+	// is the size actually provided. So the capacity is at least 'cap', not necessarily equal to it.
+
+	inline dynamic_capacity(size_t cap, const allocator_type& alloc = allocator_type()) : m_allocator(alloc)
+	{
+		if (cap)
+		{
+			auto [begin, count] = allocate(m_allocator, cap);
+			m_capacity_begin = begin;
+			m_capacity_end = begin + count;
+		}
+	}
+	inline dynamic_capacity(pointer begin, size_t cap, const allocator_type& alloc) :
+		m_capacity_begin(begin),
+		m_capacity_end(begin ? begin + cap : nullptr),
+		m_allocator(alloc)
+	{
+		static_assert(!is_padded, "A padded or over-aligned capacity cannot be adopted.");
+	}
+	dynamic_capacity(const dynamic_capacity&) = delete;
+	inline dynamic_capacity(dynamic_capacity&& rhs) :
+		m_capacity_begin(std::exchange(rhs.m_capacity_begin, nullptr)),
+		m_capacity_end(std::exchange(rhs.m_capacity_end, nullptr)),
+		m_allocator(std::move(rhs.m_allocator))
+	{}
+	dynamic_capacity& operator=(const dynamic_capacity&) = delete;
+	dynamic_capacity& operator=(dynamic_capacity&& rhs) = delete;
+
+	inline ~dynamic_capacity() { free(); }
+
+	inline allocator_type get_allocator() const { return m_allocator; }
+
+	inline size_t capacity() const { return capacity_end() - capacity_begin(); }
+	inline pointer capacity_begin() { return m_capacity_begin; }
+	inline pointer capacity_end() { return m_capacity_end; }
+	inline const_pointer capacity_begin() const { return m_capacity_begin; }
+	inline const_pointer capacity_end() const { return m_capacity_end; }
+
+	// The raw capacity operations. These are also used by BUFFERED storage, which keeps its own pointers.
+
+	static inline std::pair<pointer, size_t> allocate(allocator_type& alloc, size_t cap)
+	{
+		block_allocator blocks_alloc(alloc);
+#ifdef __cpp_lib_allocate_at_least
+		auto [blocks, count] = block_traits::allocate_at_least(blocks_alloc, blocks_for(cap));
+#else
+		auto count = blocks_for(cap);
+		auto blocks = block_traits::allocate(blocks_alloc, count);
+#endif
+		return {reinterpret_cast<pointer>(blocks), capacity_for(count)};
+	}
+	static inline void deallocate(allocator_type& alloc, pointer begin, size_t cap)
+	{
+		block_allocator blocks_alloc(alloc);
+		block_traits::deallocate(blocks_alloc, reinterpret_cast<block_type*>(begin), blocks_for(cap));
+	}
+
+	// An allocator may provide 'reallocate(p, old_n, new_n)', which resizes a block (in place if possible,
+	// otherwise by moving its contents bitwise) and returns it, or returns nullptr leaving the block untouched.
+	// This can only be used for trivially relocatable elements. If it succeeds the elements have been relocated
+	// by the allocator to the same offset in the new capacity.
+
+	static constexpr bool can_resize = !is_padded && is_trivially_relocatable_v<T> &&
+		requires(allocator_type& alloc, pointer p, size_t n) { { alloc.reallocate(p, n, n) } -> std::same_as<pointer>; };
+
+	static inline pointer resize(allocator_type& alloc, pointer begin, size_t old_cap, size_t cap)
+	{
+		if constexpr (can_resize)
+			return alloc.reallocate(begin, old_cap, cap);
+		else return nullptr;
+	}
+
+protected:
+
+	// Exchanges the capacities only. This is used to install a capacity obtained from our own
+	// allocator, and by the allocator-aware operations below once the allocators are settled.
+
+	inline void swap(dynamic_capacity& rhs)
+	{
+		std::swap(m_capacity_begin, rhs.m_capacity_begin);
+		std::swap(m_capacity_end, rhs.m_capacity_end);
+	}
+	inline void swap(dynamic_capacity&& rhs) { swap(rhs); }
+
+	// Resizes the capacity with the allocator's 'reallocate' (see above). Returns true if it succeeded.
+	inline bool resize_capacity(size_t cap)
+	{
+		if (m_capacity_begin && cap)
+		{
+			if (auto begin = resize(m_allocator, m_capacity_begin, capacity(), cap))
+			{
+				m_capacity_begin = begin;
+				m_capacity_end = begin + cap;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Gives up ownership of the capacity, which the caller must give back to the allocator.
+	inline pointer release_capacity()
+	{
+		static_assert(!is_padded, "A padded or over-aligned capacity cannot be released.");
+		m_capacity_end = nullptr;
+		return std::exchange(m_capacity_begin, nullptr);
+	}
+	inline void free()
+	{
+		if (m_capacity_begin)
+			deallocate(m_allocator, m_capacity_begin, capacity());
+		m_capacity_begin = nullptr;
+		m_capacity_end = nullptr;
+	}
+
+	// Returns the allocator to be used by a copy of this capacity.
+	inline allocator_type select_allocator() const
+	{
+		return alloc_traits::select_on_container_copy_construction(m_allocator);
+	}
+
+	// These functions implement the standard allocator propagation rules. The allocators must only be
+	// assigned when the traits say so, since some allocators (e.g. std::pmr::polymorphic_allocator) cannot be.
+
+	// For container swap: swaps the allocators if they propagate. (If they don't and are unequal the behavior
+	// is undefined, as it is for the standard containers.)
+	inline void swap_allocator(dynamic_capacity& rhs)
+	{
+		if constexpr (alloc_traits::propagate_on_container_swap::value)
+			std::swap(m_allocator, rhs.m_allocator);
+		else
+			assert(m_allocator == rhs.m_allocator);
+	}
+
+	// For move assignment: returns true if the capacity of rhs can be taken over (in which case the caller
+	// exchanges the capacities). If the allocators propagate they are exchanged here so that each capacity
+	// stays with the allocator that provided it.
+	inline bool move_allocator(dynamic_capacity& rhs)
+	{
+		if constexpr (alloc_traits::propagate_on_container_move_assignment::value)
+		{
+			std::swap(m_allocator, rhs.m_allocator);
+			return true;
+		}
+		else return m_allocator == rhs.m_allocator;
+	}
+
+	// For copy assignment: copies the allocator if it propagates. If this changes the allocator, 'release'
+	// is called first so the caller can destroy its elements and give the capacity back to the old allocator.
+	template<std::regular_invocable FUNC>
+	inline void copy_allocator(const dynamic_capacity& rhs, FUNC release)
+	{
+		if constexpr (alloc_traits::propagate_on_container_copy_assignment::value)
+		{
+			if (m_allocator != rhs.m_allocator)
+				release();
+			m_allocator = rhs.m_allocator;
+		}
+	}
+
+	pointer m_capacity_begin = nullptr;
+	pointer m_capacity_end = nullptr;
+	NO_UNIQUE_ADDRESS allocator_type m_allocator;
+};
+
+
+// dynamic_sequence_storage - Helper class for sequence which provides the 3 different element management strategies
+// for dynamically allocated variable capacity sequences.
+
+template<sequence_location_lits LOC, typename T, sequence_traits TRAITS, typename ALLOC>
+class dynamic_sequence_storage
+{
+	static_assert(false, "An unimplemented specialization of variable_sequence_storage was instantiated.");
+};
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class dynamic_sequence_storage<sequence_location_lits::FRONT, T, TRAITS, ALLOC> : public dynamic_capacity<T, TRAITS, ALLOC>
+{
+	using value_type = T;
+	using iterator = value_type*;
+	using inherited = dynamic_capacity<T, TRAITS, ALLOC>;
+
+public:
+
+	using typename inherited::allocator_type;
+	using inherited::get_allocator;
+	using inherited::capacity;
+	using inherited::capacity_begin;
+	using inherited::capacity_end;
+
+	inline dynamic_sequence_storage() = default;
+	inline explicit dynamic_sequence_storage(const allocator_type& alloc) : inherited(alloc) {}
+	inline dynamic_sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		inherited(il.size(), alloc),
+		m_data_end(std::uninitialized_copy(il.begin(), il.end(), capacity_begin()))
+	{}
+	template<sequence_storage_implementation SEQ>
+	inline dynamic_sequence_storage(size_t cap, SEQ&& rhs, const allocator_type& alloc) :
+		inherited(cap, alloc),
+		m_data_end(uninitialized_transfer(std::forward<SEQ>(rhs), capacity_begin()))
+	{}
+
+	inline dynamic_sequence_storage(const dynamic_sequence_storage& rhs) :
+		inherited(rhs.size(), rhs.select_allocator()),
+		m_data_end(std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_begin()))
+	{}
+	inline dynamic_sequence_storage(dynamic_sequence_storage&& rhs) :
+		inherited(std::move(rhs)),
+		m_data_end(std::exchange(rhs.m_data_end, nullptr))
+	{}
+	inline dynamic_sequence_storage(const sequence_buffer<value_type>& buffer, const allocator_type& alloc) :
+		inherited(buffer.capacity_begin, buffer.capacity, alloc),
+		m_data_end(adopt_data(buffer, capacity_begin()))
+	{}
+
+	inline dynamic_sequence_storage& operator=(const dynamic_sequence_storage& rhs)
+	{
+		inherited::copy_allocator(rhs, [this](){ free(); });
+
+		auto dst = data_begin();
+		auto src = rhs.data_begin();
+
+		if (rhs.size() > capacity())
+		{
+			destroy_data(dst, data_end());
+			inherited::swap(inherited(rhs.size(), get_allocator()));
+			dst = data_begin();
+		}
+		else
+		{
+			while (src != rhs.data_end() && dst != data_end())
+				*dst++ = *src++;
+			destroy_data(dst, data_end());
+		}
+		m_data_end = std::uninitialized_copy(src, rhs.data_end(), dst);
+
+		return *this;
+	}
+	inline dynamic_sequence_storage& operator=(dynamic_sequence_storage&& rhs)
+	{
+		if (inherited::move_allocator(rhs))
+			swap_capacity(rhs);
+		else
+		{
+			dynamic_sequence_storage temp(rhs.size(), std::move(rhs), get_allocator());
+			swap_capacity(temp);
+		}
+		return *this;
+	}
+
+	inline ~dynamic_sequence_storage()
+	{
+		destroy_data(data_begin(), data_end());
+	}
+
+	inline value_type* data_begin() { return capacity_begin(); }
+	inline value_type* data_end() { return m_data_end; }
+	inline const value_type* data_begin() const { return capacity_begin(); }
+	inline const value_type* data_end() const { return m_data_end; }
+	inline size_t size() const { return data_end() - data_begin(); }
+	inline bool empty() const { return m_data_end == capacity_begin(); }
+
+	inline void swap(dynamic_sequence_storage& rhs)
+	{
+		inherited::swap_allocator(rhs);
+		swap_capacity(rhs);
+	}
+
+	inline void reallocate(size_t new_cap_size)
+	{
+		assert(size() <= new_cap_size);
+
+		if (auto current_size = size(); inherited::resize_capacity(new_cap_size))
+		{
+			m_data_end = capacity_begin() + current_size;
+			return;
+		}
+
+		auto old_begin = data_begin();
+		auto old_end = data_end();
+
+		inherited new_capacity(new_cap_size, get_allocator());
+		m_data_end = uninitialized_relocate(old_begin, old_end, new_capacity.capacity_begin());
+		inherited::swap(new_capacity);
+	}
+
+	// Reallocates leaving an uninitialized gap of 'count' elements at 'pos' (which is included in the size),
+	// so that the elements are only moved once. Returns the new location of the gap.
+	inline iterator reallocate(size_t new_cap_size, iterator pos, size_t count)
+	{
+		assert(size() + count <= new_cap_size);
+
+		auto new_size = size() + count;
+
+		if (auto index = pos - data_begin(), current_size = size(); inherited::resize_capacity(new_cap_size))
+		{
+			m_data_end = capacity_begin() + current_size;
+			return open_gap(capacity_begin() + index, count);
+		}
+
+		inherited new_capacity(new_cap_size, get_allocator());
+		pos = uninitialized_relocate(data_begin(), pos, data_end(), new_capacity.capacity_begin(), count);
+		inherited::swap(new_capacity);
+
+		m_data_end = capacity_begin() + new_size;
+		return pos;
+	}
+
+	template<typename... ARGS>
+	inline iterator add_at(iterator pos, ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		if (size() == 0 || pos == data_end())
+			add_back(std::forward<ARGS>(args)...);
+		else
+			pos = back_add_at<TRAITS.in_place_emplace>(data_end(), pos, [this](){ ++m_data_end; }, std::forward<ARGS>(args)...);
+		return pos;
+	}
+	template<typename... ARGS>
+	inline void add_front(ARGS&&... args)
+	{
+		add_at(data_begin(), std::forward<ARGS>(args)...);
+	}
+	template<typename... ARGS>
+	inline void add_back(ARGS&&... args)
+	{
+		assert(size() < capacity());
+
+		new(data_end()) value_type(std::forward<ARGS>(args)...);
+		++m_data_end;
+	}
+
+	inline void pop_front()
+	{
+		assert(size());
+
+		erase(data_begin());
+	}
+	inline void pop_back()
+	{
+		assert(size());
+
+		--m_data_end;
+		data_end()->~value_type();
+	}
+	inline void erase(value_type* erase_begin, value_type* erase_end)
+	{
+		back_erase(data_end(), erase_begin, erase_end);
+		m_data_end -= erase_end - erase_begin;
+	}
+	inline void erase(value_type* element)
+	{
+		back_erase(data_end(), element);
+		--m_data_end;
+	}
+	inline void clear()
+	{
+		if (!empty())
+		{
+			destroy_data(data_begin(), data_end());
+			m_data_end = capacity_begin();
+		}
+	}
+	inline void free()
+	{
+		if (!empty())
+			destroy_data(data_begin(), data_end());
+		inherited::free();
+		m_data_end = nullptr;
+	}
+
+	void prepare_for(size_t size) {}
+
+	// Opens an uninitialized gap of 'count' elements at 'pos' (which is included in the size), or closes
+	// one again. The caller constructs the elements in the gap.
+	inline iterator open_gap(iterator pos, size_t count)
+	{
+		assert(size() + count <= capacity());
+		pos = ::open_gap(data_begin(), data_end(), pos, data_begin(), count);
+		m_data_end += count;
+		return pos;
+	}
+	inline void close_gap(iterator gap, size_t count)
+	{
+		::close_gap(data_begin(), data_end(), gap, data_begin(), count);
+		m_data_end -= count;
+	}
+
+	// Forgets the elements without destroying them. This is used once they have been relocated elsewhere.
+	inline void release_data() { m_data_end = capacity_begin(); }
+
+	// Gives up ownership of the capacity and the elements, which are left for the caller to destroy.
+	inline sequence_buffer<value_type> release()
+	{
+		sequence_buffer<value_type> buffer{ capacity_begin(), capacity(), data_begin(), data_end() };
+		inherited::release_capacity();
+		m_data_end = nullptr;
+		return buffer;
+	}
+
+private:
+
+	// Exchanges the capacities and elements but not the allocators.
+
+	inline void swap_capacity(dynamic_sequence_storage& rhs)
+	{
+		inherited::swap(rhs);
+		std::swap(m_data_end, rhs.m_data_end);
+	}
+
+	value_type* m_data_end = nullptr;
+};
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class dynamic_sequence_storage<sequence_location_lits::BACK, T, TRAITS, ALLOC> : public dynamic_capacity<T, TRAITS, ALLOC>
+{
+	using value_type = T;
+	using iterator = value_type*;
+	using inherited = dynamic_capacity<T, TRAITS, ALLOC>;
+
+public:
+
+	using typename inherited::allocator_type;
+	using inherited::get_allocator;
+	using inherited::capacity;
+	using inherited::capacity_begin;
+	using inherited::capacity_end;
+
+	inline dynamic_sequence_storage() = default;
+	inline explicit dynamic_sequence_storage(const allocator_type& alloc) : inherited(alloc) {}
+	inline dynamic_sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		inherited(il.size(), alloc)
+	{
+		auto begin = capacity_end() - il.size();
+		std::uninitialized_copy(il.begin(), il.end(), begin);
+		m_data_begin = begin;
+	}
+	template<sequence_storage_implementation SEQ>
+	inline dynamic_sequence_storage(size_t cap, SEQ&& rhs, const allocator_type& alloc) :
+		inherited(cap, alloc)
+	{
+		auto begin = capacity_end() - rhs.size();
+		uninitialized_transfer(std::forward<SEQ>(rhs), begin);
+		m_data_begin = begin;
+	}
+
+	inline dynamic_sequence_storage(const dynamic_sequence_storage& rhs) :
+		inherited(rhs.size(), rhs.select_allocator())
+	{
+		auto begin = capacity_end() - rhs.size();
+		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), begin);
+		m_data_begin = begin;
+	}
+	inline dynamic_sequence_storage(dynamic_sequence_storage&& rhs) :
+		inherited(std::move(rhs)),
+		m_data_begin(std::exchange(rhs.m_data_begin, nullptr))
+	{}
+	inline dynamic_sequence_storage(const sequence_buffer<value_type>& buffer, const allocator_type& alloc) :
+		inherited(buffer.capacity_begin, buffer.capacity, alloc),
+		m_data_begin(capacity_end() - (buffer.data_end - buffer.data_begin))
+	{
+		adopt_data(buffer, m_data_begin);
+	}
+
+	inline dynamic_sequence_storage& operator=(const dynamic_sequence_storage& rhs)
+	{
+		inherited::copy_allocator(rhs, [this](){ free(); });
+
+		clear();
+		if (rhs.size() > capacity())
+			inherited::swap(inherited(rhs.size(), get_allocator()));
+		auto begin = capacity_end() - rhs.size();
+		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), begin);
+		m_data_begin = begin;
+		return *this;
+	}
+	inline dynamic_sequence_storage& operator=(dynamic_sequence_storage&& rhs)
+	{
+		clear();
+		if (inherited::move_allocator(rhs))
+			swap_capacity(rhs);
+		else
+		{
+			dynamic_sequence_storage temp(rhs.size(), std::move(rhs), get_allocator());
+			swap_capacity(temp);
+		}
+		return *this;
+	}
+
+	inline ~dynamic_sequence_storage()
+	{
+		destroy_data(data_begin(), data_end());
+	}
+
+	inline value_type* data_begin() { return m_data_begin; }
+	inline value_type* data_end() { return capacity_end(); }
+	inline const value_type* data_begin() const { return m_data_begin; }
+	inline const value_type* data_end() const { return capacity_end(); }
+	inline size_t size() const { return data_end() - data_begin(); }
+	inline bool empty() const { return m_data_begin == capacity_end(); }
+
+	inline void swap(dynamic_sequence_storage& rhs)
+	{
+		inherited::swap_allocator(rhs);
+		swap_capacity(rhs);
+	}
+
+	inline void reallocate(size_t new_cap)
+	{
+		assert(size() <= new_cap);
+
+		auto current_size = size();
+
+		// Growing in place leaves the elements at their old offset, so they are then shifted to the back.
+		if (auto offset = data_begin() - capacity_begin(); new_cap >= capacity() && inherited::resize_capacity(new_cap))
+		{
+			m_data_begin = capacity_end() - current_size;
+			relocate_bytes(m_data_begin, capacity_begin() + offset, current_size);
+			return;
+		}
+
+		inherited new_capacity(new_cap, get_allocator());
+		uninitialized_relocate(data_begin(), data_end(), new_capacity.capacity_end() - current_size);
+		inherited::swap(new_capacity);
+
+		m_data_begin = capacity_end() - current_size;
+	}
+
+	// Reallocates leaving an uninitialized gap of 'count' elements at 'pos' (which is included in the size),
+	// so that the elements are only moved once. Returns the new location of the gap.
+	inline iterator reallocate(size_t new_cap, iterator pos, size_t count)
+	{
+		assert(size() + count <= new_cap);
+
+		auto new_size = size() + count;
+
+		if (auto offset = data_begin() - capacity_begin(), index = pos - data_begin(), current_size = size();
+			new_cap >= capacity() && inherited::resize_capacity(new_cap))
+		{
+			auto old_begin = capacity_begin() + offset;
+			m_data_begin = capacity_end() - new_size;
+			return ::open_gap(old_begin, old_begin + current_size, old_begin + index, m_data_begin, count);
+		}
+
+		inherited new_capacity(new_cap, get_allocator());
+		pos = uninitialized_relocate(data_begin(), pos, data_end(), new_capacity.capacity_end() - new_size, count);
+		inherited::swap(new_capacity);
+
+		m_data_begin = capacity_end() - new_size;
+		return pos;
+	}
+
+	template<typename... ARGS>
+	inline iterator add_at(value_type* pos, ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		if (size() == 0 || pos == data_begin())
+		{
+			add_front(std::forward<ARGS>(args)...);
+			pos = data_begin();
+		}
+		else
+			pos = front_add_at<TRAITS.in_place_emplace>(data_begin(), pos, [this](){ --m_data_begin; }, std::forward<ARGS>(args)...);
+		return pos;
+	}
+	template<typename... ARGS>
+	inline void add_front(ARGS&&... args)
+	{
+		assert(size() < capacity());
+
+		new(data_begin() - 1) value_type(std::forward<ARGS>(args)...);
+		--m_data_begin;
+	}
+	template<typename... ARGS>
+	inline void add_back(ARGS&&... args)
+	{
+		add_at(data_end(), std::forward<ARGS>(args)...);
+	}
+
+	inline void pop_front()
+	{
+		assert(size());
+
+		auto dst = data_begin();
+		++m_data_begin;
+		dst->~value_type();
+	}
+	inline void pop_back()
+	{
+		assert(size());
+
+		erase(data_end() - 1);
+	}
+	inline void erase(value_type* erase_begin, value_type* erase_end)
+	{
+		front_erase(data_begin(), erase_begin, erase_end);
+		m_data_begin += erase_end - erase_begin;
+	}
+	inline void erase(value_type* element)
+	{
+		front_erase(data_begin(), element);
+		++m_data_begin;
+	}
+	inline void clear()
+	{
+		if (!empty())
+		{
+			destroy_data(data_begin(), data_end());
+			m_data_begin = capacity_end();
+		}
+	}
+	inline void free()
+	{
+		if (!empty())
+			destroy_data(data_begin(), data_end());
+		inherited::free();
+		m_data_begin = nullptr;
+	}
+
+	void prepare_for(size_t size) {}
+
+	// Opens an uninitialized gap of 'count' elements at 'pos' (which is included in the size), or closes
+	// one again. The caller constructs the elements in the gap.
+	inline iterator open_gap(iterator pos, size_t count)
+	{
+		assert(size() + count <= capacity());
+		pos = ::open_gap(data_begin(), data_end(), pos, data_begin() - count, count);
+		m_data_begin -= count;
+		return pos;
+	}
+	inline void close_gap(iterator gap, size_t count)
+	{
+		::close_gap(data_begin(), data_end(), gap, data_begin() + count, count);
+		m_data_begin += count;
+	}
+
+	// Forgets the elements without destroying them. This is used once they have been relocated elsewhere.
+	inline void release_data() { m_data_begin = capacity_end(); }
+
+	// Gives up ownership of the capacity and the elements, which are left for the caller to destroy.
+	inline sequence_buffer<value_type> release()
+	{
+		sequence_buffer<value_type> buffer{ capacity_begin(), capacity(), data_begin(), data_end() };
+		inherited::release_capacity();
+		m_data_begin = nullptr;
+		return buffer;
+	}
+
+private:
+
+	// Exchanges the capacities and elements but not the allocators.
+
+	inline void swap_capacity(dynamic_sequence_storage& rhs)
+	{
+		inherited::swap(rhs);
+		std::swap(m_data_begin, rhs.m_data_begin);
+	}
+
+	value_type* m_data_begin = nullptr;
+};
+
+// middle_bias - The fraction of the free space placed in front of the elements of a MIDDLE capacity. This is
+// the 'front_bias' trait unless 'adaptive_bias' is set, in which case it is learned: each time the elements are
+// placed, the share of the front and back gaps used since the previous placement is blended into the bias.
+// Learning only happens when the elements are placed, so adding and removing elements costs nothing extra.
+
+template<sequence_traits TRAITS, bool ADAPTIVE = TRAITS.adaptive_bias>
+class middle_bias
+{
+public:
+	constexpr float operator()() const { return TRAITS.front_bias; }
+	constexpr void learn(size_t, size_t) {}
+	constexpr void placed(size_t, size_t) {}
+};
+
+template<sequence_traits TRAITS>
+class middle_bias<TRAITS, true>
+{
+public:
+	float operator()() const { return m_bias; }
+
+	// The +1s count no growth as balanced and keep a single observation away from 0 and 1.
+	void learn(size_t front_gap, size_t back_gap)
+	{
+		auto front = m_front_gap > front_gap ? m_front_gap - front_gap : 0;
+		auto back = m_back_gap > back_gap ? m_back_gap - back_gap : 0;
+		m_bias = (m_bias + (front + 1.f) / (front + back + 2.f)) / 2;
+	}
+	void placed(size_t front_gap, size_t back_gap)
+	{
+		m_front_gap = front_gap;
+		m_back_gap = back_gap;
+	}
+
+private:
+	float m_bias = TRAITS.front_bias;
+	size_t m_front_gap = 0;
+	size_t m_back_gap = 0;
+};
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class dynamic_sequence_storage<sequence_location_lits::MIDDLE, T, TRAITS, ALLOC> : public dynamic_capacity<T, TRAITS, ALLOC>
+{
+	using value_type = T;
+	using iterator = value_type*;
+	using inherited = dynamic_capacity<T, TRAITS, ALLOC>;
+
+public:
+
+	using typename inherited::allocator_type;
+	using inherited::get_allocator;
+	using inherited::capacity;
+	using inherited::capacity_begin;
+	using inherited::capacity_end;
+
+	inline dynamic_sequence_storage() = default;
+	inline explicit dynamic_sequence_storage(const allocator_type& alloc) : inherited(alloc) {}
+	inline dynamic_sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		inherited(il.size(), alloc)
+	{
+		auto begin = capacity_begin() + front_gap(capacity(), il.size());
+		m_data_end = std::uninitialized_copy(il.begin(), il.end(), begin);
+		m_data_begin = begin;
+	}
+	template<sequence_storage_implementation SEQ>
+	inline dynamic_sequence_storage(size_t cap, SEQ&& rhs, const allocator_type& alloc) :
+		inherited(cap, alloc)
+	{
+		auto begin = capacity_begin() + front_gap(capacity(), rhs.size());
+		m_data_end = uninitialized_transfer(std::forward<SEQ>(rhs), begin);
+		m_data_begin = begin;
+	}
+
+	inline dynamic_sequence_storage(const dynamic_sequence_storage& rhs) :
+		inherited(rhs.size(), rhs.select_allocator())
+	{
+		auto begin = capacity_begin() + front_gap(capacity(), rhs.size());
+		m_data_end = std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), begin);
+		m_data_begin = begin;
+	}
+	inline dynamic_sequence_storage(dynamic_sequence_storage&& rhs) :
+		inherited(std::move(rhs)),
+		m_data_begin(std::exchange(rhs.m_data_begin, nullptr)),
+		m_data_end(std::exchange(rhs.m_data_end, nullptr)),
+		m_bias(rhs.m_bias)
+	{}
+	inline dynamic_sequence_storage(const sequence_buffer<value_type>& buffer, const allocator_type& alloc) :
+		inherited(buffer.capacity_begin, buffer.capacity, alloc),
+		m_data_begin(buffer.data_begin != buffer.data_end ? buffer.data_begin : capacity_begin()),
+		m_data_end(adopt_data(buffer, m_data_begin))
+	{}
+
+	inline dynamic_sequence_storage& operator=(const dynamic_sequence_storage& rhs)
+	{
+		inherited::copy_allocator(rhs, [this](){ free(); });
+
+		clear();
+		if (rhs.size() > capacity())
+			inherited::swap(inherited(rhs.size(), get_allocator()));
+		auto begin = capacity_begin() + front_gap(capacity(), rhs.size());
+		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), begin);
+		m_data_begin = begin;
+		m_data_end = m_data_begin + rhs.size();
+		return *this;
+	}
+	inline dynamic_sequence_storage& operator=(dynamic_sequence_storage&& rhs)
+	{
+		clear();
+		if (inherited::move_allocator(rhs))
+			swap_capacity(rhs);
+		else
+		{
+			dynamic_sequence_storage temp(rhs.size(), std::move(rhs), get_allocator());
+			swap_capacity(temp);
+		}
+		return *this;
+	}
+
+	inline ~dynamic_sequence_storage()
+	{
+		destroy_data(data_begin(), data_end());
+	}
+
+	inline value_type* data_begin() { return m_data_begin; }
+	inline value_type* data_end() { return m_data_end; }
+	inline const value_type* data_begin() const { return m_data_begin; }
+	inline const value_type* data_end() const { return m_data_end; }
+	inline size_t size() const { return m_data_end - m_data_begin; }
+	inline bool empty() const { return m_data_end == m_data_begin; }
+
+	inline void swap(dynamic_sequence_storage& rhs)
+	{
+		inherited::swap_allocator(rhs);
+		swap_capacity(rhs);
+	}
+
+	inline void reallocate(size_t new_cap)
+	{
+		assert(size() <= new_cap);
+
+		auto current_size = size();
+		learn_bias();
+
+		// Growing in place leaves the elements at their old offset, so they are then recentered.
+		if (auto offset = data_begin() - capacity_begin(); new_cap >= capacity() && inherited::resize_capacity(new_cap))
+		{
+			m_data_begin = capacity_begin() + front_gap(capacity(), current_size);
+			m_data_end = m_data_begin + current_size;
+			relocate_bytes(m_data_begin, capacity_begin() + offset, current_size);
+			m_bias.placed(m_data_begin - capacity_begin(), capacity_end() - m_data_end);
+			return;
+		}
+
+		inherited new_capacity(new_cap, get_allocator());
+		auto offset = front_gap(new_capacity.capacity(), current_size);
+		uninitialized_relocate(data_begin(), data_end(), new_capacity.capacity_begin() + offset);
+		inherited::swap(new_capacity);
+
+		m_data_begin = capacity_begin() + offset;
+		m_data_end = m_data_begin + current_size;
+		m_bias.placed(offset, capacity() - (offset + current_size));
+	}
+
+	// Reallocates leaving an uninitialized gap of 'count' elements at 'pos' (which is included in the size),
+	// so that the elements are only moved once. Returns the new location of the gap.
+	inline iterator reallocate(size_t new_cap, iterator pos, size_t count)
+	{
+		assert(size() + count <= new_cap);
+
+		auto new_size = size() + count;
+		learn_bias();
+
+		if (auto offset = data_begin() - capacity_begin(), index = pos - data_begin(), current_size = size();
+			new_cap >= capacity() && inherited::resize_capacity(new_cap))
+		{
+			auto old_begin = capacity_begin() + offset;
+			m_data_begin = capacity_begin() + front_gap(capacity(), new_size);
+			m_data_end = m_data_begin + new_size;
+			m_bias.placed(m_data_begin - capacity_begin(), capacity_end() - m_data_end);
+			return ::open_gap(old_begin, old_begin + current_size, old_begin + index, m_data_begin, count);
+		}
+
+		inherited new_capacity(new_cap, get_allocator());
+		auto offset = front_gap(new_capacity.capacity(), new_size);
+		pos = uninitialized_relocate(data_begin(), pos, data_end(), new_capacity.capacity_begin() + offset, count);
+		inherited::swap(new_capacity);
+
+		m_data_begin = capacity_begin() + offset;
+		m_data_end = m_data_begin + new_size;
+		m_bias.placed(offset, capacity() - (offset + new_size));
+		return pos;
+	}
+
+	template<typename... ARGS>
+	inline iterator add_at(iterator pos, ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		auto dbeg = data_begin();
+		auto dend = data_end();
+
+		if (size() == 0 || pos == dend)
+		{
+			add_back(std::forward<ARGS>(args)...);
+			pos = data_end() - 1;
+		}
+		else if (pos == dbeg)
+		{
+			add_front(std::forward<ARGS>(args)...);
+			pos = data_begin();
+		}
+
+		else if (pos - dbeg >= dend - pos)			// Inserting closer to the end--add at back.
+		{
+			if (m_data_end == capacity_end())
+			{
+				recenter();
+				pos -= capacity_end() - m_data_end;
+			}
+			pos = back_add_at<TRAITS.in_place_emplace>(data_end(), pos, [this](){ ++m_data_end; }, std::forward<ARGS>(args)...);
+		}
+		else										// Inserting closer to the beginning--add at front.
+		{
+			if (m_data_begin == capacity_begin())
+			{
+				recenter();
+				pos += m_data_begin - capacity_begin();
+			}
+			pos = front_add_at<TRAITS.in_place_emplace>(data_begin(), pos, [this](){ --m_data_begin; }, std::forward<ARGS>(args)...);
+		}
+		return pos;
+	}
+	template<typename... ARGS>
+	inline void add_front(ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(m_data_begin > capacity_begin() || m_data_end < capacity_end());
+
+		if (m_data_begin == capacity_begin())
+			recenter();
+		new(m_data_begin - 1) value_type(std::forward<ARGS>(args)...);
+		--m_data_begin;
+	}
+	template<typename... ARGS>
+	inline void add_back(ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(m_data_begin > capacity_begin() || m_data_end < capacity_end());
+
+		if (m_data_end == capacity_end())
+			recenter();
+		new(m_data_end) value_type(std::forward<ARGS>(args)...);
+		++m_data_end;
+	}
+
+	inline void pop_front()
+	{
+		assert(size());
+
+		data_begin()->~value_type();
+		++m_data_begin;
+	}
+	inline void pop_back()
+	{
+		assert(size());
+
+		(data_end() - 1)->~value_type();
+		--m_data_end;
+	}
+	inline void erase(value_type* erase_begin, value_type* erase_end)
+	{
+		// If we are erasing nearer the back or dead center, erase at the back. Otherwise erase at the front.
+		if (erase_begin - data_begin() >= data_end() - erase_end)
+		{
+			back_erase(data_end(), erase_begin, erase_end);
+			m_data_end -= erase_end - erase_begin;
+		}
+		//  Otherwise erase at the front.
+		else
+		{
+			front_erase(data_begin(), erase_begin, erase_end);
+			m_data_begin += erase_end - erase_begin;
+		}
+	}
+	inline void erase(value_type* element)
+	{
+		// If we are erasing nearer the back or dead center, erase at the back.
+		if (element - data_begin() >= data_end() - element)
+		{
+			back_erase(data_end(), element);
+			--m_data_end;
+		}
+		//  Otherwise erase at the front.
+		else
+		{
+			front_erase(data_begin(), element);
+			++m_data_begin;
+		}
+	}
+	inline void clear()
+	{
+		if (!empty())
+		{
+			destroy_data(data_begin(), data_end());
+			m_data_begin = capacity_begin() + front_gap(capacity(), 0);
+			m_data_end = m_data_begin;
+			m_bias.placed(m_data_begin - capacity_begin(), capacity_end() - m_data_end);
+		}
+	}
+	inline void free()
+	{
+		if (!empty())
+			destroy_data(data_begin(), data_end());
+		inherited::free();
+		m_data_begin = nullptr;
+		m_data_end = nullptr;
+	}
+
+	void prepare_for(size_t size)
+	{
+		assert(empty());
+		assert(size <= capacity());
+		m_data_begin = capacity_begin() + front_gap(capacity(), size);
+		m_data_end = m_data_begin;
+		m_bias.placed(m_data_begin - capacity_begin(), capacity_end() - (m_data_begin + size));
+	}
+
+	// Opens an uninitialized gap of 'count' elements at 'pos' (which is included in the size), or closes
+	// one again. The caller constructs the elements in the gap.
+	inline iterator open_gap(iterator pos, size_t count)
+	{
+		assert(size() + count <= capacity());
+		auto new_size = size() + count;
+		auto new_begin = middle_gap_begin(capacity_begin(), capacity_end(), data_begin(), data_end(), pos, count, m_bias(), TRAITS);
+		pos = ::open_gap(data_begin(), data_end(), pos, new_begin, count);
+		m_data_begin = new_begin;
+		m_data_end = new_begin + new_size;
+		return pos;
+	}
+	inline void close_gap(iterator gap, size_t count)
+	{
+		// Close up the shorter side.
+		if (gap - data_begin() >= data_end() - (gap + count))
+		{
+			::close_gap(data_begin(), data_end(), gap, data_begin(), count);
+			m_data_end -= count;
+		}
+		else
+		{
+			::close_gap(data_begin(), data_end(), gap, data_begin() + count, count);
+			m_data_begin += count;
+		}
+	}
+
+	// Forgets the elements without destroying them. This is used once they have been relocated elsewhere.
+	inline void release_data() { m_data_end = m_data_begin; }
+
+	// Gives up ownership of the capacity and the elements, which are left for the caller to destroy.
+	inline sequence_buffer<value_type> release()
+	{
+		sequence_buffer<value_type> buffer{ capacity_begin(), capacity(), data_begin(), data_end() };
+		inherited::release_capacity();
+		m_data_begin = m_data_end = nullptr;
+		return buffer;
+	}
+
+private:
+
+	// Exchanges the capacities and elements but not the allocators.
+
+	inline void swap_capacity(dynamic_sequence_storage& rhs)
+	{
+		inherited::swap(rhs);
+		std::swap(m_data_begin, rhs.m_data_begin);
+		std::swap(m_data_end, rhs.m_data_end);
+		std::swap(m_bias, rhs.m_bias);
+	}
+
+	// This function recenters the elements to prepare for size growth, giving the fraction 'front_bias' of the
+	// remaining space to the front (see ::recenter).
+	
+	inline void recenter()
+	{
+		typename sequence_stats<TRAITS>::timer timer;
+		sequence_stats<TRAITS>::recentered(size());
+		learn_bias();
+		auto [front_gap, back_gap] = ::recenter(capacity_begin(), capacity_end(), data_begin(), data_end(), m_bias(), TRAITS);
+		m_data_begin = capacity_begin() + front_gap;
+		m_data_end = capacity_end() - back_gap;
+		m_bias.placed(front_gap, back_gap);
+	}
+
+	// Returns the front gap for placing 'size' elements in a capacity of 'cap' elements.
+
+	inline size_t front_gap(size_t cap, size_t size) const
+	{
+		return TRAITS.middle_gap(cap - size, m_bias(), sizeof(T));
+	}
+	inline void learn_bias()
+	{
+		if (capacity())
+			m_bias.learn(data_begin() - capacity_begin(), capacity_end() - data_end());
+	}
+
+	value_type* m_data_begin = nullptr;
+	value_type* m_data_end = nullptr;
+	NO_UNIQUE_ADDRESS middle_bias<TRAITS> m_bias;
+};
+
+// CIRCULAR elements wrap around the end of the capacity (see fixed_storage). When the capacity is reallocated
+// the elements are linearized at the start of the new capacity.
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class dynamic_sequence_storage<sequence_location_lits::CIRCULAR, T, TRAITS, ALLOC> : public dynamic_capacity<T, TRAITS, ALLOC>
+{
+	using value_type = T;
+	using iterator = ring_iterator<value_type>;
+	using const_iterator = ring_iterator<const value_type>;
+	using inherited = dynamic_capacity<T, TRAITS, ALLOC>;
+
+public:
+
+	using typename inherited::allocator_type;
+	using inherited::get_allocator;
+	using inherited::capacity;
+	using inherited::capacity_begin;
+	using inherited::capacity_end;
+
+	inline dynamic_sequence_storage() = default;
+	inline explicit dynamic_sequence_storage(const allocator_type& alloc) : inherited(alloc) {}
+	inline dynamic_sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		inherited(il.size(), alloc),
+		m_size(std::uninitialized_copy(il.begin(), il.end(), capacity_begin()) - capacity_begin())
+	{}
+	template<sequence_storage_implementation SEQ>
+	inline dynamic_sequence_storage(size_t cap, SEQ&& rhs, const allocator_type& alloc) :
+		inherited(cap, alloc),
+		m_size(uninitialized_transfer(std::forward<SEQ>(rhs), capacity_begin()) - capacity_begin())
+	{}
+
+	inline dynamic_sequence_storage(const dynamic_sequence_storage& rhs) :
+		inherited(rhs.size(), rhs.select_allocator()),
+		m_size(std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_begin()) - capacity_begin())
+	{}
+	inline dynamic_sequence_storage(dynamic_sequence_storage&& rhs) :
+		inherited(std::move(rhs)),
+		m_head(std::exchange(rhs.m_head, 0)),
+		m_size(std::exchange(rhs.m_size, 0))
+	{}
+
+	// The data of an adopted buffer can stay where it is, since it may start anywhere in a ring.
+	inline dynamic_sequence_storage(const sequence_buffer<value_type>& buffer, const allocator_type& alloc) :
+		inherited(buffer.capacity_begin, buffer.capacity, alloc),
+		m_head(buffer.data_begin != buffer.data_end ? buffer.data_begin - buffer.capacity_begin : 0),
+		m_size(buffer.data_end - buffer.data_begin)
+	{}
+
+	inline dynamic_sequence_storage& operator=(const dynamic_sequence_storage& rhs)
+	{
+		inherited::copy_allocator(rhs, [this](){ free(); });
+
+		if (rhs.size() > capacity())
+		{
+			clear();
+			inherited::swap(inherited(rhs.size(), get_allocator()));
+		}
+
+		auto dst = data_begin();
+		auto src = rhs.data_begin();
+		while (src != rhs.data_end() && dst != data_end())
+			*dst++ = *src++;
+		destroy_data(dst, data_end());
+		m_size = dst - data_begin();
+		m_size = std::uninitialized_copy(src, rhs.data_end(), dst) - data_begin();
+
+		return *this;
+	}
+	inline dynamic_sequence_storage& operator=(dynamic_sequence_storage&& rhs)
+	{
+		if (inherited::move_allocator(rhs))
+			swap_capacity(rhs);
+		else
+		{
+			dynamic_sequence_storage temp(rhs.size(), std::move(rhs), get_allocator());
+			swap_capacity(temp);
+		}
+		return *this;
+	}
+
+	inline ~dynamic_sequence_storage()
+	{
+		destroy_data(data_begin(), data_end());
+	}
+
+	inline iterator data_begin() { return iterator(capacity_begin(), capacity(), m_head); }
+	inline iterator data_end() { return iterator(capacity_begin(), capacity(), m_head + m_size); }
+	inline const_iterator data_begin() const { return const_iterator(capacity_begin(), capacity(), m_head); }
+	inline const_iterator data_end() const { return const_iterator(capacity_begin(), capacity(), m_head + m_size); }
+	inline size_t size() const { return m_size; }
+	inline bool empty() const { return m_size == 0; }
+
+	inline void swap(dynamic_sequence_storage& rhs)
+	{
+		inherited::swap_allocator(rhs);
+		swap_capacity(rhs);
+	}
+
+	inline void reallocate(size_t new_cap_size)
+	{
+		assert(size() <= new_cap_size);
+
+		if (auto old_cap_size = capacity(); new_cap_size >= old_cap_size && inherited::resize_capacity(new_cap_size))
+		{
+			rewrap(old_cap_size);
+			return;
+		}
+
+		inherited new_capacity(new_cap_size, get_allocator());
+		uninitialized_relocate(data_begin(), data_end(), new_capacity.capacity_begin());
+		inherited::swap(new_capacity);
+		m_head = 0;
+	}
+
+	// Reallocates leaving an uninitialized gap of 'count' elements at 'pos' (which is included in the size),
+	// so that the elements are only moved once. Returns the new location of the gap.
+	inline iterator reallocate(size_t new_cap_size, iterator pos, size_t count)
+	{
+		assert(size() + count <= new_cap_size);
+
+		auto index = pos - data_begin();
+
+		if (auto old_cap_size = capacity(); new_cap_size >= old_cap_size && inherited::resize_capacity(new_cap_size))
+		{
+			rewrap(old_cap_size);
+			return open_gap(data_begin() + index, count);
+		}
+
+		inherited new_capacity(new_cap_size, get_allocator());
+		uninitialized_relocate(data_begin(), pos, data_end(), new_capacity.capacity_begin(), count);
+		inherited::swap(new_capacity);
+
+		m_head = 0;
+		m_size += count;
+		return data_begin() + index;
+	}
+
+	template<typename... ARGS>
+	inline iterator add_at(iterator pos, ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		auto index = pos - data_begin();
+		if (pos == data_end())
+			add_back(std::forward<ARGS>(args)...);
+		else if (pos == data_begin())
+			add_front(std::forward<ARGS>(args)...);
+		else if (index >= data_end() - pos)
+			back_add_at<TRAITS.in_place_emplace>(data_end(), pos, [this](){ ++m_size; }, std::forward<ARGS>(args)...);
+		else
+			front_add_at<TRAITS.in_place_emplace>(data_begin(), pos, [this](){ move_head(-1); ++m_size; }, std::forward<ARGS>(args)...);
+		return data_begin() + index;
+	}
+	template<typename... ARGS>
+	inline void add_front(ARGS&&... args)
+	{
+		assert(size() < capacity());
+
+		new(std::addressof(*(data_begin() - 1))) value_type(std::forward<ARGS>(args)...);
+		move_head(-1);
+		++m_size;
+	}
+	template<typename... ARGS>
+	inline void add_back(ARGS&&... args)
+	{
+		assert(size() < capacity());
+
+		new(std::addressof(*data_end())) value_type(std::forward<ARGS>(args)...);
+		++m_size;
+	}
+
+	inline void pop_front()
+	{
+		assert(size());
+
+		data_begin()->~value_type();
+		move_head(1);
+		--m_size;
+	}
+	inline void pop_back()
+	{
+		assert(size());
+
+		--m_size;
+		data_end()->~value_type();
+	}
+	inline void erase(iterator erase_begin, iterator erase_end)
+	{
+		// If we are erasing nearer the back or dead center, erase at the back. Otherwise erase at the front.
+		if (erase_begin - data_begin() >= data_end() - erase_end)
+			back_erase(data_end(), erase_begin, erase_end);
+		else
+		{
+			front_erase(data_begin(), erase_begin, erase_end);
+			move_head(erase_end - erase_begin);
+		}
+		m_size -= erase_end - erase_begin;
+	}
+	inline void erase(iterator element)
+	{
+		if (element - data_begin() >= data_end() - element)
+			back_erase(data_end(), element);
+		else
+		{
+			front_erase(data_begin(), element);
+			move_head(1);
+		}
+		--m_size;
+	}
+	inline void clear()
+	{
+		destroy_data(data_begin(), data_end());
+		m_head = 0;
+		m_size = 0;
+	}
+	inline void free()
+	{
+		destroy_data(data_begin(), data_end());
+		inherited::free();
+		m_head = 0;
+		m_size = 0;
+	}
+
+	void prepare_for(size_t size) {}
+
+	// Opens an uninitialized gap of 'count' elements at 'pos' (which is included in the size), or closes
+	// one again. The caller constructs the elements in the gap. The shorter side is moved.
+	inline iterator open_gap(iterator pos, size_t count)
+	{
+		assert(size() + count <= capacity());
+		auto index = pos - data_begin();
+		auto new_begin = index >= data_end() - pos ? data_begin() : data_begin() - count;
+		::open_gap(data_begin(), data_end(), pos, new_begin, count);
+		m_head = new_begin.position();
+		m_size += count;
+		return data_begin() + index;
+	}
+	inline void close_gap(iterator gap, size_t count)
+	{
+		if (gap - data_begin() >= data_end() - (gap + count))
+			::close_gap(data_begin(), data_end(), gap, data_begin(), count);
+		else
+		{
+			::close_gap(data_begin(), data_end(), gap, data_begin() + count, count);
+			move_head(count);
+		}
+		m_size -= count;
+	}
+
+	// Makes the elements contiguous (see ::linearize).
+	inline void linearize()
+	{
+		m_head = ::linearize(capacity_begin(), capacity(), m_head, m_size);
+	}
+
+	// Forgets the elements without destroying them. This is used once they have been relocated elsewhere.
+	inline void release_data() { m_head = 0; m_size = 0; }
+
+	// Gives up ownership of the capacity and the elements, which are left for the caller to destroy.
+	// The elements are linearized first, since a buffer's data is contiguous.
+	inline sequence_buffer<value_type> release()
+	{
+		linearize();
+		auto data = capacity_begin() + m_head;
+		sequence_buffer<value_type> buffer{ capacity_begin(), capacity(), data, data + m_size };
+		inherited::release_capacity();
+		m_head = 0;
+		m_size = 0;
+		return buffer;
+	}
+
+private:
+
+	// Exchanges the capacities and elements but not the allocators.
+
+	inline void swap_capacity(dynamic_sequence_storage& rhs)
+	{
+		inherited::swap(rhs);
+		std::swap(m_head, rhs.m_head);
+		std::swap(m_size, rhs.m_size);
+	}
+
+	// Moves the start of the data by 'offset' positions, wrapping around the capacity.
+	inline void move_head(std::ptrdiff_t offset) { m_head = (data_begin() + offset).position(); }
+
+	// After the capacity has grown in place, the elements which were at the end of the old capacity move to
+	// the end of the new one, so that the data wraps around the new end just as it did around the old one.
+	inline void rewrap(size_t old_cap_size)
+	{
+		if (m_head + m_size > old_cap_size)
+		{
+			auto growth = capacity() - old_cap_size;
+			relocate_bytes(capacity_begin() + m_head + growth, capacity_begin() + m_head, old_cap_size - m_head);
+			m_head += growth;
+		}
+	}
+
+	size_t m_head = 0;
+	size_t m_size = 0;
+};
+
+
+// ==============================================================================================================
+// compact_sequence_storage - This class provides the compact layout of VARIABLE storage (see sequence_traits::compact).
+// The capacity, the front gap and the size are kept (as size_types) in a header at the start of the dynamic
+// allocation, so the object itself is only one pointer, which is null when there is no capacity. The three
+// contiguous locations are supported; they differ only in where the elements are placed in the capacity and in
+// which end moves when elements are added or erased (as for dynamic_sequence_storage).
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class compact_sequence_storage
+{
+	using value_type = T;
+	using iterator = value_type*;
+	using size_type = typename decltype(TRAITS)::size_type;
+	using alloc_traits = std::allocator_traits<ALLOC>;
+
+	static constexpr auto LOC = TRAITS.location;
+
+	static_assert(LOC != sequence_location_lits::CIRCULAR, "Compact VARIABLE storage does not support CIRCULAR location.");
+	static_assert(TRAITS.alignment <= alignof(T) && TRAITS.tail_padding == 0,
+				  "Compact VARIABLE storage does not support over-alignment or tail padding.");
+
+	struct header
+	{
+		size_type capacity;
+		size_type front_gap;
+		size_type size;
+	};
+
+	// The allocation is made of blocks with the alignment of both the header and the elements. The elements
+	// start at the first suitably aligned offset after the header.
+
+	static constexpr size_t block_size = std::max(alignof(header), alignof(T));
+	struct alignas(block_size) block_type { unsigned char bytes[block_size]; };
+	using block_allocator = typename alloc_traits::template rebind_alloc<block_type>;
+	using block_traits = std::allocator_traits<block_allocator>;
+
+	static constexpr size_t data_offset = (sizeof(header) + alignof(T) - 1) / alignof(T) * alignof(T);
+	static constexpr size_t max_capacity = std::numeric_limits<size_type>::max();
+
+	static constexpr size_t blocks_for(size_t cap) { return (data_offset + cap * sizeof(T) + block_size - 1) / block_size; }
+	static constexpr size_t capacity_for(size_t blocks) { return std::min((blocks * block_size - data_offset) / sizeof(T), max_capacity); }
+
+public:
+
+	using allocator_type = ALLOC;
+
+	inline compact_sequence_storage() = default;
+	inline explicit compact_sequence_storage(const allocator_type& alloc) : m_allocator(alloc) {}
+	inline compact_sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		m_allocator(alloc)
+	{
+		copy_from(il.begin(), il.end(), il.size());
+	}
+
+	inline compact_sequence_storage(const compact_sequence_storage& rhs) :
+		m_allocator(alloc_traits::select_on_container_copy_construction(rhs.m_allocator))
+	{
+		copy_from(rhs.data_begin(), rhs.data_end(), rhs.size());
+	}
+	inline compact_sequence_storage(compact_sequence_storage&& rhs) :
+		m_allocator(std::move(rhs.m_allocator)),
+		m_header(std::exchange(rhs.m_header, nullptr))
+	{}
+
+	inline compact_sequence_storage& operator=(const compact_sequence_storage& rhs)
+	{
+		if constexpr (alloc_traits::propagate_on_container_copy_assignment::value)
+		{
+			if (m_allocator != rhs.m_allocator)
+				free();
+			m_allocator = rhs.m_allocator;
+		}
+
+		clear();
+		copy_from(rhs.data_begin(), rhs.data_end(), rhs.size());
+		return *this;
+	}
+	inline compact_sequence_storage& operator=(compact_sequence_storage&& rhs)
+	{
+		// If the allocators propagate or are equal we can take over the capacity, otherwise the elements must be moved.
+		if (alloc_traits::propagate_on_container_move_assignment::value || m_allocator == rhs.m_allocator)
+		{
+			auto header = std::exchange(rhs.m_header, nullptr);
+			free();
+			if constexpr (alloc_traits::propagate_on_container_move_assignment::value)
+				m_allocator = std::move(rhs.m_allocator);
+			m_header = header;
+		}
+		else
+		{
+			clear();
+			if (auto rhs_size = rhs.size(); rhs_size)
+			{
+				if (rhs_size > capacity())
+					reallocate(rhs_size);
+				prepare_for(rhs_size);
+				uninitialized_relocate(rhs.data_begin(), rhs.data_end(), data_begin());
+				rhs.release_data();
+				m_header->size = static_cast<size_type>(rhs_size);
+			}
+		}
+		return *this;
+	}
+
+	inline ~compact_sequence_storage()
+	{
+		free();
+	}
+
+	inline allocator_type get_allocator() const { return m_allocator; }
+
+	static constexpr size_t max_size() { return max_capacity; }
+	inline size_t capacity() const { return m_header ? m_header->capacity : 0; }
+	inline size_t size() const { return m_header ? m_header->size : 0; }
+	inline bool empty() const { return size() == 0; }
+
+	inline value_type* capacity_begin() { return m_header ? elements(m_header) : nullptr; }
+	inline value_type* capacity_end() { return capacity_begin() + capacity(); }
+	inline const value_type* capacity_begin() const { return m_header ? elements(m_header) : nullptr; }
+	inline const value_type* capacity_end() const { return capacity_begin() + capacity(); }
+	inline value_type* data_begin() { return m_header ? elements(m_header) + m_header->front_gap : nullptr; }
+	inline value_type* data_end() { return data_begin() + size(); }
+	inline const value_type* data_begin() const { return m_header ? elements(m_header) + m_header->front_gap : nullptr; }
+	inline const value_type* data_end() const { return data_begin() + size(); }
+
+	inline void swap(compact_sequence_storage& rhs)
+	{
+		if constexpr (alloc_traits::propagate_on_container_swap::value)
+			std::swap(m_allocator, rhs.m_allocator);
+		else
+			assert(m_allocator == rhs.m_allocator);
+		std::swap(m_header, rhs.m_header);
+	}
+
+	inline void reallocate(size_t new_cap)
+	{
+		assert(size() <= new_cap);
+
+		auto current_size = size();
+		auto new_header = allocate(new_cap, current_size);
+		auto offset = TRAITS.front_gap(new_header->capacity, current_size, sizeof(T));
+		try
+		{
+			uninitialized_relocate(data_begin(), data_end(), elements(new_header) + offset);
+		}
+		catch (...)
+		{
+			deallocate(new_header);
+			throw;
+		}
+		deallocate(m_header);
+		m_header = new_header;
+		set_data(offset, current_size);
+	}
+
+	// Reallocates leaving an uninitialized gap of 'count' elements at 'pos' (which is included in the size),
+	// so that the elements are only moved once. Returns the new location of the gap.
+	inline iterator reallocate(size_t new_cap, iterator pos, size_t count)
+	{
+		assert(size() + count <= new_cap);
+
+		auto new_size = size() + count;
+		auto new_header = allocate(new_cap, new_size);
+		auto offset = TRAITS.front_gap(new_header->capacity, new_size, sizeof(T));
+		try
+		{
+			pos = uninitialized_relocate(data_begin(), pos, data_end(), elements(new_header) + offset, count);
+		}
+		catch (...)
+		{
+			deallocate(new_header);
+			throw;
+		}
+		deallocate(m_header);
+		m_header = new_header;
+		set_data(offset, new_size);
+		return pos;
+	}
+
+	template<typename... ARGS>
+	inline iterator add_at(iterator pos, ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		if (LOC != sequence_location_lits::BACK && (size() == 0 || pos == data_end()))
+		{
+			add_back(std::forward<ARGS>(args)...);
+			return data_end() - 1;
+		}
+		if (LOC != sequence_location_lits::FRONT && (size() == 0 || pos == data_begin()))
+		{
+			add_front(std::forward<ARGS>(args)...);
+			return data_begin();
+		}
+
+		// Adding at the back unless the location or the position favors the front (see the MIDDLE dynamic_sequence_storage).
+		if (LOC == sequence_location_lits::FRONT ||
+			(LOC == sequence_location_lits::MIDDLE && pos - data_begin() >= data_end() - pos))
+		{
+			if (data_end() == capacity_end())
+			{
+				auto index = pos - data_begin();
+				recenter();
+				pos = data_begin() + index;
+			}
+			return back_add_at<TRAITS.in_place_emplace>(data_end(), pos, [this](){ ++m_header->size; }, std::forward<ARGS>(args)...);
+		}
+		else
+		{
+			if (data_begin() == capacity_begin())
+			{
+				auto index = pos - data_begin();
+				recenter();
+				pos = data_begin() + index;
+			}
+			return front_add_at<TRAITS.in_place_emplace>(data_begin(), pos, [this](){ --m_header->front_gap; ++m_header->size; }, std::forward<ARGS>(args)...);
+		}
+	}
+	template<typename... ARGS>
+	inline void add_front(ARGS&&... args)
+	{
+		assert(size() < capacity());
+
+		if constexpr (LOC == sequence_location_lits::FRONT)
+			add_at(data_begin(), std::forward<ARGS>(args)...);
+		else
+		{
+			if (data_begin() == capacity_begin())
+				recenter();
+			new(data_begin() - 1) value_type(std::forward<ARGS>(args)...);
+			--m_header->front_gap;
+			++m_header->size;
+		}
+	}
+	template<typename... ARGS>
+	inline void add_back(ARGS&&... args)
+	{
+		assert(size() < capacity());
+
+		if constexpr (LOC == sequence_location_lits::BACK)
+			add_at(data_end(), std::forward<ARGS>(args)...);
+		else
+		{
+			if (data_end() == capacity_end())
+				recenter();
+			new(data_end()) value_type(std::forward<ARGS>(args)...);
+			++m_header->size;
+		}
+	}
+
+	inline void pop_front()
+	{
+		assert(size());
+
+		if constexpr (LOC == sequence_location_lits::FRONT)
+			erase(data_begin());
+		else
+		{
+			data_begin()->~value_type();
+			++m_header->front_gap;
+			--m_header->size;
+		}
+	}
+	inline void pop_back()
+	{
+		assert(size());
+
+		if constexpr (LOC == sequence_location_lits::BACK)
+			erase(data_end() - 1);
+		else
+		{
+			(data_end() - 1)->~value_type();
+			--m_header->size;
+		}
+	}
+	inline void erase(value_type* erase_begin, value_type* erase_end)
+	{
+		auto count = static_cast<size_type>(erase_end - erase_begin);
+		if (erase_at_back(erase_begin, erase_end))
+			back_erase(data_end(), erase_begin, erase_end);
+		else
+		{
+			front_erase(data_begin(), erase_begin, erase_end);
+			m_header->front_gap += count;
+		}
+		m_header->size -= count;
+	}
+	inline void erase(value_type* element)
+	{
+		if (erase_at_back(element, element + 1))
+			back_erase(data_end(), element);
+		else
+		{
+			front_erase(data_begin(), element);
+			++m_header->front_gap;
+		}
+		--m_header->size;
+	}
+	inline void clear()
+	{
+		if (!empty())
+		{
+			destroy_data(data_begin(), data_end());
+			set_data(TRAITS.front_gap(capacity(), 0, sizeof(T)), 0);
+		}
+	}
+	inline void free()
+	{
+		if (!empty())
+			destroy_data(data_begin(), data_end());
+		deallocate(m_header);
+		m_header = nullptr;
+	}
+
+	void prepare_for(size_t size)
+	{
+		assert(empty());
+		assert(size <= capacity());
+		if (m_header)
+			set_data(TRAITS.front_gap(capacity(), size, sizeof(T)), 0);
+	}
+
+	// Opens an uninitialized gap of 'count' elements at 'pos' (which is included in the size), or closes
+	// one again. The caller constructs the elements in the gap.
+	inline iterator open_gap(iterator pos, size_t count)
+	{
+		assert(size() + count <= capacity());
+
+		auto new_size = size() + count;
+		value_type* new_begin;
+		if constexpr (LOC == sequence_location_lits::FRONT)
+			new_begin = data_begin();
+		else if constexpr (LOC == sequence_location_lits::BACK)
+			new_begin = data_begin() - count;
+		else
+			new_begin = middle_gap_begin(capacity_begin(), capacity_end(), data_begin(), data_end(), pos, count, TRAITS.front_bias, TRAITS);
+		pos = ::open_gap(data_begin(), data_end(), pos, new_begin, count);
+		set_data(new_begin - capacity_begin(), new_size);
+		return pos;
+	}
+	inline void close_gap(iterator gap, size_t count)
+	{
+		auto new_size = size() - count;
+		if (erase_at_back(gap, gap + count))
+			::close_gap(data_begin(), data_end(), gap, data_begin(), count);
+		else
+		{
+			::close_gap(data_begin(), data_end(), gap, data_begin() + count, count);
+			m_header->front_gap += static_cast<size_type>(count);
+		}
+		m_header->size = static_cast<size_type>(new_size);
+	}
+
+	// Forgets the elements without destroying them. This is used once they have been relocated elsewhere.
+	inline void release_data() { if (m_header) set_data(TRAITS.front_gap(capacity(), 0, sizeof(T)), 0); }
+
+private:
+
+	static inline value_type* elements(header* h) { return reinterpret_cast<value_type*>(reinterpret_cast<unsigned char*>(h) + data_offset); }
+	static inline const value_type* elements(const header* h) { return reinterpret_cast<const value_type*>(reinterpret_cast<const unsigned char*>(h) + data_offset); }
+
+	inline void set_data(size_t front_gap, size_t size)
+	{
+		m_header->front_gap = static_cast<size_type>(front_gap);
+		m_header->size = static_cast<size_type>(size);
+	}
+
+	// Elements are erased (and gaps closed) by moving the elements after them for FRONT location, and the
+	// elements before them for BACK location. MIDDLE location moves whichever side is shorter.
+	inline bool erase_at_back(const value_type* erase_begin, const value_type* erase_end) const
+	{
+		if constexpr (LOC == sequence_location_lits::MIDDLE)
+			return erase_begin - data_begin() >= data_end() - erase_end;
+		else return LOC == sequence_location_lits::FRONT;
+	}
+
+	// Only MIDDLE location can run out of room at one end while there is room at the other (see ::recenter).
+	inline void recenter()
+	{
+		if constexpr (LOC == sequence_location_lits::MIDDLE)
+		{
+			typename sequence_stats<TRAITS>::timer timer;
+			sequence_stats<TRAITS>::recentered(size());
+			auto [front_gap, back_gap] = ::recenter(capacity_begin(), capacity_end(), data_begin(), data_end(), TRAITS.front_bias, TRAITS);
+			set_data(front_gap, capacity() - front_gap - back_gap);
+		}
+	}
+
+	// Allocates a block with room for at least 'cap' elements (but no more than the size type can count) and
+	// initializes its header for an empty capacity. It must have room for at least 'needed' elements, and
+	// growing when the size type cannot count any more elements fails.
+	inline header* allocate(size_t cap, size_t needed)
+	{
+		if (needed > max_capacity || (cap > max_capacity && needed == max_capacity))
+			throw std::bad_alloc();
+		cap = std::min(cap, max_capacity);
+
+		block_allocator alloc(m_allocator);
+#ifdef __cpp_lib_allocate_at_least
+		auto [blocks, count] = block_traits::allocate_at_least(alloc, blocks_for(cap));
+#else
+		auto count = blocks_for(cap);
+		auto blocks = block_traits::allocate(alloc, count);
+#endif
+		return new(std::to_address(blocks)) header{ static_cast<size_type>(capacity_for(count)), 0, 0 };
+	}
+	inline void deallocate(header* h)
+	{
+		if (h)
+		{
+			block_allocator alloc(m_allocator);
+			block_traits::deallocate(alloc, reinterpret_cast<block_type*>(h), blocks_for(h->capacity));
+		}
+	}
+
+	template<typename IT>
+	inline void copy_from(IT first, IT last, size_t count)
+	{
+		if (count)
+		{
+			if (count > capacity())
+				reallocate(count);
+			prepare_for(count);
+			std::uninitialized_copy(first, last, data_begin());
+			m_header->size = static_cast<size_type>(count);
+		}
+	}
+
+	NO_UNIQUE_ADDRESS allocator_type m_allocator;
+	header* m_header = nullptr;
+};
+
+
+// ==============================================================================================================
+// fixed_sequence_storage - These member functions have to be here so they can see dynamic_sequence_storage.
+
+template<typename T, sequence_traits TRAITS>
+template<typename ALLOC>
+inline fixed_sequence_storage<T, TRAITS>::fixed_sequence_storage(dynamic_sequence_storage<TRAITS.location, T, TRAITS, ALLOC>&& rhs)
+{
+	auto size = static_cast<size_type>(rhs.size());
+	uninitialized_relocate(rhs.data_begin(), rhs.data_end(), new_data_start(size));
+	rhs.release_data();
+	set_size(size);				// This must come last in case of a move exception.
+}
+
+
+// ==============================================================================================================
+// sequence_storage - Base class for sequence which provides the 6 different memory allocation strategies.
+
+template<typename T, sequence_traits TRAITS, typename ALLOC, sequence_storage_lits STO = TRAITS.storage>
+class sequence_storage
+{
+	static_assert(false, "An unimplemented specialization of sequence_storage was instantiated.");
+};
+
+// STATIC storage (like std::inplace_vector or boost::static_vector).
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class sequence_storage<T, TRAITS, ALLOC, sequence_storage_lits::STATIC>
+{
+
+	using value_type = T;
+	using iterator = sequence_iterator<value_type, TRAITS>;
+	using size_type = typename decltype(TRAITS)::size_type;
+	using storage_type = fixed_sequence_storage<T, TRAITS>;
+
+public:
+
+	using allocator_type = ALLOC;
+
+	constexpr sequence_storage() = default;
+	constexpr explicit sequence_storage(const allocator_type&) {}
+	constexpr sequence_storage(std::initializer_list<value_type> il, const allocator_type& = allocator_type()) : m_storage(il) {}
+
+	// STATIC storage never allocates, so the allocator is not stored.
+	constexpr allocator_type get_allocator() const { return allocator_type(); }
+
+	static constexpr size_t max_size() { return std::numeric_limits<size_type>::max(); }
+	static constexpr size_t capacity() { return TRAITS.capacity; }
+	static constexpr bool is_dynamic() { return false; }
+	constexpr size_t size() const { return m_storage.size(); }
+	constexpr bool empty() const { return m_storage.empty(); }
+
+	constexpr void pop_front() { assert(!empty()); m_storage.pop_front(); }
+	constexpr void pop_back() { assert(!empty()); m_storage.pop_back(); }
+	constexpr void erase(iterator begin, iterator end) { assert(!empty()); m_storage.erase(begin, end); }
+	constexpr void erase(iterator element) { assert(!empty()); m_storage.erase(element); }
+	constexpr void clear() { m_storage.clear(); }
+	constexpr void free() { m_storage.clear(); }
+
+	constexpr void swap(sequence_storage& other)
+	{
+		std::swap(m_storage, other.m_storage);
+	}
+
+protected:
+
+	template<typename... ARGS>
+	constexpr iterator add_at(iterator pos, ARGS&&... args)
+	{
+		return m_storage.add_at(pos, std::forward<ARGS>(args)...);
+	}
+	template<typename... ARGS>
+	constexpr void add_front(ARGS&&... args)
+	{
+		m_storage.add_front(std::forward<ARGS>(args)...);
+	}
+	template<typename... ARGS>
+	constexpr void add_back(ARGS&&... args)
+	{
+		m_storage.add_back(std::forward<ARGS>(args)...);
+	}
+	constexpr iterator open_gap(iterator pos, size_t count)
+	{
+		return m_storage.open_gap(pos, static_cast<size_type>(count));
+	}
+	constexpr void close_gap(iterator gap, size_t count)
+	{
+		m_storage.close_gap(gap, static_cast<size_type>(count));
+	}
+
+	constexpr auto data_begin() { return m_storage.data_begin(); }
+	constexpr auto data_end() { return m_storage.data_end(); }
+	constexpr auto data_begin() const { return m_storage.data_begin(); }
+	constexpr auto data_end() const { return m_storage.data_end(); }
+	constexpr auto capacity_begin() const { return m_storage.capacity_begin(); }
+	constexpr auto capacity_end() const { return m_storage.capacity_end(); }
+
+	constexpr void reallocate(size_t new_capacity)
+	{
+		if (new_capacity > TRAITS.capacity)
+			throw std::bad_alloc();
+	}
+	constexpr iterator reallocate(size_t new_capacity, iterator pos, size_t count)
+	{
+		reallocate(new_capacity);
+		return open_gap(pos, count);
+	}
+	constexpr void prepare_for(size_type size) { m_storage.prepare_for(size); }
+	constexpr void linearize() { m_storage.linearize(); }
+
+private:
+
+	storage_type m_storage;
+};
+
+// FIXED storage.
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class sequence_storage<T, TRAITS, ALLOC, sequence_storage_lits::FIXED>
+{
+	using value_type = T;
+	using iterator = sequence_iterator<value_type, TRAITS>;
+	using const_iterator = sequence_iterator<const value_type, TRAITS>;
+	using size_type = typename decltype(TRAITS)::size_type;
+	using storage_type = fixed_sequence_storage<T, TRAITS>;
+	using alloc_traits = std::allocator_traits<ALLOC>;
+	using storage_allocator = typename alloc_traits::template rebind_alloc<storage_type>;
+	using storage_traits = std::allocator_traits<storage_allocator>;
+
+public:
+
+	using allocator_type = ALLOC;
+
+	inline sequence_storage() = default;
+	inline explicit sequence_storage(const allocator_type& alloc) : m_allocator(alloc) {}
+	inline sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		m_allocator(alloc),
+		m_storage(new_storage(il))
+	{}
+
+	inline sequence_storage(const sequence_storage& rhs) :
+		m_allocator(alloc_traits::select_on_container_copy_construction(rhs.m_allocator))
+	{
+		if (rhs.m_storage)
+			m_storage = new_storage(*rhs.m_storage);
+	}
+	inline sequence_storage(sequence_storage&& rhs) :
+		m_allocator(std::move(rhs.m_allocator)),
+		m_storage(std::exchange(rhs.m_storage, nullptr))
+	{}
+
+	inline sequence_storage& operator=(const sequence_storage& rhs)
+	{
+		if constexpr (alloc_traits::propagate_on_container_copy_assignment::value)
+		{
+			if (m_allocator != rhs.m_allocator)
+				delete_storage();
+			m_allocator = rhs.m_allocator;
+		}
+
+		if (rhs.m_storage)
+		{
+			if (!m_storage)
+				m_storage = new_storage();
+			*m_storage = *rhs.m_storage;
+		}
+		else clear();
+		return *this;
+	}
+	inline sequence_storage& operator=(sequence_storage&& rhs)
+	{
+		// If the allocators propagate or are equal we can take over the capacity, otherwise the elements must be moved.
+		if (alloc_traits::propagate_on_container_move_assignment::value || m_allocator == rhs.m_allocator)
+		{
+			auto storage = std::exchange(rhs.m_storage, nullptr);
+			delete_storage();
+			if constexpr (alloc_traits::propagate_on_container_move_assignment::value)
+				m_allocator = std::move(rhs.m_allocator);
+			m_storage = storage;
+		}
+		else if (rhs.m_storage)
+		{
+			if (!m_storage)
+				m_storage = new_storage();
+			*m_storage = std::move(*rhs.m_storage);
+		}
+		else clear();
+		return *this;
+	}
+
+	inline ~sequence_storage()
+	{
+		delete_storage();
+	}
+
+	inline allocator_type get_allocator() const { return m_allocator; }
+
+	static constexpr size_t max_size() { return std::numeric_limits<size_type>::max(); }
+	inline size_t capacity() const { return m_storage ? TRAITS.capacity : 0; }
+	static constexpr bool is_dynamic() { return true; }
+	inline size_t size() const { return m_storage ? m_storage->size() : 0; }
+	inline bool empty() const { return m_storage ? m_storage->empty() : true; }
+
+	inline void pop_front() { assert(!empty()); m_storage->pop_front(); }
+	inline void pop_back() { assert(!empty()); m_storage->pop_back(); }
+	inline void erase(iterator begin, iterator end) { assert(!empty()); m_storage->erase(begin, end); }
+	inline void erase(iterator element) { assert(!empty()); m_storage->erase(element); }
+	inline void clear() { if (m_storage) m_storage->clear(); }
+	inline void free()
+	{
+		delete_storage();
+	}
+
+	inline void swap(sequence_storage& other)
+	{
+		if constexpr (alloc_traits::propagate_on_container_swap::value)
+			std::swap(m_allocator, other.m_allocator);
+		else
+			assert(m_allocator == other.m_allocator);
+		std::swap(m_storage, other.m_storage);
+	}
+
+	// Asks the allocator to get ready to provide 'count' capacities, if it can (see pool_allocator::reserve).
+	static inline void preallocate(size_t count)
+	{
+		if constexpr (requires { storage_allocator::reserve(count); })
+			storage_allocator::reserve(count);
+	}
+
+protected:
+
+	template<typename... ARGS>
+	inline iterator add_at(iterator pos, ARGS&&... args)
+	{
+		//if (!m_storage)
+		//	m_storage.reset(new storage_type);
+		return m_storage->add_at(pos, std::forward<ARGS>(args)...);
+	}
+	template<typename... ARGS>
+	inline void add_front(ARGS&&... args)
+	{
+		//if (!m_storage)
+		//	m_storage.reset(new storage_type);
+		m_storage->add_front(std::forward<ARGS>(args)...);
+	}
+	template<typename... ARGS>
+	inline void add_back(ARGS&&... args)
+	{
+		//if (!m_storage)
+		//	m_storage.reset(new storage_type);
+		m_storage->add_back(std::forward<ARGS>(args)...);
+	}
+	inline iterator open_gap(iterator pos, size_t count)
+	{
+		return m_storage->open_gap(pos, static_cast<size_type>(count));
+	}
+	inline void close_gap(iterator gap, size_t count)
+	{
+		m_storage->close_gap(gap, static_cast<size_type>(count));
+	}
+	//template<typename... ARGS>
+	//inline void add(size_t new_size, ARGS&&... args)
+	//{
+	//	if (!m_storage)
+	//		m_storage.reset(new storage_type);
+	//	m_storage->add(new_size, std::forward<ARGS>(args)...);
+	//}
+
+	inline auto data_begin() { return m_storage ? m_storage->data_begin() : iterator(); }
+	inline auto data_end() { return m_storage ? m_storage->data_end() : iterator(); }
+	inline auto data_begin() const { return m_storage ? m_storage->data_begin() : const_iterator(); }
+	inline auto data_end() const { return m_storage ? m_storage->data_end() : const_iterator(); }
+	inline auto capacity_begin() const { return m_storage ? m_storage->capacity_begin() : nullptr; }
+	inline auto capacity_end() const { return m_storage ? m_storage->capacity_end() : nullptr; }
+
+	inline void reallocate(size_t new_capacity)
+	{
+		if (new_capacity > TRAITS.capacity)
+			throw std::bad_alloc();
+		if (!m_storage)
+			m_storage = new_storage();
+	}
+	inline iterator reallocate(size_t new_capacity, iterator pos, size_t count)
+	{
+		auto index = pos - data_begin();
+		reallocate(new_capacity);
+		return open_gap(data_begin() + index, count);
+	}
+	inline void prepare_for(size_type size) { if (m_storage) m_storage->prepare_for(size); }
+	inline void linearize() { if (m_storage) m_storage->linearize(); }
+
+private:
+
+	// The capacity (including the size(s)) is a single storage_type object obtained from the allocator.
+
+	template<typename... ARGS>
+	inline storage_type* new_storage(ARGS&&... args)
+	{
+		storage_allocator alloc(m_allocator);
+		auto storage = storage_traits::allocate(alloc, 1);
+		try
+		{
+			return new(storage) storage_type(std::forward<ARGS>(args)...);
+		}
+		catch (...)
+		{
+			storage_traits::deallocate(alloc, storage, 1);
+			throw;
+		}
+	}
+	inline void delete_storage()
+	{
+		if (m_storage)
+		{
+			storage_allocator alloc(m_allocator);
+			m_storage->~storage_type();
+			storage_traits::deallocate(alloc, m_storage, 1);
+			m_storage = nullptr;
+		}
+	}
+
+	NO_UNIQUE_ADDRESS allocator_type m_allocator;
+	storage_type* m_storage = nullptr;
+};
+
+// VARIABLE storage.
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class sequence_storage<T, TRAITS, ALLOC, sequence_storage_lits::VARIABLE>
+{
+	using value_type = T;
+	using iterator = sequence_iterator<value_type, TRAITS>;
+	using size_type = typename decltype(TRAITS)::size_type;
+
+	// The compact layout keeps the sizes in the allocation (see compact_sequence_storage).
+	using storage_type = std::conditional_t<TRAITS.compact,
+		compact_sequence_storage<T, TRAITS, ALLOC>, dynamic_sequence_storage<TRAITS.location, T, TRAITS, ALLOC>>;
+
+public:
+
+	using allocator_type = ALLOC;
+
+	inline sequence_storage() = default;
+	inline explicit sequence_storage(const allocator_type& alloc) : m_storage(alloc) {}
+	inline sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		m_storage(il, alloc)
+	{}
+	inline sequence_storage(const sequence_buffer<value_type>& buffer, const allocator_type& alloc) :
+		m_storage(buffer, alloc)
+	{}
+
+	inline allocator_type get_allocator() const { return m_storage.get_allocator(); }
+
+	static constexpr size_t max_size()
+	{
+		return TRAITS.compact ? std::numeric_limits<size_type>::max() : std::numeric_limits<size_t>::max();
+	}
+	inline size_t capacity() const { return m_storage.capacity(); }
+	static constexpr bool is_dynamic() { return true; }
+	inline size_t size() const { return m_storage.size(); }
+	inline bool empty() const { return m_storage.empty(); }
+
+	inline void pop_front() { assert(!empty()); m_storage.pop_front(); }
+	inline void pop_back() { assert(!empty()); m_storage.pop_back(); }
+	inline void erase(iterator begin, iterator end) { assert(!empty()); m_storage.erase(begin, end); }
+	inline void erase(iterator element) { assert(!empty()); m_storage.erase(element); }
+	inline void clear() { m_storage.clear(); }
+	inline void free() { m_storage.free(); }
+	inline sequence_buffer<value_type> release() { return m_storage.release(); }
+
+	inline void swap(sequence_storage& other)
+	{
+		m_storage.swap(other.m_storage);
+	}
+
+protected:
+
+	template<typename... ARGS>
+	inline iterator add_at(iterator pos, ARGS&&... args) { return m_storage.add_at(pos, std::forward<ARGS>(args)...); }
+	template<typename... ARGS>
+	inline void add_front(ARGS&&... args) { m_storage.add_front(std::forward<ARGS>(args)...); }
+	template<typename... ARGS>
+	inline void add_back(ARGS&&... args) { m_storage.add_back(std::forward<ARGS>(args)...); }
+	inline iterator open_gap(iterator pos, size_t count) { return m_storage.open_gap(pos, count); }
+	inline void close_gap(iterator gap, size_t count) { m_storage.close_gap(gap, count); }
+
+	inline auto data_begin() { return m_storage.data_begin(); }
+	inline auto data_end() { return m_storage.data_end(); }
+	inline auto data_begin() const { return m_storage.data_begin(); }
+	inline auto data_end() const { return m_storage.data_end(); }
+	inline auto capacity_begin() const { return m_storage.capacity_begin(); }
+	inline auto capacity_end() const { return m_storage.capacity_end(); }
+
+	inline void reallocate(size_t new_capacity)
+	{
+		m_storage.reallocate(new_capacity);
+	}
+	inline iterator reallocate(size_t new_capacity, iterator pos, size_t count)
+	{
+		return m_storage.reallocate(new_capacity, pos, count);
+	}
+	inline void prepare_for(size_t size) { m_storage.prepare_for(size); }
+	inline void linearize() { m_storage.linearize(); }
+
+private:
+
+	storage_type m_storage;
+};
+
+// BUFFERED storage supporting a small object buffer optimization (like boost::small_vector).
+//
+// The data pointers are always valid, whether the elements are in the buffer or in a dynamically allocated
+// capacity, so the element accessors (data_begin, data_end, size, etc.) are plain loads with no dispatch.
+// The dynamic capacity pointers share space with the buffer (which is unused when the capacity is dynamic).
+// Where the elements are is determined from the data pointers: they point into the buffer if and only if the
+// capacity is buffered. The buffer is strictly inside the object (it is preceded by m_data_begin and followed
+// by m_data_end), so pointers into (or just past) a separately allocated capacity can never point into it.
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class sequence_storage<T, TRAITS, ALLOC, sequence_storage_lits::BUFFERED>
+{
+	using value_type = T;
+	using iterator = value_type*;
+	using const_iterator = const value_type*;
+	using size_type = typename decltype(TRAITS)::size_type;
+	using alloc_traits = std::allocator_traits<ALLOC>;
+	using capacity_type = dynamic_capacity<T, TRAITS, ALLOC>;	// Provides the raw dynamic capacity operations.
+
+	static constexpr auto LOC = TRAITS.location;
+
+	// The elements are always contiguous (the data pointers also tell where they are), so they cannot wrap around.
+	static_assert(LOC != sequence_location_lits::CIRCULAR, "BUFFERED storage does not support CIRCULAR location.");
+
+public:
+
+	using allocator_type = ALLOC;
+
+	inline sequence_storage() { set_empty(); }
+	inline explicit sequence_storage(const allocator_type& alloc) : m_allocator(alloc) { set_empty(); }
+	inline sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		m_allocator(alloc)
+	{
+		set_empty();
+		construct_from(il.begin(), il.end(), il.size());
+	}
+
+	// An adopted buffer which is no bigger than our own is given back once the elements are moved into ours.
+
+	inline sequence_storage(const sequence_buffer<value_type>& buffer, const allocator_type& alloc) :
+		m_allocator(alloc)
+	{
+		static_assert(!capacity_type::is_padded, "A padded or over-aligned capacity cannot be adopted.");
+
+		set_empty();
+		if (buffer.capacity > TRAITS.capacity)
+		{
+			m_heap = {buffer.capacity_begin, buffer.capacity_begin + buffer.capacity};
+			if constexpr (LOC == sequence_location_lits::MIDDLE)
+				m_data_begin = buffer.data_begin != buffer.data_end ? buffer.data_begin : m_heap.begin;
+			else
+				m_data_begin = m_heap.begin + TRAITS.front_gap(buffer.capacity, buffer.data_end - buffer.data_begin);
+			m_data_end = adopt_data(buffer, m_data_begin);
+		}
+		else if (buffer.capacity_begin)
+		{
+			try
+			{
+				m_data_begin = buffer_begin() + TRAITS.front_gap(TRAITS.capacity, buffer.data_end - buffer.data_begin, sizeof(T));
+				m_data_end = uninitialized_relocate(buffer.data_begin, buffer.data_end, m_data_begin);
+			}
+			catch (...)
+			{
+				set_empty();
+				destroy_data(buffer.data_begin, buffer.data_end);
+				capacity_type::deallocate(m_allocator, buffer.capacity_begin, buffer.capacity);
+				throw;
+			}
+			capacity_type::deallocate(m_allocator, buffer.capacity_begin, buffer.capacity);
+		}
+	}
+
+	// A copy is buffered if the elements fit in the buffer. Otherwise its dynamic capacity fits the
+	// elements exactly (as for VARIABLE storage).
+
+	inline sequence_storage(const sequence_storage& rhs) :
+		m_allocator(alloc_traits::select_on_container_copy_construction(rhs.m_allocator))
+	{
+		set_empty();
+		construct_from(rhs.data_begin(), rhs.data_end(), rhs.size());
+	}
+	inline sequence_storage(sequence_storage&& rhs) : m_allocator(std::move(rhs.m_allocator))
+	{
+		set_empty();
+		take(rhs);
+	}
+
+	inline sequence_storage& operator=(const sequence_storage& rhs)
+	{
+		if constexpr (alloc_traits::propagate_on_container_copy_assignment::value)
+		{
+			if (m_allocator != rhs.m_allocator)
+				free();
+			m_allocator = rhs.m_allocator;
+		}
+
+		clear();
+		copy_from(rhs.data_begin(), rhs.data_end(), rhs.size());
+		return *this;
+	}
+
+	// If the allocators don't propagate and are unequal, a dynamic capacity cannot be taken over, so the
+	// elements are relocated into capacity from our own allocator (as for VARIABLE storage).
+
+	inline sequence_storage& operator=(sequence_storage&& rhs)
+	{
+		if (rhs.is_buffered() ||
+			alloc_traits::propagate_on_container_move_assignment::value || m_allocator == rhs.m_allocator)
+		{
+			free();
+			if constexpr (alloc_traits::propagate_on_container_move_assignment::value)
+				std::swap(m_allocator, rhs.m_allocator);
+			take(rhs);
+		}
+		else
+		{
+			clear();
+			if (rhs.size() > capacity())
+				reallocate(rhs.size());
+			auto begin = capacity_begin() + TRAITS.front_gap(capacity(), rhs.size(), sizeof(T));
+			m_data_end = uninitialized_relocate(rhs.m_data_begin, rhs.m_data_end, begin);
+			m_data_begin = begin;
+			rhs.free_capacity();
+			rhs.set_empty();
+		}
+		return *this;
+	}
+
+	inline ~sequence_storage()
+	{
+		destroy_data(m_data_begin, m_data_end);
+		free_capacity();
+	}
+
+	inline allocator_type get_allocator() const { return m_allocator; }
+
+	static constexpr size_t max_size() { return std::numeric_limits<size_type>::max(); }
+	inline size_t capacity() const { return is_buffered() ? TRAITS.capacity : m_heap.end - m_heap.begin; }
+	inline bool is_dynamic() const { return !is_buffered(); }
+	inline size_t size() const { return m_data_end - m_data_begin; }
+	inline bool empty() const { return m_data_begin == m_data_end; }
+
+	inline void pop_front()
+	{
+		assert(!empty());
+
+		if constexpr (LOC == sequence_location_lits::FRONT)
+			erase(m_data_begin);
+		else
+		{
+			m_data_begin->~value_type();
+			++m_data_begin;
+		}
+	}
+	inline void pop_back()
+	{
+		assert(!empty());
+
+		if constexpr (LOC == sequence_location_lits::BACK)
+			erase(m_data_end - 1);
+		else
+		{
+			--m_data_end;
+			m_data_end->~value_type();
+		}
+	}
+
+	// FRONT erases at the back, BACK erases at the front, and MIDDLE erases at whichever end is nearer.
+
+	inline void erase(value_type* erase_begin, value_type* erase_end)
+	{
+		assert(!empty());
+
+		if (erase_at_back(erase_begin, erase_end))
+		{
+			back_erase(m_data_end, erase_begin, erase_end);
+			m_data_end -= erase_end - erase_begin;
+		}
+		else
+		{
+			front_erase(m_data_begin, erase_begin, erase_end);
+			m_data_begin += erase_end - erase_begin;
+		}
+	}
+	inline void erase(value_type* element)
+	{
+		assert(!empty());
+
+		if (erase_at_back(element, element + 1))
+		{
+			back_erase(m_data_end, element);
+			--m_data_end;
+		}
+		else
+		{
+			front_erase(m_data_begin, element);
+			++m_data_begin;
+		}
+	}
+	inline void clear()
+	{
+		if (!empty())
+		{
+			destroy_data(m_data_begin, m_data_end);
+			if constexpr (LOC == sequence_location_lits::FRONT)
+				m_data_end = m_data_begin;
+			else if constexpr (LOC == sequence_location_lits::BACK)
+				m_data_begin = m_data_end;
+			else
+			{
+				m_data_begin = capacity_begin() + TRAITS.front_gap(capacity(), 0, sizeof(T));
+				m_data_end = m_data_begin;
+			}
+		}
+	}
+	inline void free()
+	{
+		destroy_data(m_data_begin, m_data_end);
+		free_capacity();
+		set_empty();
+	}
+
+	// The buffer cannot be released, so elements in it are first moved to a capacity of their own.
+
+	inline sequence_buffer<value_type> release()
+	{
+		static_assert(!capacity_type::is_padded, "A padded or over-aligned capacity cannot be released.");
+
+		if (is_buffered())
+		{
+			if (empty())
+				return {};
+			reallocate_to(capacity_type::allocate(m_allocator, size()), m_data_end, 0);
+		}
+		sequence_buffer<value_type> buffer{ m_heap.begin, capacity(), m_data_begin, m_data_end };
+		set_empty();
+		return buffer;
+	}
+
+	// If both capacities are dynamic they are simply exchanged. Otherwise the elements are relocated
+	// through a temporary (which is left buffered and empty).
+
+	inline void swap(sequence_storage& other)
+	{
+		if constexpr (alloc_traits::propagate_on_container_swap::value)
+			std::swap(m_allocator, other.m_allocator);
+		else
+			assert(m_allocator == other.m_allocator);
+
+		if (!is_buffered() && !other.is_buffered())
+		{
+			std::swap(m_heap, other.m_heap);
+			std::swap(m_data_begin, other.m_data_begin);
+			std::swap(m_data_end, other.m_data_end);
+		}
+		else
+		{
+			sequence_storage temp(m_allocator);
+			temp.take(other);
+			other.take(*this);
+			take(temp);
+		}
+	}
+
+protected:
+
+	template<typename... ARGS>
+	inline iterator add_at(iterator pos, ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		if constexpr (LOC == sequence_location_lits::FRONT)
+		{
+			if (pos == m_data_end)
+				add_back(std::forward<ARGS>(args)...);
+			else
+				pos = back_add_at<TRAITS.in_place_emplace>(m_data_end, pos, [this](){ ++m_data_end; }, std::forward<ARGS>(args)...);
+		}
+		else if constexpr (LOC == sequence_location_lits::BACK)
+		{
+			if (pos == m_data_begin)
+			{
+				add_front(std::forward<ARGS>(args)...);
+				pos = m_data_begin;
+			}
+			else
+				pos = front_add_at<TRAITS.in_place_emplace>(m_data_begin, pos, [this](){ --m_data_begin; }, std::forward<ARGS>(args)...);
+		}
+		else if (empty() || pos == m_data_end)
+		{
+			add_back(std::forward<ARGS>(args)...);
+			pos = m_data_end - 1;
+		}
+		else if (pos == m_data_begin)
+		{
+			add_front(std::forward<ARGS>(args)...);
+			pos = m_data_begin;
+		}
+		else if (pos - m_data_begin >= m_data_end - pos)	// Inserting closer to the end--add at back.
+		{
+			if (m_data_end == capacity_end())
+			{
+				auto index = pos - m_data_begin;
+				recenter();
+				pos = m_data_begin + index;
+			}
+			pos = back_add_at<TRAITS.in_place_emplace>(m_data_end, pos, [this](){ ++m_data_end; }, std::forward<ARGS>(args)...);
+		}
+		else												// Inserting closer to the beginning--add at front.
+		{
+			if (m_data_begin == capacity_begin())
+			{
+				auto index = pos - m_data_begin;
+				recenter();
+				pos = m_data_begin + index;
+			}
+			pos = front_add_at<TRAITS.in_place_emplace>(m_data_begin, pos, [this](){ --m_data_begin; }, std::forward<ARGS>(args)...);
+		}
+		return pos;
+	}
+	template<typename... ARGS>
+	inline void add_front(ARGS&&... args)
+	{
+		assert(size() < capacity());
+
+		if constexpr (LOC == sequence_location_lits::FRONT)
+			add_at(m_data_begin, std::forward<ARGS>(args)...);
+		else
+		{
+			if (LOC == sequence_location_lits::MIDDLE && m_data_begin == capacity_begin())
+				recenter();
+			new(m_data_begin - 1) value_type(std::forward<ARGS>(args)...);
+			--m_data_begin;
+		}
+	}
+	template<typename... ARGS>
+	inline void add_back(ARGS&&... args)
+	{
+		assert(size() < capacity());
+
+		if constexpr (LOC == sequence_location_lits::BACK)
+			add_at(m_data_end, std::forward<ARGS>(args)...);
+		else
+		{
+			if (LOC == sequence_location_lits::MIDDLE && m_data_end == capacity_end())
+				recenter();
+			new(m_data_end) value_type(std::forward<ARGS>(args)...);
+			++m_data_end;
+		}
+	}
+
+	// Opens an uninitialized gap of 'count' elements at 'pos' (which is included in the size), or closes
+	// one again. The caller constructs the elements in the gap.
+	inline iterator open_gap(iterator pos, size_t count)
+	{
+		assert(size() + count <= capacity());
+
+		auto new_size = size() + count;
+		auto new_begin = m_data_begin;
+		if constexpr (LOC == sequence_location_lits::BACK)
+			new_begin -= count;
+		else if constexpr (LOC == sequence_location_lits::MIDDLE)
+			new_begin = middle_gap_begin(capacity_begin(), capacity_end(), m_data_begin, m_data_end, pos, count, TRAITS.front_bias, TRAITS);
+
+		pos = ::open_gap(m_data_begin, m_data_end, pos, new_begin, count);
+		m_data_begin = new_begin;
+		m_data_end = new_begin + new_size;
+		return pos;
+	}
+	inline void close_gap(iterator gap, size_t count)
+	{
+		// FRONT closes up the back, BACK closes up the front, and MIDDLE closes up the shorter side.
+		if (erase_at_back(gap, gap + count))
+		{
+			::close_gap(m_data_begin, m_data_end, gap, m_data_begin, count);
+			m_data_end -= count;
+		}
+		else
+		{
+			::close_gap(m_data_begin, m_data_end, gap, m_data_begin + count, count);
+			m_data_begin += count;
+		}
+	}
+
+	inline iterator data_begin()				{ return m_data_begin; }
+	inline const_iterator data_begin() const	{ return m_data_begin; }
+	inline iterator data_end()					{ return m_data_end; }
+	inline const_iterator data_end() const		{ return m_data_end; }
+
+	// For FRONT and BACK the data shares one end with the capacity, so that end needs no test.
+
+	inline iterator capacity_begin()
+	{
+		if constexpr (LOC == sequence_location_lits::FRONT)
+			return m_data_begin;
+		else return is_buffered() ? buffer_begin() : m_heap.begin;
+	}
+	inline iterator capacity_end()
+	{
+		if constexpr (LOC == sequence_location_lits::BACK)
+			return m_data_end;
+		else return is_buffered() ? buffer_end() : m_heap.end;
+	}
+	inline const_iterator capacity_begin() const
+	{
+		if constexpr (LOC == sequence_location_lits::FRONT)
+			return m_data_begin;
+		else return is_buffered() ? buffer_begin() : m_heap.begin;
+	}
+	inline const_iterator capacity_end() const
+	{
+		if constexpr (LOC == sequence_location_lits::BACK)
+			return m_data_end;
+		else return is_buffered() ? buffer_end() : m_heap.end;
+	}
+
+	inline void reallocate(size_t new_capacity)
+	{
+		reallocate(new_capacity, m_data_end, 0);
+	}
+
+	// Capacities which fit in the buffer use it. Otherwise a dynamic capacity is resized in place if the
+	// allocator can do that (see dynamic_capacity), or a new one is allocated. The elements are moved once,
+	// leaving a gap of 'count' elements at 'pos', and the new location of the gap is returned.
+
+	inline iterator reallocate(size_t new_capacity, iterator pos, size_t count)
+	{
+		assert(size() + count <= new_capacity);
+
+		if (new_capacity <= TRAITS.capacity)
+		{
+			if (is_buffered())
+				return count ? open_gap(pos, count) : pos;
+			return reallocate_to({buffer_begin(), TRAITS.capacity}, pos, count);
+		}
+
+		if (!is_buffered() && new_capacity >= capacity())
+		{
+			auto offset = m_data_begin - m_heap.begin;
+			auto index = pos - m_data_begin;
+			auto current_size = size();
+			if (auto begin = capacity_type::resize(m_allocator, m_heap.begin, capacity(), new_capacity))
+			{
+				auto old_begin = begin + offset;
+				m_heap = {begin, begin + new_capacity};
+				m_data_begin = begin + TRAITS.front_gap(new_capacity, current_size + count, sizeof(T));
+				m_data_end = m_data_begin + (current_size + count);
+				return ::open_gap(old_begin, old_begin + current_size, old_begin + index, m_data_begin, count);
+			}
+		}
+
+		return reallocate_to(capacity_type::allocate(m_allocator, new_capacity), pos, count);
+	}
+	inline void prepare_for(size_t size) {}
+
+private:
+
+	struct heap_capacity
+	{
+		iterator begin;
+		iterator end;
+	};
+
+	inline iterator buffer_begin() { return m_buffer; }
+	inline iterator buffer_end() { return m_buffer + TRAITS.capacity; }
+	inline const_iterator buffer_begin() const { return m_buffer; }
+	inline const_iterator buffer_end() const { return m_buffer + TRAITS.capacity; }
+
+	// FRONT data always starts at the capacity, and BACK data always ends at it, so a single comparison
+	// suffices. MIDDLE data may be anywhere in the capacity.
+
+	inline bool is_buffered() const
+	{
+		if constexpr (LOC == sequence_location_lits::FRONT)
+			return m_data_begin == buffer_begin();
+		else if constexpr (LOC == sequence_location_lits::BACK)
+			return m_data_end == buffer_end();
+		else
+			return std::less_equal<const value_type*>()(buffer_begin(), m_data_begin) &&
+				std::less_equal<const value_type*>()(m_data_begin, buffer_end());
+	}
+
+	inline bool erase_at_back(const_iterator erase_begin, const_iterator erase_end) const
+	{
+		if constexpr (LOC == sequence_location_lits::MIDDLE)
+			return erase_begin - m_data_begin >= m_data_end - erase_end;
+		else return LOC == sequence_location_lits::FRONT;
+	}
+
+	// Copies 'n' elements into the (empty) storage, reallocating if they don't fit.
+	template<typename IT>
+	inline void copy_from(IT first, IT last, size_t n)
+	{
+		if (n > capacity())
+			reallocate(n);
+		auto begin = capacity_begin() + TRAITS.front_gap(capacity(), n, sizeof(T));
+		m_data_end = std::uninitialized_copy(first, last, begin);
+		m_data_begin = begin;
+	}
+
+	// As copy_from, for constructors (where the destructor will not free the capacity if the copy throws).
+	template<typename IT>
+	inline void construct_from(IT first, IT last, size_t n)
+	{
+		try
+		{
+			copy_from(first, last, n);
+		}
+		catch (...)
+		{
+			free_capacity();
+			throw;
+		}
+	}
+
+	// Makes the (empty) sequence use the buffer.
+	inline void set_empty()
+	{
+		m_data_begin = buffer_begin() + TRAITS.front_gap(TRAITS.capacity, 0, sizeof(T));
+		m_data_end = m_data_begin;
+	}
+
+	// Gives a dynamic capacity back to the allocator. The data pointers are left dangling.
+	inline void free_capacity()
+	{
+		if (!is_buffered())
+			capacity_type::deallocate(m_allocator, m_heap.begin, m_heap.end - m_heap.begin);
+	}
+
+	// Relocates the elements to a new capacity (the buffer or one just obtained from the allocator), leaving
+	// a gap of 'count' elements at 'pos', and frees the old capacity. Returns the new location of the gap.
+	// If the relocation throws, the new capacity is freed and the old capacity and elements are left as they were.
+
+	inline iterator reallocate_to(std::pair<iterator, size_t> new_capacity, iterator pos, size_t count)
+	{
+		auto [begin, cap] = new_capacity;
+		auto new_size = size() + count;
+		auto new_begin = begin + TRAITS.front_gap(cap, new_size, sizeof(T));
+
+		// The heap pointers are overwritten if the elements are moving into the buffer.
+		auto old_heap = is_buffered() ? heap_capacity{} : m_heap;
+		try
+		{
+			pos = uninitialized_relocate(m_data_begin, pos, m_data_end, new_begin, count);
+		}
+		catch (...)
+		{
+			if (old_heap.begin)
+				m_heap = old_heap;
+			if (begin != buffer_begin())
+				capacity_type::deallocate(m_allocator, begin, cap);
+			throw;
+		}
+
+		if (old_heap.begin)
+			capacity_type::deallocate(m_allocator, old_heap.begin, old_heap.end - old_heap.begin);
+		if (begin != buffer_begin())
+			m_heap = {begin, begin + cap};
+		m_data_begin = new_begin;
+		m_data_end = new_begin + new_size;
+		return pos;
+	}
+
+	// Takes the elements and capacity of rhs, relocating any buffered elements into our buffer (at the same
+	// place). We must be empty with no dynamic capacity, and the allocators must be compatible. rhs is left
+	// empty and buffered.
+
+	inline void take(sequence_storage& rhs)
+	{
+		if (rhs.is_buffered())
+		{
+			auto begin = buffer_begin() + (rhs.m_data_begin - rhs.buffer_begin());
+			m_data_end = uninitialized_relocate(rhs.m_data_begin, rhs.m_data_end, begin);
+			m_data_begin = begin;
+		}
+		else
+		{
+			m_heap = rhs.m_heap;
+			m_data_begin = rhs.m_data_begin;
+			m_data_end = rhs.m_data_end;
+		}
+		rhs.set_empty();
+	}
+
+	// Recenters MIDDLE elements in the capacity (see ::recenter).
+	inline void recenter()
+	{
+		typename sequence_stats<TRAITS>::timer timer;
+		sequence_stats<TRAITS>::recentered(m_data_end - m_data_begin);
+		auto [front_gap, back_gap] = ::recenter(capacity_begin(), capacity_end(), m_data_begin, m_data_end, TRAITS.front_bias, TRAITS);
+		auto size = m_data_end - m_data_begin;
+		m_data_begin = capacity_begin() + front_gap;
+		m_data_end = m_data_begin + size;
+	}
+
+	iterator m_data_begin;
+	union
+	{
+		alignas(std::max(TRAITS.alignment, alignof(T))) value_type m_buffer[TRAITS.capacity];
+		heap_capacity m_heap;
+	};
+	NO_UNIQUE_ADDRESS tail_padding_bytes<TRAITS.tail_padding> m_padding;
+	iterator m_data_end;
+	NO_UNIQUE_ADDRESS allocator_type m_allocator;
+};
+
+// SEGMENTED storage which grows by adding segments rather than by reallocating (a little like std::deque).
+//
+// The elements are kept in segments of TRAITS.capacity elements, which are listed in a segment table. When the
+// capacity grows only the table is reallocated, so the elements never move (and pointers to them stay valid)
+// and there is no peak in which the old and new capacities are both allocated. Indexing goes through the table
+// (see segment_iterator), so it is still constant time. The elements are added to, and removed from, the back
+// of the last segment in use, as for FRONT location. The leading segments may have been allocated as a single
+// block by linearize, in which case they are contiguous and go back to the allocator together.
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class sequence_storage<T, TRAITS, ALLOC, sequence_storage_lits::SEGMENTED>
+{
+	using value_type = T;
+	using iterator = segment_iterator<value_type, TRAITS.capacity>;
+	using const_iterator = segment_iterator<const value_type, TRAITS.capacity>;
+	using size_type = typename decltype(TRAITS)::size_type;
+	using alloc_traits = std::allocator_traits<ALLOC>;
+	using capacity_type = dynamic_capacity<T, TRAITS, ALLOC>;	// Provides the raw dynamic capacity operations.
+	using table_allocator = typename alloc_traits::template rebind_alloc<value_type*>;
+	using table_traits = std::allocator_traits<table_allocator>;
+
+	static constexpr size_t SEG = TRAITS.capacity;
+
+	// There is no room before the first element, so the elements cannot be kept anywhere but at the front.
+	static_assert(TRAITS.location == sequence_location_lits::FRONT, "SEGMENTED storage only supports FRONT location.");
+
+public:
+
+	using allocator_type = ALLOC;
+
+	inline sequence_storage() = default;
+	inline explicit sequence_storage(const allocator_type& alloc) : m_allocator(alloc) {}
+	inline sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		sequence_storage(alloc)
+	{
+		copy_from(il.begin(), il.end(), il.size());
+	}
+	inline sequence_storage(const sequence_storage& rhs) :
+		sequence_storage(alloc_traits::select_on_container_copy_construction(rhs.m_allocator))
+	{
+		copy_from(rhs.data_begin(), rhs.data_end(), rhs.size());
+	}
+	inline sequence_storage(sequence_storage&& rhs) : m_allocator(std::move(rhs.m_allocator))
+	{
+		take(rhs);
+	}
+
+	inline sequence_storage& operator=(const sequence_storage& rhs)
+	{
+		if constexpr (alloc_traits::propagate_on_container_copy_assignment::value)
+		{
+			if (m_allocator != rhs.m_allocator)
+				free();
+			m_allocator = rhs.m_allocator;
+		}
+
+		clear();
+		copy_from(rhs.data_begin(), rhs.data_end(), rhs.size());
+		return *this;
+	}
+
+	// If the allocators don't propagate and are unequal, the segments cannot be taken over, so the
+	// elements are moved into segments from our own allocator (as for VARIABLE storage).
+
+	inline sequence_storage& operator=(sequence_storage&& rhs)
+	{
+		if (alloc_traits::propagate_on_container_move_assignment::value || m_allocator == rhs.m_allocator)
+		{
+			free();
+			if constexpr (alloc_traits::propagate_on_container_move_assignment::value)
+				std::swap(m_allocator, rhs.m_allocator);
+			take(rhs);
+		}
+		else
+		{
+			clear();
+			if (rhs.size() > capacity())
+				reallocate(rhs.size());
+			uninitialized_move_if_noexcept(rhs.data_begin(), rhs.data_end(), data_begin());
+			m_size = rhs.size();
+			rhs.free();
+		}
+		return *this;
+	}
+
+	inline ~sequence_storage() { free(); }
+
+	inline allocator_type get_allocator() const { return m_allocator; }
+
+	static constexpr size_t max_size() { return std::numeric_limits<size_type>::max(); }
+	inline size_t capacity() const { return m_segment_count * SEG; }
+	static constexpr bool is_dynamic() { return true; }
+	inline size_t size() const { return m_size; }
+	inline bool empty() const { return m_size == 0; }
+
+	inline void pop_front()
+	{
+		assert(!empty());
+
+		erase(data_begin());
+	}
+	inline void pop_back()
+	{
+		assert(!empty());
+
+		--m_size;
+		element(m_size)->~value_type();
+	}
+	inline void erase(iterator erase_begin, iterator erase_end)
+	{
+		assert(!empty());
+
+		back_erase(data_end(), erase_begin, erase_end);
+		m_size -= erase_end - erase_begin;
+	}
+	inline void erase(iterator element)
+	{
+		assert(!empty());
+
+		back_erase(data_end(), element);
+		--m_size;
+	}
+	inline void clear()
+	{
+		destroy_data(data_begin(), data_end());
+		m_size = 0;
+	}
+	inline void free()
+	{
+		clear();
+		free_segments(0);
+		if (m_segments)
+		{
+			table_allocator alloc(m_allocator);
+			table_traits::deallocate(alloc, m_segments, m_table_size);
+		}
+		m_segments = nullptr;
+		m_table_size = 0;
+	}
+
+	inline void swap(sequence_storage& rhs)
+	{
+		if constexpr (alloc_traits::propagate_on_container_swap::value)
+			std::swap(m_allocator, rhs.m_allocator);
+		else
+			assert(m_allocator == rhs.m_allocator);
+
+		std::swap(m_segments, rhs.m_segments);
+		std::swap(m_table_size, rhs.m_table_size);
+		std::swap(m_segment_count, rhs.m_segment_count);
+		std::swap(m_block, rhs.m_block);
+		std::swap(m_size, rhs.m_size);
+	}
+
+	// Returns the contiguous pieces which hold the elements, in order: one for each segment in use, except
+	// that a block allocated by linearize is a single piece. The view is invalidated if the sequence changes.
+
+	inline auto segments() { return pieces<value_type>(); }
+	inline auto segments() const { return pieces<const value_type>(); }
+
+protected:
+
+	template<typename... ARGS>
+	inline iterator add_at(iterator pos, ARGS&&... args)
+	{
+		assert(size() < capacity());
+		assert(pos >= data_begin() && pos <= data_end());
+
+		if (pos == data_end())
+			add_back(std::forward<ARGS>(args)...);
+		else
+			pos = back_add_at<TRAITS.in_place_emplace>(data_end(), pos, [this](){ ++m_size; }, std::forward<ARGS>(args)...);
+		return pos;
+	}
+	template<typename... ARGS>
+	inline void add_front(ARGS&&... args)
+	{
+		add_at(data_begin(), std::forward<ARGS>(args)...);
+	}
+	template<typename... ARGS>
+	inline void add_back(ARGS&&... args)
+	{
+		assert(size() < capacity());
+
+		new(element(m_size)) value_type(std::forward<ARGS>(args)...);
+		++m_size;
+	}
 
-public:
+	// Opens an uninitialized gap of 'count' elements at 'pos' (which is included in the size), or closes
+	// one again. The caller constructs the elements in the gap.
+	inline iterator open_gap(iterator pos, size_t count)
+	{
+		assert(size() + count <= capacity());
+		pos = ::open_gap(data_begin(), data_end(), pos, data_begin(), count);
+		m_size += count;
+		return pos;
+	}
+	inline void close_gap(iterator gap, size_t count)
+	{
+		::close_gap(data_begin(), data_end(), gap, data_begin(), count);
+		m_size -= count;
+	}
 
-	using inherited::capacity;
-	using inherited::capacity_begin;
-	using inherited::capacity_end;
-	using inherited::data_begin;
-	using inherited::data_end;
-	using inherited::size;
-	using inherited::empty;
-	//using inherited::erase;
-	//using inherited::pop_front;
-	//using inherited::pop_back;
+	inline iterator data_begin() { return {m_segments, 0}; }
+	inline iterator data_end() { return {m_segments, static_cast<std::ptrdiff_t>(m_size)}; }
+	inline const_iterator data_begin() const { return {m_segments, 0}; }
+	inline const_iterator data_end() const { return {m_segments, static_cast<std::ptrdiff_t>(m_size)}; }
+	inline const_iterator capacity_begin() const { return {m_segments, 0}; }
+	inline const_iterator capacity_end() const { return {m_segments, static_cast<std::ptrdiff_t>(capacity())}; }
 
-	inline fixed_sequence_storage() = default;
-	inline fixed_sequence_storage(std::initializer_list<value_type> il)
+	// The capacity grows by adding segments, so the elements never move. When it shrinks, the segments after
+	// the elements are given back (but a block allocated by linearize is only given back as a whole).
+
+	inline void reallocate(size_t new_capacity)
 	{
-		if (il.size() > capacity())
-			throw std::bad_alloc();
+		assert(size() <= new_capacity);
 
-		std::uninitialized_copy(il.begin(), il.end(), new_data_start(static_cast<size_type>(il.size())));
-		set_size(static_cast<size_type>(il.size()));	// This must come last in case of a copy exception.
+		if (auto count = segments_for(new_capacity); count > m_segment_count)
+			add_segments(count);
+		else
+			free_segments(count);
+	}
+	inline iterator reallocate(size_t new_capacity, iterator pos, size_t count)
+	{
+		auto index = pos - data_begin();
+		reallocate(new_capacity);
+		return open_gap(data_begin() + index, count);
 	}
-	fixed_sequence_storage(dynamic_sequence_storage<TRAITS.location, T, TRAITS>&&);
+	void prepare_for(size_t size) {}
 
-	inline fixed_sequence_storage(const fixed_sequence_storage& rhs)
+	// Moves the elements into a single block of segments, so that they are contiguous. The block takes the
+	// place of the segments which held them (the others are kept), so the capacity does not change. If a
+	// move throws, the elements are left where they were.
+
+	inline void linearize()
 	{
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), new_data_start(rhs.size()));
-		set_size(rhs.size());							// This must come last in case of a move exception.
+		auto count = segments_for(m_size);
+		if (count <= std::max<size_t>(m_block, 1))
+			return;
+
+		auto block = capacity_type::allocate(m_allocator, count * SEG).first;
+		if constexpr (is_trivially_relocatable_v<T>)
+		{
+			auto dst = block;
+			for (auto piece : segments())
+			{
+				relocate_bytes(dst, piece.data(), piece.size());
+				dst += piece.size();
+			}
+		}
+		else
+		{
+			try
+			{
+				uninitialized_move_if_noexcept(data_begin(), data_end(), block);
+			}
+			catch (...)
+			{
+				capacity_type::deallocate(m_allocator, block, count * SEG);
+				throw;
+			}
+			destroy_data(data_begin(), data_end());
+		}
+
+		auto first = m_block;
+		if (m_block)
+			capacity_type::deallocate(m_allocator, m_segments[0], m_block * SEG);
+		for (auto i = first; i < count; ++i)
+			capacity_type::deallocate(m_allocator, m_segments[i], SEG);
+		for (size_t i = 0; i < count; ++i)
+			m_segments[i] = block + i * SEG;
+		m_block = count;
 	}
-	inline fixed_sequence_storage(fixed_sequence_storage&& rhs)
+
+private:
+
+	static constexpr size_t segments_for(size_t cap) { return (cap + SEG - 1) / SEG; }
+
+	inline value_type* element(size_t index) { return m_segments[index / SEG] + index % SEG; }
+
+	// Adds segments until there are 'count'. If an allocation fails, the segments added so far are kept.
+	inline void add_segments(size_t count)
 	{
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), new_data_start(rhs.size()));
-		set_size(rhs.size());							// This must come last in case of a move exception.
+		if (count > m_table_size)
+		{
+			auto table_size = std::max(count, m_table_size + m_table_size / 2);
+			table_allocator alloc(m_allocator);
+			auto table = table_traits::allocate(alloc, table_size);
+			std::copy_n(m_segments, m_segment_count, table);
+			if (m_segments)
+				table_traits::deallocate(alloc, m_segments, m_table_size);
+			m_segments = table;
+			m_table_size = table_size;
+		}
+		while (m_segment_count < count)
+		{
+			m_segments[m_segment_count] = capacity_type::allocate(m_allocator, SEG).first;
+			++m_segment_count;
+		}
 	}
 
-	inline fixed_sequence_storage& operator=(const fixed_sequence_storage& rhs)
+	// Gives back the segments after the first 'keep' (which must not hold elements). The table is kept.
+	inline void free_segments(size_t keep)
 	{
-		clear();
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), new_data_start(rhs.size()));
-		set_size(rhs.size());
-		return *this;
+		while (m_segment_count > std::max(keep, m_block))
+		{
+			--m_segment_count;
+			capacity_type::deallocate(m_allocator, m_segments[m_segment_count], SEG);
+		}
+		if (keep == 0 && m_block)
+		{
+			capacity_type::deallocate(m_allocator, m_segments[0], m_block * SEG);
+			m_segment_count = 0;
+			m_block = 0;
+		}
 	}
-	inline fixed_sequence_storage& operator=(fixed_sequence_storage&& rhs)
+
+	// Copies elements into empty storage, adding segments if necessary.
+	template<typename IT>
+	inline void copy_from(IT first, IT last, size_t count)
 	{
-		clear();
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), new_data_start(rhs.size()));
-		set_size(rhs.size());
-		return *this;
+		if (count > capacity())
+			reallocate(count);
+		std::uninitialized_copy(first, last, data_begin());
+		m_size = count;
 	}
 
-	inline ~fixed_sequence_storage()
+	// Takes the segments and elements of rhs, which is left empty with no capacity. We must have no capacity.
+	inline void take(sequence_storage& rhs)
 	{
-		destroy_data(data_begin(), data_end());
+		m_segments = std::exchange(rhs.m_segments, nullptr);
+		m_table_size = std::exchange(rhs.m_table_size, 0);
+		m_segment_count = std::exchange(rhs.m_segment_count, 0);
+		m_block = std::exchange(rhs.m_block, 0);
+		m_size = std::exchange(rhs.m_size, 0);
 	}
 
-	inline void clear()
+	template<typename U>
+	inline auto pieces() const
 	{
-		if (!empty())
+		auto first = std::max<size_t>(m_block, 1);		// The number of segments in the first piece.
+		auto used = segments_for(m_size);
+		auto count = used == 0 ? 0 : 1 + (used > first ? used - first : 0);
+
+		return std::views::iota(size_t(0), count) | std::views::transform([this, first](size_t piece)
 		{
-			destroy_data(data_begin(), data_end());
-			set_size(0);
-		}
-	}
+			auto begin = piece == 0 ? 0 : (first + piece - 1) * SEG;
+			auto end = std::min(m_size, piece == 0 ? first * SEG : begin + SEG);
+			return std::span<U>(m_segments[begin / SEG], end - begin);
+		});
+	}
+
+	value_type** m_segments = nullptr;		// The segment table.
+	size_t m_table_size = 0;				// The number of entries allocated for the table.
+	size_t m_segment_count = 0;				// The number of segments allocated.
+	size_t m_block = 0;						// The number of leading segments allocated as a block by linearize.
+	size_t m_size = 0;
+	NO_UNIQUE_ADDRESS allocator_type m_allocator;
 };
-#ifdef NOTHERE
-template<typename T, sequence_traits TRAITS>
-class fixed_sequence_storage<sequence_location_lits::BACK, T, TRAITS> : fixed_capacity<T, TRAITS.capacity>
+
+#ifdef SEQUENCE_MAPPED_STORAGE
+
+// MAPPED storage whose capacity is a memory mapping provided by the allocator (see mapped_allocator).
+//
+// The elements are managed exactly as for VARIABLE storage (so all of the locations work), and the capacity is
+// resized in place by the allocator (with ftruncate and mremap), so the elements are never copied. When the
+// allocator maps a file, a sequence constructed with it adopts the elements already in the file. When it gives
+// up its capacity (it is freed or destroyed) the elements are moved to the start of the mapping and the file is
+// cut down to them, so afterwards the file holds exactly the elements. This is why they must be trivially copyable.
+
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class sequence_storage<T, TRAITS, ALLOC, sequence_storage_lits::MAPPED>
 {
 	using value_type = T;
-	using iterator = value_type*;
-	using size_type = typename decltype(TRAITS)::size_type;
-	using inherited = fixed_capacity<T, TRAITS.capacity>;
+	using iterator = sequence_iterator<value_type, TRAITS>;
+
+	static_assert(std::is_trivially_copyable_v<T>, "MAPPED storage requires trivially copyable elements.");
+	static_assert(dynamic_capacity<T, TRAITS, ALLOC>::can_resize,
+				  "MAPPED storage requires an allocator which provides 'reallocate' and no padding or over-alignment.");
+	static_assert(requires(const ALLOC& alloc, const T* p, size_t n)
+				  {
+					  { alloc.contents() } -> std::same_as<sequence_buffer<T>>;
+					  alloc.is_file_backed();
+					  alloc.persist(n);
+					  alloc.sync(p, n);
+					  alloc.advise(p, n, mapped_advice_lits::NORMAL);
+				  },
+				  "MAPPED storage requires a mapping allocator (such as mapped_allocator).");
 
 public:
 
-	using inherited::capacity;
-	using inherited::capacity_begin;
-	using inherited::capacity_end;
+	using allocator_type = ALLOC;
 
-	inline fixed_sequence_storage() = default;
-	inline fixed_sequence_storage(std::initializer_list<value_type> il)
-	{
-		assert(il.size() <= capacity());
+	inline sequence_storage() = default;
+	inline explicit sequence_storage(const allocator_type& alloc) : m_storage(alloc.contents(), alloc) {}
+	inline sequence_storage(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		m_storage(il, alloc)
+	{}
+	inline sequence_storage(const sequence_buffer<value_type>& buffer, const allocator_type& alloc) :
+		m_storage(buffer, alloc)
+	{}
+	inline sequence_storage(const sequence_storage&) = default;
+	inline sequence_storage(sequence_storage&&) = default;
 
-		std::uninitialized_copy(il.begin(), il.end(), capacity_end() - il.size());
-		m_size = static_cast<size_type>(il.size());
+	// A file can only be mapped once, so the assignments never allocate while holding a mapping. Copy assignment
+	// keeps the allocator (and so the file), and grows the mapping in place before copying the elements. Move
+	// assignment takes the allocator and mapping of 'rhs', so the old mapping is given up first (see free), which
+	// leaves a file holding the elements it had.
+	inline sequence_storage& operator=(const sequence_storage& rhs)
+	{
+		if (this != &rhs)
+		{
+			m_storage.clear();
+			if (rhs.size() > capacity())
+				reallocate(rhs.size());
+			m_storage = rhs.m_storage;
+		}
+		return *this;
 	}
-
-	inline fixed_sequence_storage(const fixed_sequence_storage& rhs)
+	inline sequence_storage& operator=(sequence_storage&& rhs)
 	{
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_end() - rhs.m_size);
-		m_size = rhs.m_size;
+		if (this != &rhs)
+		{
+			free();
+			m_storage = std::move(rhs.m_storage);
+		}
+		return *this;
 	}
-	inline fixed_sequence_storage(fixed_sequence_storage&& rhs)
+
+	inline ~sequence_storage() { free(); }
+
+	inline allocator_type get_allocator() const { return m_storage.get_allocator(); }
+
+	static constexpr size_t max_size() { return std::numeric_limits<size_t>::max(); }
+	inline size_t capacity() const { return m_storage.capacity(); }
+	static constexpr bool is_dynamic() { return true; }
+	inline size_t size() const { return m_storage.size(); }
+	inline bool empty() const { return m_storage.empty(); }
+
+	inline void pop_front() { assert(!empty()); m_storage.pop_front(); }
+	inline void pop_back() { assert(!empty()); m_storage.pop_back(); }
+	inline void erase(iterator begin, iterator end) { assert(!empty()); m_storage.erase(begin, end); }
+	inline void erase(iterator element) { assert(!empty()); m_storage.erase(element); }
+	inline void clear() { m_storage.clear(); }
+	inline sequence_buffer<value_type> release() { return m_storage.release(); }
+
+	// Gives the mapping back. If it is a file the elements are first moved to the start of it, and the file
+	// is then cut down to them.
+	inline void free()
 	{
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_end() - rhs.m_size);
-		m_size = rhs.m_size;
+		if (!m_storage.capacity_begin())
+			return;
+
+		auto alloc = m_storage.get_allocator();
+		auto size = m_storage.size();
+		if (alloc.is_file_backed())
+		{
+			if constexpr (TRAITS.location == sequence_location_lits::CIRCULAR)
+				m_storage.linearize();
+			auto data = data_spans(m_storage.data_begin(), m_storage.data_end()).first;
+			relocate_bytes(m_storage.capacity_begin(), data.data(), data.size());
+			m_storage.release_data();
+		}
+		m_storage.free();
+		alloc.persist(size);
 	}
 
-	inline fixed_sequence_storage& operator=(const fixed_sequence_storage& rhs)
+	// Writes the elements back to the file (see mapped_allocator::sync), or gives the kernel advice about
+	// how they will be accessed (see mapped_allocator::advise).
+	inline void sync() const
 	{
-		clear();
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_end() - rhs.m_size);
-		m_size = rhs.m_size;
-		return *this;
+		auto [first, second] = data_spans(m_storage.data_begin(), m_storage.data_end());
+		auto alloc = m_storage.get_allocator();
+		alloc.sync(first.data(), first.size());
+		alloc.sync(second.data(), second.size());
 	}
-	inline fixed_sequence_storage& operator=(fixed_sequence_storage&& rhs)
+	inline void advise(mapped_advice_lits advice) const
 	{
-		clear();
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_end() - rhs.m_size);
-		m_size = rhs.m_size;
-		return *this;
+		auto [first, second] = data_spans(m_storage.data_begin(), m_storage.data_end());
+		auto alloc = m_storage.get_allocator();
+		alloc.advise(first.data(), first.size(), advice);
+		alloc.advise(second.data(), second.size(), advice);
 	}
 
-	inline ~fixed_sequence_storage()
+	inline void swap(sequence_storage& other)
 	{
-		destroy_data(data_begin(), data_end());
+		m_storage.swap(other.m_storage);
 	}
 
-	inline value_type* data_begin() { return capacity_end() - m_size; }
-	inline value_type* data_end() { return capacity_end(); }
-	inline const value_type* data_begin() const { return capacity_end() - m_size; }
-	inline const value_type* data_end() const { return capacity_end(); }
-	inline size_t size() const { return m_size; }
-	inline bool empty() const { return m_size == 0; }
+protected:
 
 	template<typename... ARGS>
-	inline iterator add_at(iterator pos, ARGS&&... args)
+	inline iterator add_at(iterator pos, ARGS&&... args) { return m_storage.add_at(pos, std::forward<ARGS>(args)...); }
+	template<typename... ARGS>
+	inline void add_front(ARGS&&... args) { m_storage.add_front(std::forward<ARGS>(args)...); }
+	template<typename... ARGS>
+	inline void add_back(ARGS&&... args) { m_storage.add_back(std::forward<ARGS>(args)...); }
+	inline iterator open_gap(iterator pos, size_t count) { return m_storage.open_gap(pos, count); }
+	inline void close_gap(iterator gap, size_t count) { m_storage.close_gap(gap, count); }
+
+	inline auto data_begin() { return m_storage.data_begin(); }
+	inline auto data_end() { return m_storage.data_end(); }
+	inline auto data_begin() const { return m_storage.data_begin(); }
+	inline auto data_end() const { return m_storage.data_end(); }
+	inline auto capacity_begin() const { return m_storage.capacity_begin(); }
+	inline auto capacity_end() const { return m_storage.capacity_end(); }
+
+	// Growing resizes the mapping in place (see dynamic_capacity::resize_capacity). Shrinking must not map a
+	// second time either, so the elements are moved to the start of the mapping, which is then cut down (with
+	// the allocator's 'reallocate') and adopted again. If it cannot be cut down it is kept as it is.
+	inline void reallocate(size_t new_capacity)
 	{
-		assert(size() < capacity());
-		assert(pos >= data_begin() && pos <= data_end());
+		if (new_capacity >= capacity())
+		{
+			m_storage.reallocate(new_capacity);
+			return;
+		}
 
-		if (m_size == 0 || pos == data_begin())
-			add_front(std::forward<ARGS>(args)...);
+		auto alloc = m_storage.get_allocator();
+		auto buffer = m_storage.release();
+		auto size = static_cast<size_t>(buffer.data_end - buffer.data_begin);
+		relocate_bytes(buffer.capacity_begin, buffer.data_begin, size);
+		if (auto p = alloc.reallocate(buffer.capacity_begin, buffer.capacity, new_capacity))
+			buffer = {p, new_capacity, p, p + size};
 		else
-			pos = front_add_at(data_begin(), pos, [this](){ ++m_size; }, std::forward<ARGS>(args)...);
-		return pos;
+			buffer = {buffer.capacity_begin, buffer.capacity, buffer.capacity_begin, buffer.capacity_begin + size};
+		m_storage = storage_type(buffer, alloc);
 	}
-	template<typename... ARGS>
-	inline void add_front(ARGS&&... args)
+	inline iterator reallocate(size_t new_capacity, iterator pos, size_t count)
 	{
-		assert(size() < capacity());
-
-		new(data_begin() - 1) value_type(std::forward<ARGS>(args)...);
-		++m_size;
+		return m_storage.reallocate(new_capacity, pos, count);
 	}
+	inline void prepare_for(size_t size) { m_storage.prepare_for(size); }
+	inline void linearize() { m_storage.linearize(); }
+
+private:
+
+	using storage_type = dynamic_sequence_storage<TRAITS.location, T, TRAITS, ALLOC>;
+
+	storage_type m_storage;
+};
+
+#endif
+
+// ==============================================================================================================
+// sequence - This is the main class template.
+
+export template<typename T, sequence_traits TRAITS = sequence_traits<size_t>(), typename ALLOC = std::allocator<T>>
+class sequence : public sequence_storage<T, TRAITS, ALLOC>
+{
+	using inherited = sequence_storage<T, TRAITS, ALLOC>;
+	using stats = sequence_stats<TRAITS>;
+	using inherited::data_begin;
+	using inherited::data_end;
+	using inherited::add_at;
+	using inherited::add_front;
+	using inherited::add_back;
+	using inherited::open_gap;
+	using inherited::close_gap;
+	using inherited::prepare_for;
+
+public:
+
+	using value_type = T;
+	using reference = value_type&;
+	using const_reference = const value_type&;
+	using iterator = sequence_iterator<value_type, TRAITS>;
+	using const_iterator = sequence_iterator<const value_type, TRAITS>;
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+	using allocator_type = ALLOC;
+
+	using inherited::get_allocator;
+	using inherited::size;
+	using inherited::empty;
+	using inherited::capacity;
+	using inherited::capacity_begin;
+	using inherited::capacity_end;
+	using inherited::free;
+
+	using traits_type = decltype(TRAITS);
+	static constexpr traits_type traits = TRAITS;
+	using size_type = typename traits_type::size_type;
+	static constexpr bool is_circular = traits.location == sequence_location_lits::CIRCULAR;
+	static constexpr bool is_segmented = traits.storage == sequence_storage_lits::SEGMENTED;
+	static constexpr bool is_contiguous = !is_circular && !is_segmented;
+	static constexpr bool is_mapped = traits.storage == sequence_storage_lits::MAPPED;
+	static constexpr bool is_serializable = std::is_trivially_copyable_v<T>;
+
+	// Variable capacity means that the capacity must grow, and this growth must actually make progress.
+	// Zero capacity is not permitted (although this could be changed if it poses problems in generic contexts).
+	static_assert(traits.capacity > 0,
+				  "Capacity must be greater than 0.");
+	static_assert(traits.increment > 0,
+				  "Linear capacity growth must be greater than 0.");
+	static_assert(traits.factor > 1.0f,
+				  "Exponential capacity growth must be greater than 1.0.");
+	static_assert(traits.growth != sequence_growth_lits::CUSTOM || !std::is_void_v<typename traits_type::growth_policy>,
+				  "Custom capacity growth requires a growth policy.");
+
+	// Maintaining elements in the middle of the capacity is more or less useless without the ability to shift.
+	static_assert(traits.location != sequence_location_lits::MIDDLE || std::move_constructible<T>,
+				  "Middle element location requires move-constructible types.");
+	static_assert(traits.front_bias >= 0.0f && traits.front_bias <= 1.0f,
+				  "Front bias must be between 0.0 and 1.0.");
+
+	// The learned bias is kept per sequence, which is only done by the variable MIDDLE storage.
+	static_assert(!traits.adaptive_bias || (traits.location == sequence_location_lits::MIDDLE &&
+				  ((traits.storage == sequence_storage_lits::VARIABLE && !traits.compact) || traits.storage == sequence_storage_lits::MAPPED)),
+				  "Adaptive bias requires MIDDLE location and non-compact VARIABLE or MAPPED storage.");
+
+	// A fixed capacity of any kind requires that the size type can represent a count up to the fixed capacity size.
+	static_assert((traits.storage == sequence_storage_lits::VARIABLE && !traits.compact) || traits.storage == sequence_storage_lits::MAPPED ||
+				  traits.capacity <= std::numeric_limits<size_type>::max(),
+				  "Size type is insufficient to hold requested capacity.");
+
+	// The allocator must allocate elements (as with the standard containers).
+	static_assert(std::same_as<typename std::allocator_traits<allocator_type>::value_type, T>,
+				  "Allocator value type must be the same as the element type.");
+
+	constexpr sequence() = default;
+	constexpr sequence(const sequence&) = default;
+	constexpr sequence(sequence&&) = default;
+	constexpr explicit sequence(const allocator_type& alloc) : inherited(alloc) {}
+	constexpr sequence(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		inherited(il, alloc)
+	{}
 	template<typename... ARGS>
-	inline void add_back(ARGS&&... args)
+	constexpr sequence(size_type n, ARGS&&... args)
 	{
-		add_at(data_end(), std::forward<ARGS>(args)...);
+		if (n)
+			reallocate(std::max<size_t>(n, traits.capacity));
+		add(n, std::forward<ARGS>(args)...);
+	}
+	template<execution_policy POLICY, typename... ARGS>
+	constexpr sequence(POLICY&& policy, size_type n, ARGS&&... args)
+	{
+		if (n)
+			reallocate(std::max<size_t>(n, traits.capacity));
+		add(policy, n, std::forward<ARGS>(args)...);
 	}
+	template<execution_policy POLICY>
+	constexpr sequence(POLICY&& policy, const sequence& other) :
+		inherited(std::allocator_traits<allocator_type>::select_on_container_copy_construction(other.get_allocator()))
+	{
+		copy_from(policy, other);
+	}
+	template<std::input_iterator IT>
+	constexpr sequence(IT first, IT last, const allocator_type& alloc = allocator_type()) :
+		inherited(alloc)
+	{
+		assign(first, last);
+	}
+
+	// Adopts a buffer obtained from an allocator equal to 'alloc', taking ownership of the capacity and the
+	// elements in it. The elements are shifted within the capacity if the location requires it.
+	constexpr explicit sequence(const sequence_buffer<value_type>& buffer, const allocator_type& alloc = allocator_type())
+		requires (traits.is_variable() && !is_segmented && !traits.compact) :
+		inherited(buffer, alloc)
+	{}
+
+	constexpr sequence& operator=(const sequence&) = default;
+	constexpr sequence& operator=(sequence&&) = default;
+	constexpr sequence& operator=(std::initializer_list<value_type> il) { assign(il); return *this; }
+
 	template<typename... ARGS>
-	inline void add(size_t count, ARGS&&... args)
+	constexpr void assign(size_type n, ARGS&&... args)
 	{
-		while (count--)
-			add_front(std::forward<ARGS>(args)...);
+		clear_for(n);
+		add(n, std::forward<ARGS>(args)...);
 	}
 
-	inline void clear()
+	// If the size of the new elements is known up front, the capacity is allocated (at most) once and the
+	// elements are copied straight into their final location. Otherwise they are added one at a time.
+
+	template<std::input_iterator IT>
+	constexpr void assign(IT first, IT last)
 	{
-		if (!empty())
+		if constexpr (std::forward_iterator<IT>)
 		{
-			destroy_data(data_begin(), data_end());
-			m_size = 0;
+			clear_for(std::distance(first, last));
+			insert(data_end(), first, last);
+		}
+		else
+		{
+			inherited::clear();
+			for (; first != last; ++first)
+				emplace_back(*first);
 		}
 	}
-	inline void erase(value_type* erase_begin, value_type* erase_end)
+	template<std::ranges::input_range R>
+	constexpr void assign_range(R&& rg)
 	{
-		front_erase(data_begin(), data_end(), erase_begin, erase_end,
-					[this](size_t count){ m_size -= static_cast<size_type>(count); });
+		if constexpr (std::ranges::sized_range<R> || std::ranges::forward_range<R>)
+			clear_for(static_cast<size_t>(std::ranges::distance(rg)));
+		else
+			inherited::clear();
+		append_range(std::forward<R>(rg));
 	}
-	inline void erase(value_type* element)
+
+	constexpr void assign(std::initializer_list<value_type> il) { assign(il.begin(), il.end()); }
+
+	// The parallel overloads split constructing, copying and destroying the elements into pieces which run
+	// concurrently under 'policy', when there are at least 'parallel_threshold' of them and the sequence is
+	// contiguous (otherwise they are the same as the sequential functions). If an element constructor throws, the
+	// elements constructed by the other pieces are destroyed and the exception is rethrown, as it would be by the
+	// sequential functions (see parallel_construct). copy_from keeps this sequence's allocator, as assign does.
+
+	template<execution_policy POLICY>
+	constexpr void copy_from(POLICY&& policy, const sequence& other)
 	{
-		front_erase(data_begin(), data_end(), element, [this](){ --m_size; });
+		if (this == &other)
+			return;
+		clear(policy);
+		clear_for(other.size());
+		if constexpr (is_contiguous)
+		{
+			if (size_t count = other.size(); count >= traits.parallel_threshold)
+			{
+				insert_gap(data_end(), count, [&](iterator gap)
+				{
+					parallel_construct(policy, gap, count, [&, src = other.data_begin()](size_t first, size_t last)
+					{
+						std::uninitialized_copy(src + first, src + last, gap + first);
+					});
+				});
+				return;
+			}
+		}
+		insert(data_end(), other.begin(), other.end());
 	}
-	inline void pop_front()
-	{
-		assert(size());
 
-		auto dst = data_begin();
-		--m_size;
-		dst->~value_type();
-	}
-	inline void pop_back()
-	{
-		assert(size());
+	constexpr iterator					begin() { return data_begin(); }
+	constexpr const_iterator			begin() const { return data_begin(); }
+	constexpr iterator					end() { return data_end(); }
+	constexpr const_iterator			end() const { return data_end(); }
+	constexpr reverse_iterator			rbegin() { return reverse_iterator(data_end()); }
+	constexpr const_reverse_iterator	rbegin() const { return const_reverse_iterator(data_end()); }
+	constexpr reverse_iterator			rend() { return reverse_iterator(data_begin()); }
+	constexpr const_reverse_iterator	rend() const { return const_reverse_iterator(data_begin()); }
 
-		erase(data_end() - 1);
-	}
+	constexpr const_iterator			cbegin() const { return data_begin(); }
+	constexpr const_iterator			cend() const { return data_end(); }
+	constexpr const_reverse_iterator	crbegin() const { return const_reverse_iterator(data_end()); }
+	constexpr const_reverse_iterator	crend() const { return const_reverse_iterator(data_begin()); }
 
-private:
+	constexpr value_type*				data() requires (is_contiguous) { return data_begin(); }
+	constexpr const value_type*		data() const requires (is_contiguous) { return data_begin(); }
 
-	size_type m_size = 0;
-};
+	// The elements of a CIRCULAR sequence may wrap around the end of the capacity. 'as_spans' returns the
+	// (at most two) contiguous pieces which hold them, in order. 'linearize' moves them (in place) so that
+	// they are contiguous and returns them as one piece; this takes linear time unless they already are.
+	// For the other locations the elements are always one piece, so these are trivial.
+	// The elements of a SEGMENTED sequence are in any number of pieces, which 'segments' returns (as a view).
+	// 'linearize' moves them into a single block (see the SEGMENTED sequence_storage).
 
-template<typename T, sequence_traits TRAITS>
-class fixed_sequence_storage<sequence_location_lits::MIDDLE, T, TRAITS> : fixed_capacity<T, TRAITS.capacity>
-{
-	using value_type = T;
-	using iterator = value_type*;
-	using size_type = typename decltype(TRAITS)::size_type;
-	using inherited = fixed_capacity<T, TRAITS.capacity>;
+	constexpr std::pair<std::span<value_type>, std::span<value_type>> as_spans() requires (!is_segmented)
+	{
+		return data_spans(data_begin(), data_end());
+	}
+	constexpr std::pair<std::span<const value_type>, std::span<const value_type>> as_spans() const requires (!is_segmented)
+	{
+		return data_spans(data_begin(), data_end());
+	}
+	constexpr auto segments() requires (is_segmented) { return inherited::segments(); }
+	constexpr auto segments() const requires (is_segmented) { return inherited::segments(); }
+	constexpr std::span<value_type> linearize()
+	{
+		if constexpr (is_circular || is_segmented)
+			inherited::linearize();
+		if constexpr (is_segmented)
+			return empty() ? std::span<value_type>() : std::span<value_type>(std::addressof(front()), size());
+		else
+			return as_spans().first;
+	}
 
-public:
+	// The capacity of a MAPPED sequence is a memory mapping. 'sync' writes the elements back to the mapped file
+	// (if there is one) and 'advise' tells the kernel how they will be accessed (see mapped_allocator).
 
-	using inherited::capacity;
-	using inherited::capacity_begin;
-	using inherited::capacity_end;
+	constexpr void sync() const requires (is_mapped) { inherited::sync(); }
+	constexpr void advise(mapped_advice_lits advice) const requires (is_mapped) { inherited::advise(advice); }
 
-	inline fixed_sequence_storage() = default;
-	inline fixed_sequence_storage(std::initializer_list<value_type> il)
+	constexpr value_type&				front() { return *data_begin(); }
+	constexpr const value_type&		front() const { return *data_begin(); }
+	constexpr value_type&				back() { return *(data_end() - 1); }
+	constexpr const value_type&		back() const { return *(data_end() - 1); }
+
+	constexpr value_type& at(size_t index)
 	{
-		assert(il.size() <= capacity());
+		if (index >= size()) throw std::out_of_range(std::format(OUT_OF_RANGE_ERROR, index));
+		return *(data_begin() + index);
+	}
+	constexpr const value_type& at(size_t index) const
+	{
+		if (index >= size()) throw std::out_of_range(std::format(OUT_OF_RANGE_ERROR, index));
+		return *(data_begin() + index);
+	}
+	constexpr value_type& operator[](size_t index) & { return *(data_begin() + index); }
+	constexpr const value_type& operator[](size_t index) const & { return *(data_begin() + index); }
 
-		auto offset = TRAITS.front_gap(il.size());
-		std::uninitialized_copy(il.begin(), il.end(), capacity_begin() + offset);
-		m_front_gap = static_cast<size_type>(offset);
-		m_back_gap = static_cast<size_type>(TRAITS.capacity - (m_front_gap + il.size()));
+	constexpr void reserve(size_t new_capacity)
+	{
+		if (!traits.is_variable() || new_capacity > capacity())
+			reallocate(new_capacity);
 	}
 
-	inline fixed_sequence_storage(const fixed_sequence_storage& rhs)
+	// Each FIXED capacity is allocated as a single object. 'preallocate' lets the allocator prepare to provide
+	// 'count' of them without allocating anything itself (e.g. pool_allocator fills its pool).
+
+	static constexpr void preallocate(size_t count) requires (traits.storage == sequence_storage_lits::FIXED)
 	{
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_begin() + rhs.m_front_gap);
-		m_front_gap = rhs.m_front_gap;
-		m_back_gap = rhs.m_back_gap;
+		inherited::preallocate(count);
 	}
-	inline fixed_sequence_storage(fixed_sequence_storage&& rhs)
+	constexpr void erase(iterator erase_begin, iterator erase_end)
 	{
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_begin() + rhs.m_front_gap);
-		m_front_gap = rhs.m_front_gap;
-		m_back_gap = rhs.m_back_gap;
+		record_erase(erase_begin - data_begin(), data_end() - erase_end);
+		inherited::erase(erase_begin, erase_end);
+	}
+	constexpr void erase(iterator element)
+	{
+		record_erase(element - data_begin(), data_end() - (element + 1));
+		inherited::erase(element);
 	}
 
-	inline fixed_sequence_storage& operator=(const fixed_sequence_storage& rhs)
+	// Clearing keeps the capacity so that it can be refilled without allocating, unless it is a dynamic
+	// capacity larger than the 'retain_limit' trait, which is given back.
+
+	constexpr void clear()
 	{
-		clear();
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_begin() + rhs.m_front_gap);
-		m_front_gap = rhs.m_front_gap;
-		m_back_gap = rhs.m_back_gap;
-		return *this;
+		inherited::clear();
+		if constexpr (traits.retain_limit < std::numeric_limits<size_t>::max())
+			if (inherited::is_dynamic() && capacity() > traits.retain_limit)
+				free();
 	}
-	inline fixed_sequence_storage& operator=(fixed_sequence_storage&& rhs)
+	template<execution_policy POLICY>
+	constexpr void clear(POLICY&& policy)
 	{
+		if (!empty())
+			erase(policy, data_begin(), data_end());
 		clear();
-		std::uninitialized_move(rhs.data_begin(), rhs.data_end(), capacity_begin() + rhs.m_front_gap);
-		m_front_gap = rhs.m_front_gap;
-		m_back_gap = rhs.m_back_gap;
-		return *this;
 	}
-
-	inline ~fixed_sequence_storage()
+	template<execution_policy POLICY>
+	constexpr void free(POLICY&& policy)
 	{
-		destroy_data(data_begin(), data_end());
+		clear(policy);
+		free();
+	}
+	constexpr void shrink_to_fit()
+	{
+		if (auto current_size = size(); current_size == 0)
+			free();
+		else if (traits.is_variable() && current_size < capacity())
+			reallocate(current_size);
 	}
 
-	inline value_type* data_begin() { return capacity_begin() + m_front_gap; }
-	inline value_type* data_end() { return capacity_end() - m_back_gap; }
-	inline const value_type* data_begin() const { return capacity_begin() + m_front_gap; }
-	inline const value_type* data_end() const { return capacity_end() - m_back_gap; }
-	inline size_t size() const { return capacity() - (m_front_gap + m_back_gap); }
-	inline bool empty() const { return m_front_gap + m_back_gap == capacity(); }
-
+	// Gives up ownership of the capacity and the elements in it, leaving the sequence empty. The caller
+	// becomes responsible for destroying the elements and deallocating the capacity with get_allocator().
+	constexpr sequence_buffer<value_type> release() requires (traits.is_variable() && !is_segmented && !traits.compact)
+	{
+		return inherited::release();
+	}
 	template<typename... ARGS>
-	inline iterator add_at(iterator pos, ARGS&&... args)
+	constexpr void resize(size_type new_size, ARGS&&... args)
 	{
-		assert(size() < capacity());
-		assert(pos >= data_begin() && pos <= data_end());
+		auto old_size = size();
 
-		if (size() == 0 || pos == data_end())
-			add_back(std::forward<ARGS>(args)...);
-		else if (pos == data_begin())
-			add_front(std::forward<ARGS>(args)...);
-		else if (pos - data_begin() >= data_end() - pos)			// Inserting closer to the end--add at back.
-		{
-			if (m_back_gap == 0)
-			{
-				recenter();
-				pos -= m_back_gap;
-			}
-			pos = back_add_at(data_end(), pos, [this](){ --m_back_gap; }, std::forward<ARGS>(args)...);
-		}
-		else										// Inserting closer to the beginning--add at front.
+		if (new_size < old_size)
+			erase(data_end() - (old_size - new_size), data_end());
+		else if (new_size > old_size)
 		{
-			if (m_front_gap == 0)
-			{
-				recenter();
-				pos += m_front_gap;
-			}
-			pos = front_add_at(data_begin(), pos, [this](){ --m_front_gap; }, std::forward<ARGS>(args)...);
+			if (new_size > capacity())
+				reallocate(std::max<size_t>(new_size, traits.capacity));
+			add(new_size - old_size, std::forward<ARGS>(args)...);
 		}
-		return pos;
 	}
-	template<typename... ARGS>
-	inline void add_front(ARGS&&... args)
-	{
-		assert(size() < capacity());
-		assert(m_front_gap || m_back_gap);
 
-		if (m_front_gap == 0)
-			recenter();
-		new(data_begin() - 1) value_type(std::forward<ARGS>(args)...);
-		--m_front_gap;
-	}
-	template<typename... ARGS>
-	inline void add_back(ARGS&&... args)
+	template<execution_policy POLICY, typename... ARGS>
+	constexpr void resize(POLICY&& policy, size_type new_size, ARGS&&... args)
 	{
-		assert(size() < capacity());
-		assert(m_front_gap || m_back_gap);
+		auto old_size = size();
 
-		if (m_back_gap == 0)
-			recenter();
-		new(data_end()) value_type(std::forward<ARGS>(args)...);
-		--m_back_gap;
-	}
-	template<typename... ARGS>
-	inline void add(size_t count, ARGS&&... args)
-	{
-		// This is certainly not as optimized as it could be. The question is,
-		// how useful is resize for a middle location container?
-		while (count--)
-			add_back(std::forward<ARGS>(args)...);
+		if (new_size < old_size)
+			erase(policy, data_end() - (old_size - new_size), data_end());
+		else if (new_size > old_size)
+		{
+			if (new_size > capacity())
+				reallocate(std::max<size_t>(new_size, traits.capacity));
+			add(policy, new_size - old_size, std::forward<ARGS>(args)...);
+		}
 	}
 
-	inline void clear()
+	// The for_overwrite functions add default-initialized elements (so trivial types are left uninitialized)
+	// and return a span of them, so they can be filled in directly (e.g. by a read from a socket). The new
+	// elements of a CIRCULAR or SEGMENTED sequence might not be contiguous, so these are not available for them.
+
+	constexpr std::span<value_type> resize_for_overwrite(size_type new_size) requires (is_contiguous)
 	{
-		if (!empty())
+		auto old_size = size();
+
+		if (new_size <= old_size)
 		{
-			destroy_data(data_begin(), data_end());
-			m_front_gap = static_cast<size_type>(TRAITS.front_gap());
-			m_back_gap = static_cast<size_type>(TRAITS.capacity - m_front_gap);
+			resize(new_size);
+			return {};
 		}
+		if (new_size > capacity())
+			reallocate(std::max<size_t>(new_size, traits.capacity));
+		return append_for_overwrite(static_cast<size_type>(new_size - old_size));
 	}
-	inline void erase(value_type* erase_begin, value_type* erase_end)
+	constexpr std::span<value_type> append_for_overwrite(size_type count) requires (is_contiguous)
 	{
-		// If we are erasing nearer the back or dead center, erase at the back. Otherwise erase at the front.
-		if (erase_begin - data_begin() >= data_end() - erase_end)
-			back_erase(data_begin(), data_end(), erase_begin, erase_end,
-						[this](size_t count){ m_back_gap += static_cast<size_type>(count); });
-		else
-			front_erase(data_begin(), data_end(), erase_begin, erase_end,
-						[this](size_t count){ m_front_gap += static_cast<size_type>(count); });
+		return {insert_gap(data_end(), count, [=](iterator gap){ std::uninitialized_default_construct_n(gap, count); }), count};
 	}
-	inline void erase(value_type* element)
+	constexpr std::span<value_type> prepend_for_overwrite(size_type count) requires (is_contiguous)
 	{
-		// If we are erasing nearer the back or dead center, erase at the back. Otherwise erase at the front.
-		if (element - data_begin() >= data_end() - element)
-			back_erase(data_begin(), data_end(), element, [this](){ ++m_back_gap; });
-		else
-			front_erase(data_begin(), data_end(), element, [this](){ ++m_front_gap; });
+		return {insert_gap(data_begin(), count, [=](iterator gap){ std::uninitialized_default_construct_n(gap, count); }), count};
 	}
-	inline void pop_front()
-	{
-		assert(size());
 
-		auto dst = data_begin();
-		++m_front_gap;
-		dst->~value_type();
+	template< class... ARGS >
+	constexpr iterator emplace(const_iterator cpos, ARGS&&... args)
+	{
+		if (auto old_capacity = capacity(); size() == old_capacity)
+		{
+			size_t index = cpos - data_begin();
+			reallocate(grown_capacity());
+			cpos = data_begin() + index;
+		}
+		auto pos = add_at(to_iterator(cpos), std::forward<ARGS>(args)...);
+		stats::resized(size());
+		return pos;
 	}
-	inline void pop_back()
+	template<typename... ARGS>
+	constexpr void emplace_front(ARGS&&... args)
 	{
-		assert(size());
-
-		++m_back_gap;
-		data_end()->~value_type();
+		if (auto old_capacity = capacity(); size() == old_capacity)
+			reallocate(grown_capacity());
+		add_front(std::forward<ARGS>(args)...);
+		stats::resized(size());
 	}
-
-private:
-
-	// This function recenters the elements to prepare for size growth. If the remaining space is odd, then the
-	// extra space will be at the front if we are making space at the front, otherwise it will be at the back.
-	
-	inline void recenter()
+	template<typename... ARGS>
+	constexpr void emplace_back(ARGS&&... args)
 	{
-		auto [front_gap, back_gap] = ::recenter<inherited>(capacity_begin(), capacity_end(), data_begin(), data_end());
-		m_front_gap = static_cast<size_type>(front_gap);
-		m_back_gap = static_cast<size_type>(back_gap);
+		if (auto old_capacity = capacity(); size() == old_capacity)
+			reallocate(grown_capacity());
+		add_back(std::forward<ARGS>(args)...);
+		stats::resized(size());
 	}
 
-	// Empty sequences with odd capacity will have the extra space at the back.
-
-	size_type m_front_gap = static_cast<size_type>(TRAITS.front_gap());
-	size_type m_back_gap = static_cast<size_type>(TRAITS.capacity - TRAITS.front_gap());
-};
-#endif
-
-// ==============================================================================================================
-// dynamic_capacity
-
-template<typename T, sequence_traits TRAITS>
-class dynamic_capacity
-{
-	using value_type = T;
-	using pointer = value_type*;
-	using const_pointer = const value_type*;
+	constexpr iterator insert(const_iterator cpos, const_reference e)
+	{
+		// An in place emplace shifts the elements before constructing, and e may be one of them.
+		if constexpr (traits.in_place_emplace)
+			return emplace(cpos, value_type(e));
+		else
+			return emplace(cpos, e);
+	}
+	constexpr void push_front(const_reference e) { emplace_front(e); }
+	constexpr void push_back(const_reference e) { emplace_back(e); }
 
-public:
+	// The multiple element insert functions make room for all of the new elements at once: the capacity
+	// grows (at most) once and the existing elements are shifted (at most) once. This is only possible
+	// if the number of new elements is known up front, otherwise they are inserted one at a time.
 
-	inline dynamic_capacity() : m_capacity_end(nullptr) {}
-	inline dynamic_capacity(size_t cap) :
-		m_capacity_begin(operator new(sizeof(value_type) * cap))
+	constexpr iterator insert(const_iterator cpos, size_type count, const_reference e)
 	{
-		m_capacity_end = capacity_begin() + cap;
+		value_type temp(e);		// The element may be in this sequence, and it is about to move.
+		return insert_gap(cpos, count, [&](iterator gap){ uninitialized_construct_n(gap, count, temp); });
+	}
+	template<std::input_iterator IT>
+	constexpr iterator insert(const_iterator cpos, IT first, IT last)
+	{
+		if constexpr (std::forward_iterator<IT>)
+		{
+			auto count = static_cast<size_t>(std::distance(first, last));
+			return insert_gap(cpos, count, [&](iterator gap){ uninitialized_copy_data(first, last, gap); });
+		}
+		else
+		{
+			auto index = cpos - data_begin();
+			for (; first != last; ++first)
+				cpos = emplace(cpos, *first) + 1;
+			return data_begin() + index;
+		}
+	}
+	constexpr iterator insert(const_iterator cpos, std::initializer_list<value_type> il)
+	{
+		return insert(cpos, il.begin(), il.end());
 	}
-	dynamic_capacity(const dynamic_capacity&) = delete;
-	inline dynamic_capacity(dynamic_capacity&& rhs) = default;
-	dynamic_capacity& operator=(const dynamic_capacity&) = delete;
-	inline dynamic_capacity& operator=(dynamic_capacity&& rhs) = default;
 
-	inline size_t capacity() const { return capacity_end() - capacity_begin(); }
-	inline pointer capacity_begin() { return static_cast<pointer>(m_capacity_begin.get()); }
-	inline pointer capacity_end() { return m_capacity_end; }
-	inline const_pointer capacity_begin() const { return static_cast<const_pointer>(m_capacity_begin.get()); }
-	inline const_pointer capacity_end() const { return m_capacity_end; }
+	template<std::ranges::input_range R>
+	constexpr iterator insert_range(const_iterator cpos, R&& rg)
+	{
+		if constexpr (std::ranges::sized_range<R> || std::ranges::forward_range<R>)
+		{
+			auto count = static_cast<size_t>(std::ranges::distance(rg));
+			return insert_gap(cpos, count, [&](iterator gap)
+				{
+					if consteval
+					{
+						for (auto&& e : rg)
+							std::construct_at(std::addressof(*gap++), std::forward<decltype(e)>(e));
+					}
+					else
+					{
+						std::ranges::uninitialized_copy(std::ranges::begin(rg), std::ranges::end(rg), gap, gap + count);
+					}
+				});
+		}
+		else
+		{
+			auto index = cpos - data_begin();
+			for (auto&& e : rg)
+				cpos = emplace(cpos, std::forward<decltype(e)>(e)) + 1;
+			return data_begin() + index;
+		}
+	}
+	template<std::ranges::input_range R>
+	constexpr void append_range(R&& rg) { insert_range(data_end(), std::forward<R>(rg)); }
+	template<std::ranges::input_range R>
+	constexpr void prepend_range(R&& rg) { insert_range(data_begin(), std::forward<R>(rg)); }
 
-protected:
+	// Searches the elements. For contiguous sequences these work on the elements' memory directly (see find_data),
+	// which the library vectorizes for bytewise comparable types.
 
-	inline void swap(dynamic_capacity& rhs)
+	constexpr iterator find(const value_type& value)
 	{
-		std::swap(m_capacity_begin, rhs.m_capacity_begin);
-		std::swap(m_capacity_end, rhs.m_capacity_end);
+		if constexpr (is_contiguous)
+			return find_data(data_begin(), data_end(), value);
+		else
+			return std::find(begin(), end(), value);
 	}
-	inline void swap(dynamic_capacity&& rhs) { swap(rhs); }
-	inline void free()
+	constexpr const_iterator find(const value_type& value) const
 	{
-		m_capacity_begin.reset();
-		m_capacity_end = nullptr;
+		if constexpr (is_contiguous)
+			return find_data(data_begin(), data_end(), value);
+		else
+			return std::find(begin(), end(), value);
 	}
+	constexpr size_type count(const value_type& value) const
+	{
+		if constexpr (is_contiguous)
+			return static_cast<size_type>(std::count(data_begin(), data_end(), value));
+		else
+			return static_cast<size_type>(std::count(begin(), end(), value));
+	}
+	constexpr bool contains(const value_type& value) const { return find(value) != end(); }
 
-	using deleter_type = decltype([](void* p){ delete p; });
-	std::unique_ptr<void, deleter_type> m_capacity_begin;
-	pointer m_capacity_end;
-};
-
+	// Removes the elements for which 'pred' is true (or which equal 'value'), and returns how many were removed.
+	// This is done in one pass, compacting the kept elements toward the end the location keeps them at, or for
+	// MIDDLE and CIRCULAR toward whichever end shifts fewer of them (see remove_toward_front). 'pred' is called
+	// once for each element. erase_if and erase do the same for compatibility with the standard containers.
 
-// dynamic_sequence_storage - Helper class for sequence which provides the 3 different element management strategies
-// for dynamically allocated variable capacity sequences.
+	template<typename PRED>
+	constexpr size_type remove_if(PRED pred)
+	{
+		auto first = std::find_if(begin(), end(), std::ref(pred));
+		if (first == end())
+			return 0;
+		auto last = std::prev(end());
+		while (last != first && !pred(*last))
+			--last;
 
-template<sequence_location_lits LOC, typename T, sequence_traits TRAITS>
-class dynamic_sequence_storage
-{
-	static_assert(false, "An unimplemented specialization of variable_sequence_storage was instantiated.");
-};
+		auto test = [&pred](iterator element) { return static_cast<bool>(pred(*element)); };
+		return remove_between(first, last, test);
+	}
+	constexpr size_type remove(const value_type& value)
+	{
+		return remove_if([&value](const value_type& element) { return element == value; });
+	}
+	template<typename PRED>
+	friend constexpr size_type erase_if(sequence& seq, PRED pred) { return seq.remove_if(std::move(pred)); }
+	friend constexpr size_type erase(sequence& seq, const value_type& value) { return seq.remove(value); }
 
-template<typename T, sequence_traits TRAITS>
-class dynamic_sequence_storage<sequence_location_lits::FRONT, T, TRAITS> : public dynamic_capacity<T, TRAITS>
-{
-	using value_type = T;
-	using iterator = value_type*;
-	using inherited = dynamic_capacity<T, TRAITS>;
+	// Removes all but the first of each run of consecutive equal elements (as 'pred' decides), and returns how
+	// many were removed. This is also done in one pass, toward the same end remove_if would use.
 
-public:
+	template<typename PRED = std::equal_to<>>
+	constexpr size_type unique(PRED pred = {})
+	{
+		auto first = std::adjacent_find(begin(), end(), std::ref(pred));
+		if (first == end())
+			return 0;
+		auto last = std::prev(end());
+		while (last != first + 1 && !pred(*std::prev(last), *last))
+			--last;
 
-	using inherited::capacity;
-	using inherited::capacity_begin;
-	using inherited::capacity_end;
+		// Compacting toward the front moves the elements the following ones are compared to, so std::unique
+		// is used, which compares them to the last element kept instead.
+		auto test = [&pred](iterator element) { return static_cast<bool>(pred(*std::prev(element), *element)); };
+		if (toward_front(first + 1, last))
+		{
+			auto old_size = size();
+			auto new_end = std::unique(first, end(), std::ref(pred));
+			stats::erased(new_end - (first + 1));
+			erase(new_end, end());
+			return static_cast<size_type>(old_size - size());
+		}
+		return remove_between(first + 1, last, test);
+	}
 
-	inline dynamic_sequence_storage() = default;
-	inline dynamic_sequence_storage(std::initializer_list<value_type> il) :
-		inherited(il.size()),
-		m_data_end(std::uninitialized_copy(il.begin(), il.end(), capacity_begin()))
-	{}
-	inline dynamic_sequence_storage(size_t cap, fixed_sequence_storage<T, TRAITS>&& rhs) :
-		inherited(cap),
-		m_data_end(uninitialized_move_if_noexcept(rhs.data_begin(), rhs.data_end(), capacity_begin()))
-	{}
+	// Sequences compare their elements lexicographically (as the standard containers do). Contiguous sequences of
+	// bytewise comparable elements are compared with memcmp, or by finding the first difference with std::mismatch.
 
-	inline dynamic_sequence_storage(const dynamic_sequence_storage& rhs) :
-		inherited(rhs.size()),
-		m_data_end(std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), capacity_begin()))
-	{}
-	inline dynamic_sequence_storage(dynamic_sequence_storage&& rhs)
+	friend constexpr bool operator==(const sequence& lhs, const sequence& rhs) requires (std::equality_comparable<T>)
 	{
-		swap(rhs);
+		if (lhs.size() != rhs.size())
+			return false;
+		if constexpr (is_contiguous && bytewise_comparable<T>)
+		{
+			if !consteval
+			{
+				return lhs.empty() || std::memcmp(lhs.data_begin(), rhs.data_begin(), lhs.size() * sizeof(T)) == 0;
+			}
+		}
+		return std::equal(lhs.begin(), lhs.end(), rhs.begin());
 	}
-
-	inline dynamic_sequence_storage& operator=(const dynamic_sequence_storage& rhs)
+	friend constexpr auto operator<=>(const sequence& lhs, const sequence& rhs) requires (std::three_way_comparable<T>)
 	{
-		auto dst = data_begin();
-		auto src = rhs.data_begin();
-
-		if (rhs.size() > capacity())
+		if constexpr (is_contiguous && bytewise_comparable<T>)
 		{
-			destroy_data(dst, data_end());
-			inherited::swap(inherited(rhs.size()));
-			dst = data_begin();
+			auto [l, r] = std::mismatch(lhs.data_begin(), lhs.data_end(), rhs.data_begin(), rhs.data_end());
+			if (l != lhs.data_end() && r != rhs.data_end())
+				return *l <=> *r;
+			return lhs.size() <=> rhs.size();
 		}
 		else
-		{
-			while (src != rhs.data_end() && dst != data_end())
-				*dst++ = *src++;
-			destroy_data(dst, data_end());
-		}
-		m_data_end = std::uninitialized_copy(src, rhs.data_end(), dst);
-
-		return *this;
+			return std::lexicographical_compare_three_way(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
 	}
-	inline dynamic_sequence_storage& operator=(dynamic_sequence_storage&& rhs)
+
+	// Returns a hash of the elements (see std::hash below). Contiguous sequences of bytewise comparable elements
+	// are hashed as bytes, and the others combine the hashes of their elements.
+
+	constexpr size_t hash() const requires (is_contiguous && bytewise_comparable<T>)
 	{
-		swap(rhs);
-		return *this;
+		auto bytes = reinterpret_cast<const char*>(std::to_address(data_begin()));
+		return std::hash<std::string_view>()(std::string_view(bytes, size() * sizeof(T)));
 	}
-
-	inline ~dynamic_sequence_storage()
+	constexpr size_t hash() const requires (!(is_contiguous && bytewise_comparable<T>)) && requires (const T& e) { std::hash<T>()(e); }
 	{
-		destroy_data(data_begin(), data_end());
+		size_t seed = size();
+		for (const auto& e : *this)
+			seed ^= std::hash<T>()(e) + static_cast<size_t>(0x9e3779b97f4a7c15ull) + (seed << 6) + (seed >> 2);
+		return seed;
 	}
 
-	inline value_type* data_begin() { return capacity_begin(); }
-	inline value_type* data_end() { return m_data_end; }
-	inline const value_type* data_begin() const { return capacity_begin(); }
-	inline const value_type* data_end() const { return m_data_end; }
-	inline size_t size() const { return data_end() - data_begin(); }
-	inline bool empty() const { return m_data_end == capacity_begin(); }
+	// Serialization - Trivially copyable elements are written as a sequence_header followed by their bytes, and
+	// read straight back into place, with no per-element work. 'header' and 'byte_pieces' describe what would be
+	// written (the pieces are those of 'as_spans' or 'segments'), so that many sequences can be written by a
+	// single call (see write_pieces). 'read_from' replaces the elements with the ones read. It returns false if
+	// it is at the end of the file, and throws std::system_error if the file does not hold a sequence of this
+	// element type (or ends in the middle of one). The stream versions set failbit instead. If the elements
+	// are cut short the sequence is left empty.
 
-	inline void swap(dynamic_sequence_storage& rhs)
+	constexpr sequence_header header() const requires (is_serializable)
 	{
-		inherited::swap(rhs);
-		std::swap(m_data_end, rhs.m_data_end);
+		return { sequence_fingerprint<T>, size() };
 	}
-
-	inline void reallocate(size_t new_cap_size)
+	constexpr auto byte_pieces() const requires (is_serializable)
 	{
-		assert(size() <= new_cap_size);
-
-		auto old_begin = data_begin();
-		auto old_end = data_end();
-
-		inherited new_capacity(new_cap_size);
-		m_data_end = uninitialized_move_if_noexcept(old_begin, old_end, new_capacity.capacity_begin());
-		destroy_data(old_begin, old_end);
-		inherited::swap(new_capacity);
+		if constexpr (is_segmented)
+			return segments() | std::views::transform([](auto piece) { return std::as_bytes(piece); });
+		else
+		{
+			auto [first, second] = as_spans();
+			return std::array{ std::as_bytes(first), std::as_bytes(second) };
+		}
 	}
 
-	template<typename... ARGS>
-	inline iterator add_at(iterator pos, ARGS&&... args)
+#ifdef SEQUENCE_POSIX_IO
+	constexpr void write_to(int fd) const requires (is_serializable)
 	{
-		assert(size() < capacity());
-		assert(pos >= data_begin() && pos <= data_end());
+		auto head = header();
+		auto head_bytes = std::as_bytes(std::span(&head, 1));
 
-		if (size() == 0 || pos == data_end())
-			add_back(std::forward<ARGS>(args)...);
+		if constexpr (is_segmented)
+		{
+			std::vector pieces{ head_bytes };
+			std::ranges::copy(byte_pieces(), std::back_inserter(pieces));
+			write_pieces(fd, pieces);
+		}
 		else
-			pos = back_add_at(data_end(), pos, [this](){ ++m_data_end; }, std::forward<ARGS>(args)...);
-		return pos;
+		{
+			auto [first, second] = byte_pieces();
+			write_pieces(fd, std::array{ head_bytes, first, second });
+		}
 	}
-	template<typename... ARGS>
-	inline void add_front(ARGS&&... args)
+	constexpr bool read_from(int fd) requires (is_serializable)
 	{
-		add_at(data_begin(), std::forward<ARGS>(args)...);
+		sequence_header head;
+		auto head_bytes = std::as_writable_bytes(std::span(&head, 1));
+
+		auto read = io_pieces<true>(fd, std::span<const std::span<std::byte>>(&head_bytes, 1));
+		if (read == 0)
+			return false;
+		if (read < sizeof(head) || head.fingerprint != sequence_fingerprint<T> || head.size > inherited::max_size())
+			throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), READ_ERROR);
+
+		auto pieces = overwrite_pieces(static_cast<size_type>(head.size));
+		if (io_pieces<true>(fd, std::span<const std::span<std::byte>>(pieces)) < head.size * sizeof(T))
+		{
+			clear();
+			throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), READ_ERROR);
+		}
+		return true;
 	}
-	template<typename... ARGS>
-	inline void add_back(ARGS&&... args)
-	{
-		assert(size() < capacity());
+#endif
 
-		new(data_end()) value_type(std::forward<ARGS>(args)...);
-		++m_data_end;
+	constexpr std::ostream& write_to(std::ostream& out) const requires (is_serializable)
+	{
+		auto head = header();
+		out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+		for (auto piece : byte_pieces())
+			out.write(reinterpret_cast<const char*>(piece.data()), static_cast<std::streamsize>(piece.size()));
+		return out;
 	}
-	template<typename... ARGS>
-	inline void add(size_t count, ARGS&&... args)
+	constexpr std::istream& read_from(std::istream& in) requires (is_serializable)
 	{
-		while (count--)
-			add_back(std::forward<ARGS>(args)...);
+		sequence_header head;
+		if (!in.read(reinterpret_cast<char*>(&head), sizeof(head)))
+			return in;
+		if (head.fingerprint != sequence_fingerprint<T> || head.size > inherited::max_size())
+		{
+			in.setstate(std::ios::failbit);
+			return in;
+		}
+		for (auto piece : overwrite_pieces(static_cast<size_type>(head.size)))
+			if (!in.read(reinterpret_cast<char*>(piece.data()), static_cast<std::streamsize>(piece.size())))
+			{
+				clear();
+				break;
+			}
+		return in;
 	}
 
-	inline void pop_front()
-	{
-		assert(size());
+private:
 
-		erase(data_begin());
+	// Converts a const_iterator into this sequence to an iterator.
+
+	constexpr iterator to_iterator(const_iterator cpos) { return data_begin() + (cpos - data_begin()); }
+
+	// Clears the sequence and makes sure that the capacity will hold 'n' elements.
+
+	constexpr void clear_for(size_t n)
+	{
+		inherited::clear();
+		if (n > capacity())
+			reallocate(std::max<size_t>(n, traits.capacity));
 	}
-	inline void pop_back()
+
+	// Replaces the elements with 'n' elements which are about to be overwritten (see read_from), and returns their
+	// bytes as pieces. The capacity is sized once. The elements of contiguous sequences are left uninitialized,
+	// the others (whose new elements might not be contiguous) are value-initialized.
+
+	constexpr auto overwrite_pieces(size_type n)
 	{
-		assert(size());
+		clear_for(n);
+		if constexpr (is_contiguous)
+			return std::array{ std::as_writable_bytes(append_for_overwrite(n)) };
+		else
+		{
+			resize(n);
+			if constexpr (is_segmented)
+			{
+				std::vector<std::span<std::byte>> pieces;
+				for (auto piece : segments())
+					pieces.push_back(std::as_writable_bytes(piece));
+				return pieces;
+			}
+			else
+			{
+				auto [first, second] = as_spans();
+				return std::array{ std::as_writable_bytes(first), std::as_writable_bytes(second) };
+			}
+		}
+	}
 
-		--m_data_end;
-		data_end()->~value_type();
+	// Reallocates the capacity (see sequence_storage), recording what it took if the traits ask for statistics.
+
+	constexpr void reallocate(size_t new_capacity)
+	{
+		typename stats::timer timer;
+		[[maybe_unused]] auto before = capacity_state();
+		inherited::reallocate(new_capacity);
+		record_reallocation(before);
 	}
-	inline void erase(value_type* erase_begin, value_type* erase_end)
+	constexpr iterator reallocate(size_t new_capacity, iterator pos, size_t count)
 	{
-		back_erase(data_begin(), data_end(), erase_begin, erase_end,
-				   [this](size_t count){ m_data_end -= count; });
+		typename stats::timer timer;
+		[[maybe_unused]] auto before = capacity_state();
+		pos = inherited::reallocate(new_capacity, pos, count);
+		record_reallocation(before);
+		return pos;
 	}
-	inline void erase(value_type* element)
+
+	// The state recorded around a reallocation. The elements have been relocated if the first one has moved
+	// (the elements of a SEGMENTED sequence never are).
+
+	struct capacity_state_type
+	{
+		size_t size;
+		size_t capacity;
+		bool dynamic;
+		const value_type* front;
+	};
+	constexpr auto capacity_state() const
 	{
-		back_erase(data_begin(), data_end(), element, [this](){ --m_data_end; });
+		if constexpr (stats::enabled)
+			return capacity_state_type{size(), capacity(), inherited::is_dynamic(),
+				is_segmented || empty() ? nullptr : std::addressof(front())};
+		else
+			return 0;
 	}
-	inline void clear()
+	constexpr void record_reallocation([[maybe_unused]] const auto& before) const
 	{
-		if (!empty())
+		if constexpr (stats::enabled)
 		{
-			destroy_data(data_begin(), data_end());
-			m_data_end = capacity_begin();
+			auto after = capacity_state();
+			if (after.capacity == before.capacity && after.front == before.front && after.dynamic == before.dynamic)
+				return;
+
+			stats::reallocated(after.front != before.front ? before.size : 0, after.capacity);
+			if (after.dynamic != before.dynamic)
+				stats::rebuffered(after.dynamic);
+			if (after.dynamic && after.capacity && (after.capacity != before.capacity || !before.dynamic))
+			{
+				if constexpr (is_segmented)
+				{
+					if (after.capacity > before.capacity)
+						stats::allocated((after.capacity - before.capacity) * sizeof(value_type));
+				}
+				else
+					stats::allocated(after.capacity * sizeof(value_type));
+			}
 		}
 	}
-	inline void free()
-	{
-		if (!empty())
-			destroy_data(data_begin(), data_end());
-		inherited::free();
-		m_data_end = nullptr;
-	}
 
-private:
+	// Decides which way remove_if and unique compact the elements when the first and last elements to remove are
+	// 'first' and 'last': toward the front unless that shifts more elements than compacting toward the back would.
 
-	value_type* m_data_end = nullptr;
-};
+	constexpr bool toward_front(iterator first, iterator last)
+	{
+		if constexpr (traits.location == sequence_location_lits::FRONT)
+			return true;
+		else if constexpr (traits.location == sequence_location_lits::BACK)
+			return false;
+		else
+			return end() - (first + 1) <= last - begin();
+	}
 
-template<typename T, sequence_traits TRAITS>
-class dynamic_sequence_storage<sequence_location_lits::BACK, T, TRAITS> : public dynamic_capacity<T, TRAITS>
-{
-	using value_type = T;
-	using iterator = value_type*;
-	using inherited = dynamic_capacity<T, TRAITS>;
+	// Removes the elements 'first', 'last' and those between them which 'test' picks (see remove_toward_front),
+	// and returns how many were removed.
 
-public:
+	template<typename TEST>
+	constexpr size_type remove_between(iterator first, iterator last, TEST& test)
+	{
+		auto old_size = size();
+		if (toward_front(first, last))
+		{
+			auto new_end = remove_toward_front(first, last, end(), test);
+			stats::erased(new_end - first);
+			erase(new_end, end());
+		}
+		else
+		{
+			auto new_begin = remove_toward_back(begin(), first, last, test);
+			stats::erased((last + 1) - new_begin);
+			erase(begin(), new_begin);
+		}
+		return static_cast<size_type>(old_size - size());
+	}
 
-	using inherited::capacity;
-	using inherited::capacity_begin;
-	using inherited::capacity_end;
+	// Records the elements an erase shifts, which are on the side(s) the location allows (the shorter side
+	// where there is a choice).
 
-	inline dynamic_sequence_storage() = default;
-	inline dynamic_sequence_storage(std::initializer_list<value_type> il) : inherited(il.size())
+	constexpr void record_erase([[maybe_unused]] size_t before, [[maybe_unused]] size_t after) const
 	{
-		std::uninitialized_copy(il.begin(), il.end(), capacity_begin());
-		m_data_begin = capacity_begin();
+		if constexpr (traits.location == sequence_location_lits::FRONT)
+			stats::erased(after);
+		else if constexpr (traits.location == sequence_location_lits::BACK)
+			stats::erased(before);
+		else
+			stats::erased(std::min(before, after));
 	}
 
-	inline dynamic_sequence_storage(const dynamic_sequence_storage& rhs) : inherited(rhs.size())
+	// Returns the capacity to grow to when the capacity is exceeded, which is at least 'new_size'. If the traits
+	// ask for it, this is rounded up to fill the allocator size class the new capacity will come from.
+	// A CUSTOM growth policy refuses to grow by not returning a larger capacity.
+
+	constexpr size_t grown_capacity(size_t new_size = 0) const
 	{
-		m_data_begin = capacity_begin();
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), m_data_begin);
+		auto grown = traits.grow(capacity(), sizeof(value_type));
+		if constexpr (traits.growth == sequence_growth_lits::CUSTOM)
+			if (grown <= capacity())
+				throw std::bad_alloc();
+		auto new_capacity = std::max<size_t>(grown, new_size);
+		if constexpr (traits.size_classes)
+			new_capacity = size_class(new_capacity * sizeof(value_type)) / sizeof(value_type);
+		return new_capacity;
 	}
-	inline dynamic_sequence_storage(dynamic_sequence_storage&& rhs)
+
+	// Opens an uninitialized gap of 'count' elements at 'cpos', reallocating if necessary, and calls 'fill'
+	// to construct the new elements in it. If 'fill' throws it must destroy anything it constructed
+	// (as the uninitialized memory algorithms do); the gap is then closed again.
+
+	template<typename FUNC>
+	constexpr iterator insert_gap(const_iterator cpos, size_t count, FUNC fill)
 	{
-		swap(rhs);
+		auto pos = to_iterator(cpos);
+		if (count == 0)
+			return pos;
+
+		if (auto new_size = size() + count; new_size > capacity())
+			pos = reallocate(grown_capacity(new_size), pos, count);
+		else
+			pos = open_gap(pos, count);
+
+		try
+		{
+			fill(pos);
+		}
+		catch (...)
+		{
+			close_gap(pos, count);
+			throw;
+		}
+		stats::resized(size());
+		return pos;
 	}
 
-	inline dynamic_sequence_storage& operator=(const dynamic_sequence_storage& rhs)
+	// Appends 'count' elements constructed from 'args' in a single operation: room is made for all of them
+	// at once and they are constructed directly in their final location (see insert_gap).
+
+	template<typename... ARGS>
+	constexpr void add(size_t count, ARGS&&... args)
 	{
-		clear();
-		if (rhs.size() > capacity())
-			inherited::swap(inherited(rhs.size()));
-		auto begin = capacity_end() - rhs.size();
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), begin);
-		m_data_begin = begin;
-		return *this;
+		insert_gap(data_end(), count, [&](iterator gap){ uninitialized_construct_n(gap, count, args...); });
 	}
-	inline dynamic_sequence_storage& operator=(dynamic_sequence_storage&& rhs)
+	template<execution_policy POLICY, typename... ARGS>
+	constexpr void add(POLICY&& policy, size_t count, ARGS&&... args)
 	{
-		clear();
-		swap(rhs);
-		return *this;
+		if constexpr (is_contiguous)
+		{
+			if (count >= traits.parallel_threshold)
+			{
+				insert_gap(data_end(), count, [&](iterator gap)
+				{
+					parallel_construct(policy, gap, count, [&](size_t first, size_t last)
+					{
+						uninitialized_construct_n(gap + first, last - first, args...);
+					});
+				});
+				return;
+			}
+		}
+		add(count, std::forward<ARGS>(args)...);
 	}
 
-	inline ~dynamic_sequence_storage()
+	// Erases [erase_begin, erase_end) at the front or back of the elements, destroying them in parallel if there
+	// are enough of them (see parallel_destroy). The gap they leave is then closed without shifting anything.
+
+	template<execution_policy POLICY>
+	constexpr void erase(POLICY&& policy, iterator erase_begin, iterator erase_end)
 	{
-		destroy_data(data_begin(), data_end());
+		if constexpr (is_contiguous)
+		{
+			assert(erase_begin == data_begin() || erase_end == data_end());
+			if (size_t count = erase_end - erase_begin; count >= traits.parallel_threshold)
+			{
+				parallel_destroy(policy, erase_begin, erase_end);
+				close_gap(erase_begin, count);
+				return;
+			}
+		}
+		erase(erase_begin, erase_end);
 	}
 
-	inline value_type* data_begin() { return m_data_begin; }
-	inline value_type* data_end() { return capacity_end(); }
-	inline const value_type* data_begin() const { return m_data_begin; }
-	inline const value_type* data_end() const { return capacity_end(); }
-	inline size_t size() const { return data_end() - data_begin(); }
-	inline bool empty() const { return m_data_begin == capacity_end(); }
+	static constexpr auto OUT_OF_RANGE_ERROR = "invalid sequence index {}";
+	static constexpr auto READ_ERROR = "invalid serialized sequence";
+};
+
+// std::hash - Lets sequences be the keys of unordered containers (see sequence::hash).
 
-	inline void swap(dynamic_sequence_storage& rhs)
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+	requires requires (const sequence<T, TRAITS, ALLOC>& seq) { seq.hash(); }
+struct std::hash<sequence<T, TRAITS, ALLOC>>
+{
+	inline size_t operator()(const sequence<T, TRAITS, ALLOC>& seq) const noexcept
 	{
-		inherited::swap(rhs);
-		std::swap(m_data_begin, rhs.m_data_begin);
+		return seq.hash();
 	}
+};
 
-	inline void reallocate(size_t new_cap)
-	{
-		assert(size() <= new_cap);
+// pmr::sequence - Convenience alias for sequences which get their memory from a std::pmr::memory_resource
+// (such as an arena or a monotonic buffer).
 
-		auto current_size = size();
+export namespace pmr {
 
-		inherited new_capacity(new_cap);
-		std::uninitialized_move(data_begin(), data_end(), new_capacity.capacity_end() - current_size);
-		destroy_data(data_begin(), data_end());
-		inherited::swap(new_capacity);
+template<typename T, sequence_traits TRAITS = sequence_traits<size_t>()>
+using sequence = ::sequence<T, TRAITS, std::pmr::polymorphic_allocator<T>>;
 
-		m_data_begin = capacity_end() - current_size;
-	}
+}
 
-	template<typename... ARGS>
-	inline iterator add_at(value_type* pos, ARGS&&... args)
-	{
-		assert(size() < capacity());
-		assert(pos >= data_begin() && pos <= data_end());
+// realloc_allocator - Allocator which gets its memory from malloc and provides the 'reallocate' extension
+// (see dynamic_capacity) using realloc. This lets VARIABLE and BUFFERED sequences of trivially relocatable
+// elements grow in place when possible (for large blocks most C libraries grow the mapping with mremap).
 
-		if (size() == 0 || pos == data_begin())
-			add_front(std::forward<ARGS>(args)...);
-		else
-			pos = front_add_at(data_begin(), pos, [this](){ --m_data_begin; }, std::forward<ARGS>(args)...);
-		return pos;
-	}
-	template<typename... ARGS>
-	inline void add_front(ARGS&&... args)
-	{
-		assert(size() < capacity());
+export template<typename T>
+struct realloc_allocator
+{
+	static_assert(alignof(T) <= alignof(std::max_align_t), "malloc cannot allocate over-aligned types.");
 
-		new(data_begin() - 1) value_type(std::forward<ARGS>(args)...);
-		--m_data_begin;
-	}
-	template<typename... ARGS>
-	inline void add_back(ARGS&&... args)
+	using value_type = T;
+	using is_always_equal = std::true_type;
+
+	realloc_allocator() = default;
+	template<typename U>
+	constexpr realloc_allocator(const realloc_allocator<U>&) noexcept {}
+
+	inline T* allocate(size_t n)
 	{
-		add_at(data_end(), std::forward<ARGS>(args)...);
+		if (n > std::numeric_limits<size_t>::max() / sizeof(T))
+			throw std::bad_array_new_length();
+		if (auto p = static_cast<T*>(std::malloc(n * sizeof(T))))
+			return p;
+		throw std::bad_alloc();
 	}
-	template<typename... ARGS>
-	inline void add(size_t count, ARGS&&... args)
+	inline void deallocate(T* p, size_t) noexcept { std::free(p); }
+
+	// Returns nullptr (leaving 'p' allocated) if the block cannot be resized.
+	inline T* reallocate(T* p, size_t, size_t n) noexcept
 	{
-		while (count--)
-			add_front(std::forward<ARGS>(args)...);
+		return n <= std::numeric_limits<size_t>::max() / sizeof(T) ? static_cast<T*>(std::realloc(p, n * sizeof(T))) : nullptr;
 	}
 
-	inline void pop_front()
+	template<typename U>
+	friend constexpr bool operator==(const realloc_allocator&, const realloc_allocator<U>&) noexcept { return true; }
+};
+
+// pool_allocator - Allocator which provides single objects from a per-thread free list of equally sized blocks
+// and anything else from operator new. FIXED storage allocates each capacity as a single object of the same type
+// (see sequence_storage<FIXED>), so with this allocator creating and destroying FIXED sequences does not go to the
+// general-purpose allocator, and capacities allocated one after the other are neighbors in memory. The blocks
+// are carved out of slabs of about 64 KiB. Each thread has its own pools (one for each block size and alignment),
+// and a block always goes back to the pool it came from: a block freed by its own thread joins the free list, and
+// one freed by another thread is pushed on the owning pool's remote list (lock-free), which the owner takes back
+// when its free list runs out. The slabs are kept for reuse while the thread runs, and are released once it has
+// exited and all of their blocks have been freed. 'reserve' fills the calling thread's pool ahead of time (see
+// sequence::preallocate).
+
+// Data written by different threads is kept in separate cache lines so that they do not interfere.
+
+#ifdef __cpp_lib_hardware_interference_size
+constexpr size_t cache_line_size = std::hardware_destructive_interference_size;
+#else
+constexpr size_t cache_line_size = 64;
+#endif
+
+template<size_t SIZE, size_t ALIGN>
+class block_pool
+{
+	// Each block records its pool, after the bytes handed out (so that they start at the block).
+	struct block
 	{
-		assert(size());
+		union
+		{
+			block* next;
+			alignas(ALIGN) unsigned char bytes[SIZE];
+		};
+		block_pool* owner;
+	};
 
-		auto dst = data_begin();
-		++m_data_begin;
-		dst->~value_type();
-	}
-	inline void pop_back()
+	static constexpr size_t slab_size = std::max<size_t>(65536 / sizeof(block), 1);
+	static constexpr size_t slab_header = (sizeof(void*) + alignof(block) - 1) / alignof(block) * alignof(block);
+
+	// The pool of a thread is owned by a thread_local holder, which lets it go when the thread exits (see orphan).
+	struct holder
 	{
-		assert(size());
+		block_pool* pool = s_local = new block_pool;
+		~holder() { s_local = nullptr; pool->orphan(); }
+	};
 
-		erase(data_end() - 1);
-	}
-	inline void erase(value_type* erase_begin, value_type* erase_end)
+public:
+
+	static inline block_pool& local()
 	{
-		front_erase(data_begin(), data_end(), erase_begin, erase_end,
-					[this](size_t count){ m_data_begin += count; });
+		thread_local holder pool;
+		return *pool.pool;
 	}
-	inline void erase(value_type* element)
+
+	inline void* take()
 	{
-		front_erase(data_begin(), data_end(), element, [this](){ ++m_data_begin; });
+		if (!m_free && !reclaim())
+			add_slab(slab_size);
+		--m_available;
+		++m_taken;
+		return std::exchange(m_free, m_free->next);
 	}
-	inline void clear()
+	static inline void give(void* p) noexcept
 	{
-		if (!empty())
+		auto b = static_cast<block*>(p);
+		if (b->owner == s_local)
 		{
-			destroy_data(data_begin(), data_end());
-			m_data_begin = capacity_end();
+			b->owner->push(b);
+			--b->owner->m_taken;
 		}
+		else
+			b->owner->give_remote(b);
 	}
-	inline void free()
+	inline void reserve(size_t count)
 	{
-		if (!empty())
-			destroy_data(data_begin(), data_end());
-		inherited::free();
-		m_data_begin = nullptr;
+		if (count > m_available)
+			reclaim();
+		if (count > m_available)
+			add_slab(std::max(count - m_available, slab_size));
 	}
 
 private:
 
-	value_type* m_data_begin = nullptr;
-};
-
-template<typename T, sequence_traits TRAITS>
-class dynamic_sequence_storage<sequence_location_lits::MIDDLE, T, TRAITS> : public dynamic_capacity<T, TRAITS>
-{
-	using value_type = T;
-	using iterator = value_type*;
-	using inherited = dynamic_capacity<T, TRAITS>;
-
-public:
-
-	using inherited::capacity;
-	using inherited::capacity_begin;
-	using inherited::capacity_end;
-
-	inline dynamic_sequence_storage() = default;
-	inline dynamic_sequence_storage(std::initializer_list<value_type> il) : inherited(il.size())
+	block_pool() = default;
+	~block_pool()
 	{
-		std::uninitialized_copy(il.begin(), il.end(), capacity_begin());
-		m_data_begin = capacity_begin();
-		m_data_end = capacity_end();
+		while (m_slabs)
+		{
+			auto slab = m_slabs;
+			m_slabs = *static_cast<void**>(slab);
+			::operator delete(slab, std::align_val_t(alignof(block)));
+		}
 	}
 
-	inline dynamic_sequence_storage(const dynamic_sequence_storage& rhs) : inherited(rhs.size())
+	inline void push(block* b) noexcept
 	{
-		m_data_begin = capacity_begin();
-		m_data_end = capacity_end();
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), m_data_begin);
+		b->next = m_free;
+		m_free = b;
+		++m_available;
 	}
-	inline dynamic_sequence_storage(dynamic_sequence_storage&& rhs)
+
+	// The blocks of a slab are linked in address order, so that they are handed out in that order. The slabs are
+	// linked through a header in front of their blocks.
+	inline void add_slab(size_t count)
 	{
-		swap(rhs);
+		auto slab = static_cast<unsigned char*>(::operator new(slab_header + count * sizeof(block), std::align_val_t(alignof(block))));
+		new(slab) void*(m_slabs);
+		m_slabs = slab;
+		auto blocks = reinterpret_cast<block*>(slab + slab_header);
+		for (auto b = blocks + count; b != blocks;)
+		{
+			(--b)->owner = this;
+			push(b);
+		}
 	}
 
-	inline dynamic_sequence_storage& operator=(const dynamic_sequence_storage& rhs)
+	// Blocks freed by other threads are pushed on the remote list, and counted in 'm_pending', which is the
+	// negative of the number of them until the owner exits (see orphan).
+	inline void give_remote(block* b) noexcept
 	{
-		clear();
-		if (rhs.size() > capacity())
-			inherited::swap(inherited(rhs.size()));
-		auto begin = capacity_begin() + TRAITS.front_gap(capacity(), rhs.size());
-		std::uninitialized_copy(rhs.data_begin(), rhs.data_end(), begin);
-		m_data_begin = begin;
-		m_data_end = m_data_begin + rhs.size();
-		return *this;
+		b->next = m_remote.load(std::memory_order_relaxed);
+		while (!m_remote.compare_exchange_weak(b->next, b, std::memory_order_release, std::memory_order_relaxed));
+		if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete this;
 	}
-	inline dynamic_sequence_storage& operator=(dynamic_sequence_storage&& rhs)
+
+	// Takes back the blocks freed by other threads. Returns false if there were none.
+	inline bool reclaim() noexcept
 	{
-		clear();
-		swap(rhs);
-		return *this;
+		auto b = m_remote.exchange(nullptr, std::memory_order_acquire);
+		if (!b)
+			return false;
+		while (b)
+			push(std::exchange(b, b->next));
+		return true;
 	}
 
-	inline ~dynamic_sequence_storage()
+	// Called when the owning thread exits. 'm_taken' counts the blocks taken less those given back by this thread,
+	// so adding it to 'm_pending' leaves the number of blocks still in use, and the pool is deleted (releasing its
+	// slabs) when that reaches zero, either here or when the last of them is given back.
+	inline void orphan() noexcept
 	{
-		destroy_data(data_begin(), data_end());
+		auto taken = static_cast<std::ptrdiff_t>(m_taken);
+		if (m_pending.fetch_add(taken, std::memory_order_acq_rel) + taken == 0)
+			delete this;
 	}
 
-	inline value_type* data_begin() { return m_data_begin; }
-	inline value_type* data_end() { return m_data_end; }
-	inline const value_type* data_begin() const { return m_data_begin; }
-	inline const value_type* data_end() const { return m_data_end; }
-	inline size_t size() const { return m_data_end - m_data_begin; }
-	inline bool empty() const { return m_data_end == m_data_begin; }
+	static inline thread_local block_pool* s_local = nullptr;
 
-	inline void swap(dynamic_sequence_storage& rhs)
+	block* m_free = nullptr;
+	size_t m_available = 0;
+	size_t m_taken = 0;
+	void* m_slabs = nullptr;
+	alignas(cache_line_size) std::atomic<block*> m_remote = nullptr;
+	std::atomic<std::ptrdiff_t> m_pending = 0;
+};
+
+export template<typename T>
+struct pool_allocator
+{
+	using value_type = T;
+	using is_always_equal = std::true_type;
+
+	pool_allocator() = default;
+	template<typename U>
+	constexpr pool_allocator(const pool_allocator<U>&) noexcept {}
+
+	inline T* allocate(size_t n)
 	{
-		inherited::swap(rhs);
-		std::swap(m_data_begin, rhs.m_data_begin);
-		std::swap(m_data_end, rhs.m_data_end);
+		if (n == 1)
+			return static_cast<T*>(pool().take());
+		return std::allocator<T>().allocate(n);
 	}
-
-	inline void reallocate(size_t new_cap)
+	inline void deallocate(T* p, size_t n) noexcept
 	{
-		assert(size() <= new_cap);
+		if (n == 1)
+			block_pool<sizeof(T), alignof(T)>::give(p);
+		else
+			std::allocator<T>().deallocate(p, n);
+	}
 
-		auto current_size = size();
-		auto offset = TRAITS.front_gap(new_cap, current_size);
+	// Makes sure that the calling thread can allocate 'count' single objects without allocating a slab.
+	static inline void reserve(size_t count) { pool().reserve(count); }
 
-		inherited new_capacity(new_cap);
-		std::uninitialized_move(data_begin(), data_end(), new_capacity.capacity_begin() + offset);
-		destroy_data(data_begin(), data_end());
-		inherited::swap(new_capacity);
+	template<typename U>
+	friend constexpr bool operator==(const pool_allocator&, const pool_allocator<U>&) noexcept { return true; }
 
-		m_data_begin = capacity_begin() + offset;
-		m_data_end = m_data_begin + current_size;
-	}
+private:
 
-	template<typename... ARGS>
-	inline iterator add_at(iterator pos, ARGS&&... args)
+	static inline auto& pool() { return block_pool<sizeof(T), alignof(T)>::local(); }
+};
+
+#ifdef SEQUENCE_MAPPED_STORAGE
+
+// mapped_allocator - Allocator which gets its memory from memory mappings rather than the heap. This is the
+// allocator used by MAPPED storage (see mapped_sequence). A default-constructed allocator maps anonymous memory,
+// for which transparent huge pages may be requested. An allocator constructed with a path maps that file, so the
+// elements of a MAPPED sequence persist in it and are mapped straight back in (with no deserialization) by the
+// next sequence constructed with an allocator for the file. The pages of the file are only read when they are
+// first touched. The mapping is resized with ftruncate and mremap (the 'reallocate' extension, see
+// dynamic_capacity), so it grows without copying. Copies of an allocator share its file, which can only be
+// mapped once at a time (allocating a second mapping throws std::bad_alloc), so copies of a sequence get an
+// anonymous allocator (see select_on_container_copy_construction).
+
+export template<typename T>
+class mapped_allocator
+{
+	template<typename U>
+	friend class mapped_allocator;
+
+	// The mapping source is shared by the copies (and rebinds) of an allocator.
+
+	struct source
 	{
-		assert(size() < capacity());
-		assert(pos >= data_begin() && pos <= data_end());
+		int fd = -1;					// The mapped file, or -1 for anonymous memory.
+		bool huge_pages = false;		// True if anonymous memory should use transparent huge pages.
+		bool mapped = false;			// True if the file is currently mapped.
 
-		auto dbeg = data_begin();
-		auto dend = data_end();
+		~source() { if (fd >= 0) ::close(fd); }
+	};
 
-		if (size() == 0 || pos == dend)
-			add_back(std::forward<ARGS>(args)...);
-		else if (pos == dbeg)
-			add_front(std::forward<ARGS>(args)...);
+public:
 
-		else if (pos - dbeg >= dend - pos)			// Inserting closer to the end--add at back.
-		{
-			if (m_data_end == capacity_end())
-			{
-				recenter();
-				pos -= capacity_end() - m_data_end;
-			}
-			pos = back_add_at(data_end(), pos, [this](){ ++m_data_end; }, std::forward<ARGS>(args)...);
-		}
-		else										// Inserting closer to the beginning--add at front.
-		{
-			if (m_data_begin == capacity_begin())
-			{
-				recenter();
-				pos += m_data_begin - capacity_begin();
-			}
-			pos = front_add_at(data_begin(), pos, [this](){ --m_data_begin; }, std::forward<ARGS>(args)...);
-		}
-		return pos;
+	using value_type = T;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	inline mapped_allocator() : mapped_allocator(mapped_pages_lits::NORMAL) {}
+	inline explicit mapped_allocator(mapped_pages_lits pages) : m_source(std::make_shared<source>())
+	{
+		m_source->huge_pages = pages == mapped_pages_lits::HUGE_PAGES;
 	}
-	template<typename... ARGS>
-	inline void add_front(ARGS&&... args)
+	inline explicit mapped_allocator(const char* path) : m_source(std::make_shared<source>())
 	{
-		assert(size() < capacity());
-		assert(m_data_begin > capacity_begin() || m_data_end < capacity_end());
-
-		if (m_data_begin == capacity_begin())
-			recenter();
-		new(m_data_begin - 1) value_type(std::forward<ARGS>(args)...);
-		--m_data_begin;
+		m_source->fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (m_source->fd < 0)
+			throw std::system_error(errno, std::generic_category(), path);
 	}
-	template<typename... ARGS>
-	inline void add_back(ARGS&&... args)
+	// Moving copies, so that a moved-from sequence is still able to allocate.
+	inline mapped_allocator(const mapped_allocator&) = default;
+	template<typename U>
+	inline mapped_allocator(const mapped_allocator<U>& rhs) noexcept : m_source(rhs.m_source) {}
+	inline mapped_allocator& operator=(const mapped_allocator&) = default;
+
+	inline mapped_allocator select_on_container_copy_construction() const
 	{
-		assert(size() < capacity());
-		assert(m_data_begin > capacity_begin() || m_data_end < capacity_end());
+		return mapped_allocator(m_source->huge_pages ? mapped_pages_lits::HUGE_PAGES : mapped_pages_lits::NORMAL);
+	}
 
-		if (m_data_end == capacity_end())
-			recenter();
-		new(m_data_end) value_type(std::forward<ARGS>(args)...);
-		++m_data_end;
+	inline bool is_file_backed() const { return m_source->fd >= 0; }
+
+	inline T* allocate(size_t n)
+	{
+		if (n > std::numeric_limits<size_t>::max() / sizeof(T))
+			throw std::bad_array_new_length();
+		if (is_file_backed() && (m_source->mapped || ::ftruncate(m_source->fd, n * sizeof(T)) != 0))
+			throw std::bad_alloc();
+		return map(n);
 	}
-	template<typename... ARGS>
-	inline void add(size_t count, ARGS&&... args)
+	inline void deallocate(T* p, size_t n) noexcept
 	{
-		// This is certainly not as optimized as it could be. The question is,
-		// how useful is resize for a middle location container?
-		while (count--)
-			add_back(std::forward<ARGS>(args)...);
+		::munmap(p, mapping_size(n));
+		m_source->mapped = false;
 	}
 
-	inline void pop_front()
+	// Returns nullptr (leaving 'p' mapped) if the mapping cannot be resized. Without mremap a file mapping
+	// is replaced by a new one (the elements are in the file), but anonymous memory cannot be resized.
+	inline T* reallocate(T* p, size_t old_n, size_t n) noexcept
 	{
-		assert(size());
-
-		data_begin()->~value_type();
-		++m_data_begin;
+		if (n > std::numeric_limits<size_t>::max() / sizeof(T))
+			return nullptr;
+		if (is_file_backed() && n > old_n && ::ftruncate(m_source->fd, n * sizeof(T)) != 0)
+			return nullptr;
+#ifdef MREMAP_MAYMOVE
+		auto q = ::mremap(p, mapping_size(old_n), mapping_size(n), MREMAP_MAYMOVE);
+#else
+		auto q = is_file_backed() ?
+			::mmap(nullptr, mapping_size(n), PROT_READ | PROT_WRITE, MAP_SHARED, m_source->fd, 0) : MAP_FAILED;
+		if (q != MAP_FAILED)
+			::munmap(p, mapping_size(old_n));
+#endif
+		if (q == MAP_FAILED)
+			return nullptr;
+		if (is_file_backed() && n < old_n)
+			::ftruncate(m_source->fd, n * sizeof(T));
+		return static_cast<T*>(q);
 	}
-	inline void pop_back()
+
+	// Maps the elements already in the file and returns them as a buffer for a sequence to adopt. The buffer is
+	// empty for anonymous memory and for an empty file.
+	inline sequence_buffer<T> contents() const
 	{
-		assert(size());
+		if (!is_file_backed())
+			return {};
+		if (m_source->mapped)
+			throw std::bad_alloc();
 
-		(data_end() - 1)->~value_type();
-		--m_data_end;
+		struct stat status;
+		if (::fstat(m_source->fd, &status) != 0)
+			throw std::system_error(errno, std::generic_category());
+		if (auto n = static_cast<size_t>(status.st_size) / sizeof(T))
+		{
+			auto p = map(n);
+			return {p, n, p, p + n};
+		}
+		return {};
 	}
-	inline void erase(value_type* erase_begin, value_type* erase_end)
+
+	// Cuts the file down to 'n' elements once it is no longer mapped (see the MAPPED sequence_storage).
+	inline void persist(size_t n) const
 	{
-		// If we are erasing nearer the back or dead center, erase at the back. Otherwise erase at the front.
-		if (erase_begin - data_begin() >= data_end() - erase_end)
-			back_erase(data_begin(), data_end(), erase_begin, erase_end,
-						[this](size_t count){ m_data_end -= count; });
-		else
-			front_erase(data_begin(), data_end(), erase_begin, erase_end,
-						[this](size_t count){ m_data_begin += count; });
+		if (is_file_backed())
+			::ftruncate(m_source->fd, n * sizeof(T));
 	}
-	inline void erase(value_type* element)
+
+	// Writes the modified pages holding [p, p + n) back to the file, and waits for them to be written.
+	inline void sync(const T* p, size_t n) const
 	{
-		// If we are erasing nearer the back or dead center, erase at the back. Otherwise erase at the front.
-		if (element - data_begin() >= data_end() - element)
-			back_erase(data_begin(), data_end(), element, [this](){ --m_data_end; });
-		else
-			front_erase(data_begin(), data_end(), element, [this](){ ++m_data_begin; });
+		if (is_file_backed() && n)
+		{
+			auto [begin, length] = pages(p, n);
+			if (::msync(begin, length, MS_SYNC) != 0)
+				throw std::system_error(errno, std::generic_category());
+		}
 	}
-	inline void clear()
+
+	// Tells the kernel how the pages holding [p, p + n) will be accessed. This is only a hint, so it cannot fail.
+	inline void advise(const T* p, size_t n, mapped_advice_lits advice) const noexcept
 	{
-		if (!empty())
+		if (n)
 		{
-			destroy_data(data_begin(), data_end());
-			m_data_begin = capacity_begin() + TRAITS.front_gap(capacity(), 0);
-			m_data_end = m_data_begin;
+			auto [begin, length] = pages(p, n);
+			switch (advice)
+			{
+				default:
+				case mapped_advice_lits::NORMAL:		::madvise(begin, length, MADV_NORMAL);		break;
+				case mapped_advice_lits::SEQUENTIAL:	::madvise(begin, length, MADV_SEQUENTIAL);	break;
+				case mapped_advice_lits::RANDOM:		::madvise(begin, length, MADV_RANDOM);		break;
+				case mapped_advice_lits::WILLNEED:		::madvise(begin, length, MADV_WILLNEED);	break;
+			}
 		}
 	}
-	inline void free()
+
+	template<typename U>
+	friend bool operator==(const mapped_allocator& lhs, const mapped_allocator<U>& rhs) noexcept
+	{
+		return lhs.m_source == rhs.m_source;
+	}
+
+private:
+
+	static inline size_t page_size()
+	{
+		static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+		return size;
+	}
+
+	// The mappings are whole pages, so they are rounded up to them (the file holds exactly the elements).
+	static inline size_t mapping_size(size_t n)
 	{
-		if (!empty())
-			destroy_data(data_begin(), data_end());
-		inherited::free();
-		m_data_begin = nullptr;
-		m_data_end = nullptr;
+		return (n * sizeof(T) + page_size() - 1) / page_size() * page_size();
 	}
 
-private:
+	// Widens [p, p + n) to start on a page boundary, as msync and madvise require.
+	static inline std::pair<void*, size_t> pages(const T* p, size_t n)
+	{
+		auto begin = reinterpret_cast<std::uintptr_t>(p) / page_size() * page_size();
+		auto end = reinterpret_cast<std::uintptr_t>(p + n);
+		return {reinterpret_cast<void*>(begin), end - begin};
+	}
 
-	// This function recenters the elements to prepare for size growth. If the remaining space is odd, then the
-	// extra space will be at the front if we are making space at the front, otherwise it will be at the back.
-	
-	inline void recenter()
+	inline T* map(size_t n) const
 	{
-		auto [front_gap, back_gap] = ::recenter<inherited>(capacity_begin(), capacity_end(), data_begin(), data_end());
-		m_data_begin = capacity_begin() + front_gap;
-		m_data_end = capacity_end() - back_gap;
+		auto p = is_file_backed() ?
+			::mmap(nullptr, mapping_size(n), PROT_READ | PROT_WRITE, MAP_SHARED, m_source->fd, 0) :
+			::mmap(nullptr, mapping_size(n), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+		if (m_source->huge_pages)
+			::madvise(p, mapping_size(n), MADV_HUGEPAGE);
+#endif
+		m_source->mapped = is_file_backed();
+		return static_cast<T*>(p);
 	}
 
-	value_type* m_data_begin = nullptr;
-	value_type* m_data_end = nullptr;
+	std::shared_ptr<source> m_source;
 };
 
+// mapped_sequence - Convenience alias for sequences whose capacity is a memory mapping (see mapped_allocator).
+
+export template<typename T, sequence_traits TRAITS = sequence_traits<size_t>{ .storage = sequence_storage_lits::MAPPED }>
+using mapped_sequence = ::sequence<T, TRAITS, mapped_allocator<T>>;
+
+#endif
 
 // ==============================================================================================================
-// fixed_sequence_storage - These member functions have to be here so they can see dynamic_sequence_storage.
+// concurrent_sequence - A bounded queue which can be used by several threads at once without locking. The slots
+// are a fixed_capacity (the same raw capacity as STATIC and FIXED storage), so the capacity, alignment,
+// tail_padding and size_type traits have the same meaning. Sequences with STATIC storage embed the slots and
+// sequences with FIXED storage allocate them once, when they are constructed. This is fully documented in the
+// README.md file.
 
-template<typename T, sequence_traits TRAITS>
-inline fixed_sequence_storage<T, TRAITS>::fixed_sequence_storage(dynamic_sequence_storage<TRAITS.location, T, TRAITS>&& rhs)
+export enum class concurrent_sequence_lits { SPSC, MPSC };		// See concurrent_sequence.
+
+export template<typename T, sequence_traits TRAITS = sequence_traits<size_t>{ .storage = sequence_storage_lits::STATIC },
+				concurrent_sequence_lits MODE = concurrent_sequence_lits::SPSC, typename ALLOC = std::allocator<T>>
+class concurrent_sequence
 {
-	std::uninitialized_move(rhs.data_begin(), rhs.data_end(), new_data_start(rhs.size()));
-	set_size(rhs.size());		// This must come last in case of a move exception.
-}
+	using size_type = typename decltype(TRAITS)::size_type;
+	using capacity_type = fixed_capacity<T, TRAITS.capacity, TRAITS.alignment, TRAITS.tail_padding>;
 
+	static constexpr size_t CAP = TRAITS.capacity;
+	static constexpr bool is_mpsc = MODE == concurrent_sequence_lits::MPSC;
 
-// ==============================================================================================================
-// sequence_storage - Base class for sequence which provides the 4 different memory allocation strategies.
+	// For MPSC each slot has a turn, which says which position may use it next (see try_emplace and try_pop).
 
-template<typename T, sequence_traits TRAITS, sequence_storage_lits STO = TRAITS.storage>
-class sequence_storage
-{
-	static_assert(false, "An unimplemented specialization of sequence_storage was instantiated.");
-};
+	struct turn_array { std::atomic<size_type> turns[CAP]; };
+	struct no_turns {};
 
-// STATIC storage (like std::inplace_vector or boost::static_vector).
+	struct slots_type
+	{
+		capacity_type elements;
+		NO_UNIQUE_ADDRESS std::conditional_t<is_mpsc, turn_array, no_turns> turns;
+	};
 
-template<typename T, sequence_traits TRAITS>
-class sequence_storage<T, TRAITS, sequence_storage_lits::STATIC>
-{
+	using alloc_traits = std::allocator_traits<ALLOC>;
+	using slots_allocator = typename alloc_traits::template rebind_alloc<slots_type>;
+	using slots_traits = std::allocator_traits<slots_allocator>;
 
-	using value_type = T;
-	using iterator = value_type*;
-	using size_type = typename decltype(TRAITS)::size_type;
-	using storage_type = fixed_sequence_storage<T, TRAITS>;
+	static constexpr bool is_static = TRAITS.storage == sequence_storage_lits::STATIC;
 
 public:
 
-	inline sequence_storage() = default;
-	inline sequence_storage(std::initializer_list<value_type> il) : m_storage(il) {}
+	using value_type = T;
+	using allocator_type = ALLOC;
+	using traits_type = decltype(TRAITS);
+	static constexpr traits_type traits = TRAITS;
 
-	static constexpr size_t max_size() { return std::numeric_limits<size_type>::max(); }
-	static constexpr size_t capacity() { return TRAITS.capacity; }
-	static constexpr bool is_dynamic() { return false; }
-	inline size_t size() const { return m_storage.size(); }
-	inline bool empty() const { return m_storage.empty(); }
+	static_assert(TRAITS.storage == sequence_storage_lits::STATIC || TRAITS.storage == sequence_storage_lits::FIXED,
+				  "concurrent_sequence requires STATIC or FIXED storage.");
 
-	inline void pop_front() { assert(!empty()); m_storage.pop_front(); }
-	inline void pop_back() { assert(!empty()); m_storage.pop_back(); }
-	inline void erase(value_type* begin, value_type* end) { assert(!empty()); m_storage.erase(begin, end); }
-	inline void erase(value_type* element) { assert(!empty()); m_storage.erase(element); }
-	inline void clear() { m_storage.clear(); }
-	inline void free() { m_storage.clear(); }
+	// SPSC positions run from 0 to twice the capacity so that a full queue can be told from an empty one.
+	static_assert(MODE != concurrent_sequence_lits::SPSC || 2 * CAP - 1 <= std::numeric_limits<size_type>::max(),
+				  "Size type is insufficient to hold twice the requested capacity.");
 
-	inline void swap(sequence_storage& other)
+	// MPSC positions run freely and wrap around the size type, so the capacity must divide its range. A producer
+	// which is held up while the positions go all the way around could be confused, so they must be wide.
+	static_assert(!is_mpsc || (std::has_single_bit(CAP) && CAP <= std::numeric_limits<size_type>::max()),
+				  "MPSC capacity must be a power of two which the size type can hold.");
+	static_assert(!is_mpsc || std::numeric_limits<size_type>::digits >= 32,
+				  "MPSC size type must have at least 32 bits.");
+	static_assert(!is_mpsc || std::is_nothrow_move_constructible_v<T>,
+				  "MPSC elements must be nothrow move constructible.");
+
+	inline concurrent_sequence() : concurrent_sequence(allocator_type()) {}
+	inline explicit concurrent_sequence(const allocator_type& alloc) : m_allocator(alloc)
 	{
-		std::swap(m_storage, other.m_storage);
+		if constexpr (!is_static)
+		{
+			slots_allocator slots_alloc(m_allocator);
+			m_slots = new(slots_traits::allocate(slots_alloc, 1)) slots_type;
+		}
+		if constexpr (is_mpsc)
+		{
+			for (size_t i = 0; i < CAP; ++i)
+				slots().turns.turns[i].store(static_cast<size_type>(i), std::memory_order_relaxed);
+		}
 	}
 
-protected:
+	// A queue which other threads may be using cannot be copied or moved.
+	concurrent_sequence(const concurrent_sequence&) = delete;
+	concurrent_sequence& operator=(const concurrent_sequence&) = delete;
 
-	template<typename... ARGS>
-	inline iterator add_at(iterator pos, ARGS&&... args)
+	// There must be no other threads using the queue when it is destroyed.
+	inline ~concurrent_sequence()
 	{
-		return m_storage.add_at(pos, std::forward<ARGS>(args)...);
+		while (pop_front()) {}
+		if constexpr (!is_static)
+		{
+			slots_allocator slots_alloc(m_allocator);
+			m_slots->~slots_type();
+			slots_traits::deallocate(slots_alloc, m_slots, 1);
+		}
 	}
-	template<typename... ARGS>
-	inline void add_front(ARGS&&... args)
+
+	inline allocator_type get_allocator() const { return m_allocator; }
+
+	static constexpr size_t capacity() { return CAP; }
+	static constexpr size_t max_size() { return CAP; }
+
+	// The size is exact if no other thread is changing it, otherwise it is a snapshot which may already be out
+	// of date (but is never more than the capacity).
+	inline size_t size() const
 	{
-		m_storage.add_front(std::forward<ARGS>(args)...);
+		auto head = m_head.load(std::memory_order_acquire);
+		auto tail = m_tail.load(std::memory_order_acquire);
+		return std::min(distance(head, tail), CAP);
 	}
+	inline bool empty() const { return size() == 0; }
+
+	// These add an element at the back of the queue and return true, or return false if the queue is full.
+	// In SPSC mode only one thread may call them at a time; in MPSC mode any number of threads may.
+
+	inline bool try_push(const value_type& e) { return try_emplace(e); }
+	inline bool try_push(value_type&& e) { return try_emplace(std::move(e)); }
+
 	template<typename... ARGS>
-	inline void add_back(ARGS&&... args)
+	inline bool try_emplace(ARGS&&... args)
 	{
-		m_storage.add_back(std::forward<ARGS>(args)...);
+		// A producer claims its slot before constructing the element and must then publish it, so in MPSC
+		// mode the element is built first if that might throw.
+		if constexpr (is_mpsc && !std::is_nothrow_constructible_v<value_type, ARGS...>)
+			return try_emplace(value_type(std::forward<ARGS>(args)...));
+
+		else if constexpr (is_mpsc)
+		{
+			auto tail = m_tail.load(std::memory_order_relaxed);
+			for (;;)
+			{
+				auto turn = slots().turns.turns[tail % CAP].load(std::memory_order_acquire);
+				auto difference = static_cast<std::make_signed_t<size_type>>(static_cast<size_type>(turn - tail));
+				if (difference == 0)
+				{
+					if (m_tail.compare_exchange_weak(tail, static_cast<size_type>(tail + 1), std::memory_order_relaxed))
+						break;
+				}
+				else if (difference < 0)
+					return false;
+				else
+					tail = m_tail.load(std::memory_order_relaxed);
+			}
+			new(element(tail)) value_type(std::forward<ARGS>(args)...);
+			slots().turns.turns[tail % CAP].store(static_cast<size_type>(tail + 1), std::memory_order_release);
+			return true;
+		}
+		else
+		{
+			auto tail = m_tail.load(std::memory_order_relaxed);
+			if (distance(m_head_cache, tail) == CAP)
+			{
+				m_head_cache = m_head.load(std::memory_order_acquire);
+				if (distance(m_head_cache, tail) == CAP)
+					return false;
+			}
+			new(element(tail)) value_type(std::forward<ARGS>(args)...);
+			m_tail.store(next(tail), std::memory_order_release);
+			return true;
+		}
 	}
 
-	inline auto data_begin() { return m_storage.data_begin(); }
-	inline auto data_end() { return m_storage.data_end(); }
-	inline auto data_begin() const { return m_storage.data_begin(); }
-	inline auto data_end() const { return m_storage.data_end(); }
-	inline auto capacity_begin() const { return m_storage.capacity_begin(); }
-	inline auto capacity_end() const { return m_storage.capacity_end(); }
+	// Moves the element at the front of the queue into 'value', removes it and returns true, or returns false if
+	// the queue is empty. Only one thread may call this at a time. If the assignment throws, the element stays.
 
-	inline void reallocate(size_t new_capacity)
+	inline bool try_pop(value_type& value)
 	{
-		if (new_capacity > TRAITS.capacity)
-			throw std::bad_alloc();
+		return pop_front([&](value_type& e){ value = std::move(e); });
 	}
-	inline void prepare_for(size_type size) { m_storage.prepare_for(size); }
 
 private:
 
-	storage_type m_storage;
-};
-
-// FIXED storage.
-
-template<typename T, sequence_traits TRAITS>
-class sequence_storage<T, TRAITS, sequence_storage_lits::FIXED>
-{
-	using value_type = T;
-	using iterator = value_type*;
-	using size_type = typename decltype(TRAITS)::size_type;
-	using storage_type = fixed_sequence_storage<T, TRAITS>;
-
-public:
-
-	inline sequence_storage() = default;
-	inline sequence_storage(std::initializer_list<value_type> il) : m_storage(new storage_type(il)) {}
+	// Removes the element at the front of the queue (after passing it to 'use'), if there is one.
 
-	inline sequence_storage(const sequence_storage& rhs)
+	template<typename FUNC = void(*)(value_type&)>
+	inline bool pop_front(FUNC use = [](value_type&){})
 	{
-		if (rhs.m_storage)
+		auto head = m_head.load(std::memory_order_relaxed);
+
+		if constexpr (is_mpsc)
 		{
-			m_storage.reset(new storage_type);
-			*m_storage = *rhs.m_storage;
+			auto& turn = slots().turns.turns[head % CAP];
+			if (turn.load(std::memory_order_acquire) != static_cast<size_type>(head + 1))
+				return false;
+			use(*element(head));
+			element(head)->~value_type();
+			turn.store(static_cast<size_type>(head + CAP), std::memory_order_release);
+			m_head.store(static_cast<size_type>(head + 1), std::memory_order_release);
 		}
-	}
-	inline sequence_storage(sequence_storage&& rhs) :
-		m_storage(std::move(rhs.m_storage))
-	{}
-
-	inline sequence_storage& operator=(const sequence_storage& rhs)
-	{
-		if (rhs.m_storage)
+		else
 		{
-			if (!m_storage)
-				m_storage.reset(new storage_type);
-			*m_storage = *rhs.m_storage;
+			if (head == m_tail_cache)
+			{
+				m_tail_cache = m_tail.load(std::memory_order_acquire);
+				if (head == m_tail_cache)
+					return false;
+			}
+			use(*element(head));
+			element(head)->~value_type();
+			m_head.store(next(head), std::memory_order_release);
 		}
-		else clear();
-		return *this;
-	}
-	inline sequence_storage& operator=(sequence_storage&& rhs)
-	{
-		m_storage = std::move(rhs.m_storage);
-		return *this;
+		return true;
 	}
 
-	static constexpr size_t max_size() { return std::numeric_limits<size_type>::max(); }
-	inline size_t capacity() const { return m_storage ? TRAITS.capacity : 0; }
-	static constexpr bool is_dynamic() { return true; }
-	inline size_t size() const { return m_storage ? m_storage->size() : 0; }
-	inline bool empty() const { return m_storage ? m_storage->empty() : true; }
+	// Position arithmetic. MPSC positions simply wrap around the size type. SPSC positions wrap around
+	// at twice the capacity, and each slot has two positions.
 
-	inline void pop_front() { assert(!empty()); m_storage->pop_front(); }
-	inline void pop_back() { assert(!empty()); m_storage->pop_back(); }
-	inline void erase(value_type* begin, value_type* end) { assert(!empty()); m_storage->erase(begin, end); }
-	inline void erase(value_type* element) { assert(!empty()); m_storage->erase(element); }
-	inline void clear() { if (m_storage) m_storage->clear(); }
-	inline void free()
+	static constexpr size_type next(size_type pos)
 	{
-		clear();
-		m_storage.reset();
+		return static_cast<size_type>(pos + 1 == 2 * CAP ? 0 : pos + 1);
 	}
-
-	inline void swap(sequence_storage& other)
+	static constexpr size_t distance(size_type from, size_type to)
 	{
-		std::swap(m_storage, other.m_storage);
+		if constexpr (is_mpsc)
+			return static_cast<size_type>(to - from);
+		else
+			return to >= from ? to - from : to + 2 * CAP - from;
 	}
 
-protected:
-
-	template<typename... ARGS>
-	inline iterator add_at(iterator pos, ARGS&&... args)
+	inline slots_type& slots()
 	{
-		//if (!m_storage)
-		//	m_storage.reset(new storage_type);
-		return m_storage->add_at(pos, std::forward<ARGS>(args)...);
-	}
-	template<typename... ARGS>
-	inline void add_front(ARGS&&... args)
-	{
-		//if (!m_storage)
-		//	m_storage.reset(new storage_type);
-		m_storage->add_front(std::forward<ARGS>(args)...);
+		if constexpr (is_static)
+			return m_slots;
+		else
+			return *m_slots;
 	}
-	template<typename... ARGS>
-	inline void add_back(ARGS&&... args)
+	inline value_type* element(size_type pos)
 	{
-		//if (!m_storage)
-		//	m_storage.reset(new storage_type);
-		m_storage->add_back(std::forward<ARGS>(args)...);
+		return slots().elements.capacity_begin() + (pos % CAP);
 	}
-	//template<typename... ARGS>
-	//inline void add(size_t new_size, ARGS&&... args)
-	//{
-	//	if (!m_storage)
-	//		m_storage.reset(new storage_type);
-	//	m_storage->add(new_size, std::forward<ARGS>(args)...);
-	//}
 
-	inline auto data_begin() { return m_storage ? m_storage->data_begin() : nullptr; }
-	inline auto data_end() { return m_storage ? m_storage->data_end() : nullptr; }
-	inline auto data_begin() const { return m_storage ? m_storage->data_begin() : nullptr; }
-	inline auto data_end() const { return m_storage ? m_storage->data_end() : nullptr; }
-	inline auto capacity_begin() const { return m_storage ? m_storage->capacity_begin() : nullptr; }
-	inline auto capacity_end() const { return m_storage ? m_storage->capacity_end() : nullptr; }
+	alignas(cache_line_size) std::atomic<size_type> m_tail = 0;		// Written by the producer(s).
+	size_type m_head_cache = 0;											// The producer's last view of m_head (SPSC).
 
-	inline void reallocate(size_t new_capacity)
-	{
-		if (new_capacity > TRAITS.capacity)
-			throw std::bad_alloc();
-		if (!m_storage)
-			m_storage.reset(new storage_type);
-	}
-	inline void prepare_for(size_type size) { if (m_storage) m_storage->prepare_for(size); }
+	alignas(cache_line_size) std::atomic<size_type> m_head = 0;		// Written by the consumer.
+	size_type m_tail_cache = 0;											// The consumer's last view of m_tail (SPSC).
 
-private:
+	alignas(cache_line_size) std::conditional_t<is_static, slots_type, slots_type*> m_slots;
+	NO_UNIQUE_ADDRESS allocator_type m_allocator;
+};
 
-	std::unique_ptr<storage_type> m_storage;
+// ==============================================================================================================
+// soa_sequence - A sequence of rows whose fields are each kept in a column of their own (a structure of arrays),
+// so that a pass over some of the fields only brings those fields into the cache, and a loop over a column can be
+// vectorized. Each column is a raw capacity of the kind sequence uses (a fixed_capacity for STATIC storage and a
+// dynamic_capacity for FIXED and VARIABLE storage), all columns have the same capacity, and the rows are at the
+// same positions in each of them. So the storage, location, capacity, growth, alignment, tail_padding, front_bias
+// and size_type traits have the same meaning as for sequence. The iterators are proxies (as for std::views::zip),
+// whose references are tuples of references to the fields of a row. This is fully documented in the README.md file.
+
+export template<typename T, sequence_traits TRAITS = sequence_traits<size_t>(), typename ALLOC = std::allocator<T>>
+class soa_sequence
+{
+	static_assert(false, "soa_sequence requires a std::tuple of the field types.");
 };
 
-// VARIABLE storage.
+// soa_column - A dynamic_capacity which soa_sequence can exchange and give back (as dynamic_sequence_storage does).
 
-template<typename T, sequence_traits TRAITS>
-class sequence_storage<T, TRAITS, sequence_storage_lits::VARIABLE>
+template<typename T, sequence_traits TRAITS, typename ALLOC>
+class soa_column : public dynamic_capacity<T, TRAITS, ALLOC>
 {
-	using value_type = T;
-	using iterator = value_type*;
+	using inherited = dynamic_capacity<T, TRAITS, ALLOC>;
 
 public:
 
-	inline sequence_storage() = default;
-	inline sequence_storage(std::initializer_list<value_type> il) : m_storage(il) {}
+	using inherited::inherited;
+	using inherited::swap;
+	using inherited::free;
+	using inherited::select_allocator;
+	using inherited::swap_allocator;
+	using inherited::move_allocator;
+	using inherited::copy_allocator;
+};
 
-	static constexpr size_t max_size() { return std::numeric_limits<size_t>::max(); }
-	inline size_t capacity() const { return m_storage.capacity(); }
-	static constexpr bool is_dynamic() { return true; }
-	inline size_t size() const { return m_storage.size(); }
-	inline bool empty() const { return m_storage.empty(); }
+template<typename... Ts, sequence_traits TRAITS, typename ALLOC>
+class soa_sequence<std::tuple<Ts...>, TRAITS, ALLOC>
+{
+	static constexpr bool is_static = TRAITS.storage == sequence_storage_lits::STATIC;
+	static constexpr auto indices = std::index_sequence_for<Ts...>();
 
-	inline void pop_front() { assert(!empty()); m_storage.pop_front(); }
-	inline void pop_back() { assert(!empty()); m_storage.pop_back(); }
-	inline void erase(value_type* begin, value_type* end) { assert(!empty()); m_storage.erase(begin, end); }
-	inline void erase(value_type* element) { assert(!empty()); m_storage.erase(element); }
-	inline void clear() { m_storage.clear(); }
-	inline void free() { m_storage.free(); }
+	using alloc_traits = std::allocator_traits<ALLOC>;
+	template<typename U>
+	using column_allocator = typename alloc_traits::template rebind_alloc<U>;
+	template<typename U>
+	using column_type = std::conditional_t<is_static, fixed_capacity<U, TRAITS.capacity, TRAITS.alignment, TRAITS.tail_padding>,
+										   soa_column<U, TRAITS, column_allocator<U>>>;
+	using columns_type = std::tuple<column_type<Ts>...>;
 
-	inline void swap(sequence_storage& other)
+	// The size of a row (which is passed to the growth policy).
+	static constexpr size_t row_size = (sizeof(Ts) + ...);
+
+	// The start of the rows is placed as if the elements were the size of the greatest common divisor of the field
+	// sizes, which keeps the requested alignment in every column (see sequence_traits::middle_gap).
+	static constexpr size_t gap_unit = []
 	{
-		m_storage.swap(other.m_storage);
-	}
+		size_t unit = 0;
+		((unit = std::gcd(unit, sizeof(Ts))), ...);
+		return unit;
+	}();
 
-protected:
+public:
 
-	template<typename... ARGS>
-	inline iterator add_at(iterator pos, ARGS&&... args) { return m_storage.add_at(pos, std::forward<ARGS>(args)...); }
-	template<typename... ARGS>
-	inline void add_front(ARGS&&... args) { m_storage.add_front(std::forward<ARGS>(args)...); }
-	template<typename... ARGS>
-	inline void add_back(ARGS&&... args) { m_storage.add_back(std::forward<ARGS>(args)...); }
-	template<typename... ARGS>
-	inline void add(size_t new_size, ARGS&&... args) { m_storage.add(new_size, std::forward<ARGS>(args)...); }
+	using value_type = std::tuple<Ts...>;
+	using reference = std::tuple<Ts&...>;
+	using const_reference = std::tuple<const Ts&...>;
+	using allocator_type = ALLOC;
+	using traits_type = decltype(TRAITS);
+	static constexpr traits_type traits = TRAITS;
+	using size_type = typename traits_type::size_type;
+	using difference_type = std::ptrdiff_t;
 
-	inline auto data_begin() { return m_storage.data_begin(); }
-	inline auto data_end() { return m_storage.data_end(); }
-	inline auto data_begin() const { return m_storage.data_begin(); }
-	inline auto data_end() const { return m_storage.data_end(); }
-	inline auto capacity_begin() const { return m_storage.capacity_begin(); }
-	inline auto capacity_end() const { return m_storage.capacity_end(); }
+	template<bool CONST>
+	class row_iterator;
 
-	inline void reallocate(size_t new_capacity)
-	{
-		m_storage.reallocate(new_capacity);
-	}
+	using iterator = row_iterator<false>;
+	using const_iterator = row_iterator<true>;
+	using reverse_iterator = std::reverse_iterator<iterator>;
+	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
-private:
+	static_assert(sizeof...(Ts) > 0,
+				  "soa_sequence requires at least one field.");
+	static_assert(traits.storage == sequence_storage_lits::STATIC || traits.storage == sequence_storage_lits::FIXED ||
+				  traits.storage == sequence_storage_lits::VARIABLE,
+				  "soa_sequence requires STATIC, FIXED or VARIABLE storage.");
+	static_assert(traits.location != sequence_location_lits::CIRCULAR,
+				  "soa_sequence requires FRONT, BACK or MIDDLE location.");
+	static_assert(traits.capacity > 0,
+				  "Capacity must be greater than 0.");
+	static_assert(traits.front_bias >= 0.0f && traits.front_bias <= 1.0f,
+				  "Front bias must be between 0.0 and 1.0.");
+	static_assert(traits.is_variable() || traits.capacity <= std::numeric_limits<size_type>::max(),
+				  "Size type is insufficient to hold requested capacity.");
 
-	dynamic_sequence_storage<TRAITS.location, T, TRAITS> m_storage;
-};
+	// Rows are shifted and relocated a column at a time, which must not fail part way through.
+	static_assert(((std::is_nothrow_move_constructible_v<Ts> && std::is_nothrow_move_assignable_v<Ts>) && ...),
+				  "soa_sequence fields must be nothrow movable.");
 
-// BUFFERED storage supporting a small object buffer optimization (like boost::small_vector).
+	static_assert(std::same_as<typename alloc_traits::value_type, value_type>,
+				  "Allocator value type must be the same as the element type.");
 
-template<typename T, sequence_traits TRAITS>
-class sequence_storage<T, TRAITS, sequence_storage_lits::BUFFERED>
-{
-	using value_type = T;
-	using iterator = value_type*;
-	using size_type = typename decltype(TRAITS)::size_type;
+	inline soa_sequence() : soa_sequence(allocator_type()) {}
+	inline explicit soa_sequence(const allocator_type& alloc) : m_columns(make_columns(alloc)) { clear(); }
+	inline explicit soa_sequence(size_type n, const allocator_type& alloc = allocator_type()) : soa_sequence(alloc)
+	{
+		resize(n);
+	}
+	inline soa_sequence(size_type n, const value_type& value, const allocator_type& alloc = allocator_type()) :
+		soa_sequence(alloc)
+	{
+		resize(n, value);
+	}
+	inline soa_sequence(std::initializer_list<value_type> il, const allocator_type& alloc = allocator_type()) :
+		soa_sequence(alloc)
+	{
+		reserve_exactly(il.size());
+		insert(cend(), il.begin(), il.end());
+	}
+	inline soa_sequence(const soa_sequence& rhs) : m_columns(rhs.copy_columns())
+	{
+		clear();
+		copy_from(rhs);
+	}
+	inline soa_sequence(soa_sequence&& rhs) : m_columns(rhs.move_columns())
+	{
+		if constexpr (is_static)
+		{
+			clear();
+			move_from(rhs);
+		}
+		else
+		{
+			m_begin = std::exchange(rhs.m_begin, 0);
+			m_size = std::exchange(rhs.m_size, 0);
+		}
+	}
+	inline ~soa_sequence() { destroy_rows(0, m_size); }
 
-	enum { STC, DYN };
-	using fixed_type = fixed_sequence_storage<T, TRAITS>;		// STC
-	using dynamic_type = dynamic_sequence_storage<TRAITS.location, T, TRAITS>;	// DYN
+	// Assignment follows the standard allocator propagation rules (see dynamic_capacity).
 
-public:
+	inline soa_sequence& operator=(const soa_sequence& rhs)
+	{
+		if (this != &rhs)
+		{
+			clear();
+			if constexpr (!is_static)
+				for_each_column([&](auto I) { std::get<I>(m_columns).copy_allocator(std::get<I>(rhs.m_columns), [&]{ free(); }); });
+			copy_from(rhs);
+		}
+		return *this;
+	}
+	inline soa_sequence& operator=(soa_sequence&& rhs)
+	{
+		if (this != &rhs)
+		{
+			if constexpr (!is_static)
+			{
+				free();
+				bool take = true;
+				for_each_column([&](auto I) { take = std::get<I>(m_columns).move_allocator(std::get<I>(rhs.m_columns)) && take; });
+				if (take)
+				{
+					for_each_column([&](auto I) { std::get<I>(m_columns).swap(std::get<I>(rhs.m_columns)); });
+					m_begin = std::exchange(rhs.m_begin, 0);
+					m_size = std::exchange(rhs.m_size, 0);
+					return *this;
+				}
+			}
+			clear();
+			move_from(rhs);
+		}
+		return *this;
+	}
 
-	inline sequence_storage() = default;
-	inline sequence_storage(std::initializer_list<value_type> il)
+	inline allocator_type get_allocator() const
 	{
-		if (il.size() <= TRAITS.capacity)
-			m_storage.emplace<STC>(il);
+		if constexpr (is_static)
+			return allocator_type();
 		else
-			m_storage.emplace<DYN>(il);
+			return allocator_type(std::get<0>(m_columns).get_allocator());
 	}
 
-	//inline sequence_storage(const sequence_storage& rhs)
-	//{
-	//	if (rhs.m_storage)
-	//	{
-	//		m_storage.reset(new storage_type);
-	//		*m_storage = *rhs.m_storage;
-	//	}
-	//}
-	//inline sequence_storage(sequence_storage&& rhs) :
-	//	m_storage(std::move(rhs.m_storage))
-	//{
-	//}
-
-	//inline sequence_storage& operator=(const sequence_storage& rhs)
-	//{
-	//	if (rhs.m_storage.index() == STC)
-	//	if (rhs.m_storage)
-	//	{
-	//		if (!m_storage)
-	//			m_storage.reset(new storage_type);
-	//		*m_storage = *rhs.m_storage;
-	//	}
-	//	else clear();
-	//	return *this;
-	//}
-	//inline sequence_storage& operator=(sequence_storage&& rhs)
-	//{
-	//	m_storage = std::move(rhs.m_storage);
-	//	return *this;
-	//}
+	inline size_t size() const { return m_size; }
+	inline bool empty() const { return m_size == 0; }
+	static constexpr size_t max_size()
+	{
+		if constexpr (traits.is_variable())
+			return std::numeric_limits<size_t>::max() / row_size;
+		else
+			return traits.capacity;
+	}
 
-	static constexpr size_t max_size() { return std::numeric_limits<size_type>::max(); }
-	inline size_t capacity() const { return execute([](auto&& storage){ return storage.capacity(); }); }
-	inline bool is_dynamic() const { return m_storage.index() == DYN; }
-	inline size_t size() const { return execute([](auto&& storage){ return storage.size(); }); }
-	inline bool empty() const { return execute([](auto&& storage){ return storage.empty(); }); }
-
-	inline void pop_front() { assert(!empty()); execute([](auto&& storage){ storage.pop_front(); }); }
-	inline void pop_back() { assert(!empty()); execute([](auto&& storage){ storage.pop_back(); }); }
-	inline void erase(value_type* begin, value_type* end) { assert(!empty()); execute([=](auto&& storage){ storage.erase(begin, end); }); }
-	inline void erase(value_type* element) { assert(!empty()); execute([=](auto&& storage){ storage.erase(element); }); }
-	inline void clear() { execute([=](auto&& storage){ storage.clear(); }); }
-	inline void free()
+	// The capacity of each column may be larger than was asked for (see dynamic_capacity), so the capacity is
+	// that of the smallest one.
+	inline size_t capacity() const
 	{
-		if (m_storage.index() == STC)
-			get<STC>(m_storage).clear();
+		if constexpr (is_static)
+			return traits.capacity;
 		else
-			m_storage.emplace<STC>();
+			return [&]<size_t... I>(std::index_sequence<I...>) { return std::min({ std::get<I>(m_columns).capacity()... }); }(indices);
 	}
 
-	inline void swap(sequence_storage& other)
+	inline void reserve(size_t new_capacity)
+	{
+		if (new_capacity > capacity())
+			reallocate(new_capacity);
+	}
+	inline void shrink_to_fit()
+	{
+		if (m_size == 0)
+			free();
+		else if (traits.is_variable() && m_size < capacity())
+			reallocate(m_size);
+	}
+	inline void clear()
+	{
+		destroy_rows(0, m_size);
+		m_size = 0;
+		m_begin = static_cast<index_type>(traits.front_gap(capacity(), 0, gap_unit));
+	}
+	inline void free()
 	{
-		auto swap_mixed = [](sequence_storage& stc, sequence_storage& dyn)
+		clear();
+		if constexpr (!is_static)
 		{
-			assert(stc.m_storage.index() == STC);
-			assert(dyn.m_storage.index() == DYN);
-
-			dynamic_type temp = std::move(get<DYN>(dyn.m_storage));
-			dyn.m_storage.emplace<STC>(std::move(get<STC>(stc.m_storage)));
-			stc.m_storage.emplace<DYN>(std::move(temp));
-		};
-
-		if (m_storage.index() == STC)
+			for_each_column([&](auto I) { std::get<I>(m_columns).free(); });
+			m_begin = 0;
+		}
+	}
+	inline void swap(soa_sequence& rhs)
+	{
+		if constexpr (is_static)
 		{
-			if (other.m_storage.index() == STC)
-				std::swap(get<STC>(m_storage), get<STC>(other.m_storage));
-			else
-				swap_mixed(*this, other);
+			auto temp = std::move(rhs);
+			rhs = std::move(*this);
+			*this = std::move(temp);
 		}
 		else
 		{
-			if (other.m_storage.index() == STC)
-				swap_mixed(other, *this);
-			else
-				get<DYN>(m_storage).swap(get<DYN>(other.m_storage));
+			for_each_column([&](auto I)
+			{
+				std::get<I>(m_columns).swap_allocator(std::get<I>(rhs.m_columns));
+				std::get<I>(m_columns).swap(std::get<I>(rhs.m_columns));
+			});
+			std::swap(m_begin, rhs.m_begin);
+			std::swap(m_size, rhs.m_size);
 		}
 	}
+	friend inline void swap(soa_sequence& lhs, soa_sequence& rhs) { lhs.swap(rhs); }
 
-protected:
+	inline iterator begin() { return { row_pointers(), 0 }; }
+	inline iterator end() { return { row_pointers(), static_cast<difference_type>(m_size) }; }
+	inline const_iterator begin() const { return { row_pointers(), 0 }; }
+	inline const_iterator end() const { return { row_pointers(), static_cast<difference_type>(m_size) }; }
+	inline reverse_iterator rbegin() { return reverse_iterator(end()); }
+	inline reverse_iterator rend() { return reverse_iterator(begin()); }
+	inline const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+	inline const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+	inline const_iterator cbegin() const { return begin(); }
+	inline const_iterator cend() const { return end(); }
+	inline const_reverse_iterator crbegin() const { return rbegin(); }
+	inline const_reverse_iterator crend() const { return rend(); }
 
-	template<typename... ARGS>
-	inline iterator add_at(iterator pos, ARGS&&... args)
+	// The fields of the rows, as a span for one column or a tuple of spans for all of them. These are what loops
+	// which only need some of the fields should use (e.g. 'for (auto& x : particles.column<0>())').
+
+	template<size_t I>
+	inline std::span<std::tuple_element_t<I, value_type>> column() { return { data_begin<I>(), m_size }; }
+	template<size_t I>
+	inline std::span<const std::tuple_element_t<I, value_type>> column() const { return { data_begin<I>(), m_size }; }
+	inline std::tuple<std::span<Ts>...> columns()
 	{
-		return execute([=, &...args = std::forward<ARGS>(args)](auto&& storage){ return storage.add_at(pos, std::forward<ARGS>(args)...); });
+		return [&]<size_t... I>(std::index_sequence<I...>) { return std::tuple<std::span<Ts>...>(column<I>()...); }(indices);
 	}
-	template<typename... ARGS>
-	inline void add_front(ARGS&&... args)
+	inline std::tuple<std::span<const Ts>...> columns() const
 	{
-		return execute([&...args = std::forward<ARGS>(args)](auto&& storage){ return storage.add_front(std::forward<ARGS>(args)...); });
+		return [&]<size_t... I>(std::index_sequence<I...>) { return std::tuple<std::span<const Ts>...>(column<I>()...); }(indices);
 	}
-	template<typename... ARGS>
-	inline void add_back(ARGS&&... args)
+
+	inline reference operator[](size_t index) { return begin()[index]; }
+	inline const_reference operator[](size_t index) const { return begin()[index]; }
+	inline reference at(size_t index)
 	{
-		return execute([&...args = std::forward<ARGS>(args)](auto&& storage){ return storage.add_back(std::forward<ARGS>(args)...); });
+		if (index >= size()) throw std::out_of_range(std::format(OUT_OF_RANGE_ERROR, index));
+		return (*this)[index];
+	}
+	inline const_reference at(size_t index) const
+	{
+		if (index >= size()) throw std::out_of_range(std::format(OUT_OF_RANGE_ERROR, index));
+		return (*this)[index];
 	}
+	inline reference front() { return (*this)[0]; }
+	inline const_reference front() const { return (*this)[0]; }
+	inline reference back() { return (*this)[m_size - 1]; }
+	inline const_reference back() const { return (*this)[m_size - 1]; }
+
+	// A row is added by moving its fields into the columns. The row is built first by emplace (from one argument
+	// per field), since the arguments might refer to fields which are about to move.
+
 	template<typename... ARGS>
-	inline void add(size_t new_size, ARGS&&... args)
+	inline iterator emplace(const_iterator pos, ARGS&&... fields)
+	{
+		return insert(pos, value_type(std::forward<ARGS>(fields)...));
+	}
+	inline iterator insert(const_iterator pos, value_type&& row)
+	{
+		size_t index = pos - cbegin();
+		insert_rows(index, 1, [&](auto I, auto gap) { std::construct_at(gap, std::get<I>(std::move(row))); });
+		return begin() + index;
+	}
+	inline iterator insert(const_iterator pos, const value_type& row)
+	{
+		size_t index = pos - cbegin();
+		insert_rows(index, 1, [&](auto I, auto gap) { std::construct_at(gap, std::get<I>(row)); });
+		return begin() + index;
+	}
+	inline iterator insert(const_iterator pos, size_type count, const value_type& row)
 	{
-		return execute([=, &...args = std::forward<ARGS>(args)](auto&& storage){ return storage.add(new_size, std::forward<ARGS>(args)...); });
+		size_t index = pos - cbegin();
+		insert_rows(index, count, [&](auto I, auto gap) { uninitialized_construct_n(gap, count, std::get<I>(row)); });
+		return begin() + index;
+	}
+	template<std::forward_iterator IT>
+	inline iterator insert(const_iterator pos, IT first, IT last)
+	{
+		size_t index = pos - cbegin();
+		insert_rows(index, std::distance(first, last), [&](auto I, auto gap)
+		{
+			auto end = gap;
+			try
+			{
+				for (auto row = first; row != last; ++row, ++end)
+					std::construct_at(end, std::get<I>(*row));
+			}
+			catch (...)
+			{
+				destroy_data(gap, end);
+				throw;
+			}
+		});
+		return begin() + index;
+	}
+	inline iterator insert(const_iterator pos, std::initializer_list<value_type> il)
+	{
+		return insert(pos, il.begin(), il.end());
 	}
 
-	inline auto data_begin()			{ return execute([](auto&& storage){ return storage.data_begin(); }); }
-	inline auto data_begin() const		{ return execute([](auto&& storage){ return storage.data_begin(); }); }
-	inline auto data_end()				{ return execute([](auto&& storage){ return storage.data_end(); }); }
-	inline auto data_end() const		{ return execute([](auto&& storage){ return storage.data_end(); }); }
-	inline auto capacity_begin() const	{ return execute([](auto&& storage){ return storage.capacity_begin(); }); }
-	inline auto capacity_end() const	{ return execute([](auto&& storage){ return storage.capacity_end(); }); }
+	template<typename... ARGS>
+	inline reference emplace_back(ARGS&&... fields) { return *emplace(cend(), std::forward<ARGS>(fields)...); }
+	template<typename... ARGS>
+	inline reference emplace_front(ARGS&&... fields) { return *emplace(cbegin(), std::forward<ARGS>(fields)...); }
+	inline void push_back(const value_type& row) { insert(cend(), row); }
+	inline void push_back(value_type&& row) { insert(cend(), std::move(row)); }
+	inline void push_front(const value_type& row) { insert(cbegin(), row); }
+	inline void push_front(value_type&& row) { insert(cbegin(), std::move(row)); }
 
-	inline void reallocate(size_t new_capacity)
+	inline iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+	inline iterator erase(const_iterator first, const_iterator last)
 	{
-		// The new capacity will not fit in the buffer.
-		if (new_capacity > TRAITS.capacity)
+		size_t index = first - cbegin();
+		if (size_t count = last - first)
 		{
-			if (m_storage.index() == STC)		// We're moving out of the buffer: switch to dynamic storage.
-				m_storage = dynamic_type(new_capacity, std::move(get<STC>(m_storage)));
-			else								// We're already out of the buffer: adjust the dynamic capacity.		
-				get<DYN>(m_storage).reallocate(new_capacity);
+			destroy_rows(index, count);
+			close_rows(index, count);
 		}
+		return begin() + index;
+	}
+	inline void pop_back() { erase(cend() - 1); }
+	inline void pop_front() { erase(cbegin()); }
 
-		// The new capacity will fit in the buffer.
-		else if (m_storage.index() == DYN)		// We're moving into the buffer: switch to buffer storage.
-				m_storage.emplace<STC>(dynamic_type(std::move(get<DYN>(m_storage))));
-		// If we're already in the buffer: do nothing (the buffer capacity cannot change).
+	inline void resize(size_type new_size)
+	{
+		if (new_size < m_size)
+			erase(cbegin() + new_size, cend());
+		else if (size_t count = new_size - m_size)
+		{
+			reserve_exactly(new_size);
+			insert_rows(m_size, count, [&](auto, auto gap) { uninitialized_construct_n(gap, count); });
+		}
+	}
+	inline void resize(size_type new_size, const value_type& row)
+	{
+		if (new_size < m_size)
+			erase(cbegin() + new_size, cend());
+		else if (size_t count = new_size - m_size)
+		{
+			reserve_exactly(new_size);
+			insert_rows(m_size, count, [&](auto I, auto gap) { uninitialized_construct_n(gap, count, std::get<I>(row)); });
+		}
 	}
 
-private:
+	// Rows are equal when all of their fields are, so sequences are compared a column at a time.
 
-	std::variant<fixed_type, dynamic_type> m_storage;
+	friend inline bool operator==(const soa_sequence& lhs, const soa_sequence& rhs) requires (std::equality_comparable<Ts> && ...)
+	{
+		return lhs.size() == rhs.size() && [&]<size_t... I>(std::index_sequence<I...>)
+		{
+			return (std::equal(lhs.data_begin<I>(), lhs.data_end<I>(), rhs.data_begin<I>()) && ...);
+		}(indices);
+	}
 
-	template<typename FUNC>
-	inline auto execute(FUNC f)
-	{ return m_storage.index() == STC ? f(get<STC>(m_storage)) : f(get<DYN>(m_storage)); }
-	template<typename FUNC>
-	inline auto execute(FUNC f) const
-	{ return m_storage.index() == STC ? f(get<STC>(m_storage)) : f(get<DYN>(m_storage)); }
+	// row_iterator - The random access iterator over the rows. It holds the start of the rows in each column and
+	// the index of its row, and dereferences to a tuple of references to the fields of the row. Moving and
+	// swapping rows through iterators (with std::ranges::iter_move and iter_swap) moves and swaps their fields.
 
-};
+	template<bool CONST>
+	class row_iterator
+	{
+		template<typename U>
+		using field = std::conditional_t<CONST, const U, U>;
 
+	public:
 
-// ==============================================================================================================
-// sequence - This is the main class template.
+		using iterator_concept = std::random_access_iterator_tag;
+		using iterator_category = std::input_iterator_tag;		// The references are not real references.
+		using value_type = std::tuple<Ts...>;
+		using difference_type = std::ptrdiff_t;
+		using reference = std::tuple<field<Ts>&...>;
 
-export template<typename T, sequence_traits TRAITS = sequence_traits<size_t>()>
-class sequence : public sequence_storage<T, TRAITS>
-{
-	using inherited = sequence_storage<T, TRAITS>;
-	using inherited::data_begin;
-	using inherited::data_end;
-	using inherited::reallocate;
-	using inherited::add_at;
-	using inherited::add_front;
-	using inherited::add_back;
-	using inherited::prepare_for;
+		inline row_iterator() = default;
+		inline row_iterator(const row_iterator<!CONST>& it) requires (CONST) : m_rows(it.m_rows), m_index(it.m_index) {}
 
-public:
+		inline reference operator*() const
+		{
+			return std::apply([&](auto... rows) { return reference(rows[m_index]...); }, m_rows);
+		}
+		inline reference operator[](difference_type n) const { return *(*this + n); }
+
+		inline row_iterator& operator++() { ++m_index; return *this; }
+		inline row_iterator& operator--() { --m_index; return *this; }
+		inline row_iterator operator++(int) { auto it = *this; ++m_index; return it; }
+		inline row_iterator operator--(int) { auto it = *this; --m_index; return it; }
+		inline row_iterator& operator+=(difference_type n) { m_index += n; return *this; }
+		inline row_iterator& operator-=(difference_type n) { m_index -= n; return *this; }
+
+		friend inline row_iterator operator+(row_iterator it, difference_type n) { return it += n; }
+		friend inline row_iterator operator+(difference_type n, row_iterator it) { return it += n; }
+		friend inline row_iterator operator-(row_iterator it, difference_type n) { return it -= n; }
+		friend inline difference_type operator-(const row_iterator& lhs, const row_iterator& rhs) { return lhs.m_index - rhs.m_index; }
+		friend inline bool operator==(const row_iterator& lhs, const row_iterator& rhs) { return lhs.m_index == rhs.m_index; }
+		friend inline auto operator<=>(const row_iterator& lhs, const row_iterator& rhs) { return lhs.m_index <=> rhs.m_index; }
+
+		friend inline std::tuple<field<Ts>&&...> iter_move(const row_iterator& it)
+		{
+			return std::apply([&](auto... rows) { return std::tuple<field<Ts>&&...>(std::move(rows[it.m_index])...); }, it.m_rows);
+		}
+		friend inline void iter_swap(const row_iterator& lhs, const row_iterator& rhs) requires (!CONST)
+		{
+			[&]<size_t... I>(std::index_sequence<I...>)
+			{
+				(std::ranges::swap(std::get<I>(lhs.m_rows)[lhs.m_index], std::get<I>(rhs.m_rows)[rhs.m_index]), ...);
+			}(indices);
+		}
 
-	using value_type = T;
-	using reference = value_type&;
-	using const_reference = const value_type&;
-	using iterator = value_type*;
-	using const_iterator = const value_type*;
-	using reverse_iterator = std::reverse_iterator<iterator>;
-	using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+	private:
 
-	using inherited::size;
-	using inherited::empty;
-	using inherited::capacity;
-	using inherited::capacity_begin;
-	using inherited::capacity_end;
-	using inherited::erase;
-	using inherited::clear;
-	using inherited::free;
+		friend class soa_sequence;
+		friend class row_iterator<!CONST>;
 
-	using traits_type = decltype(TRAITS);
-	static constexpr traits_type traits = TRAITS;
-	using size_type = typename traits_type::size_type;
+		inline row_iterator(std::tuple<field<Ts>*...> rows, difference_type index) : m_rows(rows), m_index(index) {}
 
-	// Variable capacity means that the capacity must grow, and this growth must actually make progress.
-	// Zero capacity is not permitted (although this could be changed if it poses problems in generic contexts).
-	static_assert(traits.capacity > 0,
-				  "Capacity must be greater than 0.");
-	static_assert(traits.increment > 0,
-				  "Linear capacity growth must be greater than 0.");
-	static_assert(traits.factor > 1.0f,
-				  "Exponential capacity growth must be greater than 1.0.");
+		std::tuple<field<Ts>*...> m_rows{};
+		difference_type m_index = 0;
+	};
 
-	// Maintaining elements in the middle of the capacity is more or less useless without the ability to shift.
-	static_assert(traits.location != sequence_location_lits::MIDDLE || std::move_constructible<T>,
-				  "Middle element location requires move-constructible types.");
+private:
 
-	// A fixed capacity of any kind requires that the size type can represent a count up to the fixed capacity size.
-	static_assert(traits.storage == sequence_storage_lits::VARIABLE ||
-				  traits.capacity <= std::numeric_limits<size_type>::max(),
-				  "Size type is insufficient to hold requested capacity.");
+	// A fixed capacity is counted by the size type, and a variable one by size_t (as for sequence).
+	using index_type = std::conditional_t<traits.is_variable(), size_t, size_type>;
 
-	inline sequence() = default;
-	inline sequence(const sequence&) = default;
-	inline sequence(sequence&&) = default;
-	inline sequence(std::initializer_list<value_type> il) : inherited(il) {}
-	template<typename... ARGS>
-	inline sequence(size_type n, ARGS&&... args)
+	static inline columns_type make_columns(const allocator_type& alloc)
 	{
-		if constexpr (traits.is_variable())
-			if (n)
-				reallocate(std::max<size_t>(n, traits.capacity));
-		add(n, std::forward<ARGS>(args)...);
+		if constexpr (is_static)
+			return columns_type();
+		else
+			return columns_type(column_type<Ts>(column_allocator<Ts>(alloc))...);
 	}
-
-	inline sequence& operator=(const sequence&) = default;
-	inline sequence& operator=(sequence&&) = default;
-	inline sequence& operator=(std::initializer_list<value_type> il) { assign(il); return *this; }
-
-	template<typename... ARGS>
-	inline void assign(size_type n, ARGS&&... args)
+	inline columns_type copy_columns() const
 	{
-		clear();
-		if constexpr (traits.is_variable())
-			if (n > capacity())
-				reallocate(std::max<size_t>(n, traits.capacity));
-		add(n, std::forward<ARGS>(args)...);
+		if constexpr (is_static)
+			return columns_type();
+		else
+			return [&]<size_t... I>(std::index_sequence<I...>)
+			{
+				return columns_type(column_type<Ts>(std::get<I>(m_columns).select_allocator())...);
+			}(indices);
 	}
-
-	// This is not sufficient. It is pessimized for BACK and MIDDLE sequences.
-	template<typename IT>
-	inline void assign(IT first, IT last)
+	inline columns_type move_columns()
 	{
-		clear();
-		for (; first != last; ++first)
-			emplace_back(*first);
+		if constexpr (is_static)
+			return columns_type();
+		else
+			return [&]<size_t... I>(std::index_sequence<I...>)
+			{
+				return columns_type(std::move(std::get<I>(m_columns))...);
+			}(indices);
 	}
 
-	inline void assign(std::initializer_list<value_type> il) { assign(il.begin(), il.end()); }
-
-	inline iterator					begin() { return data_begin(); }
-	inline const_iterator			begin() const { return data_begin(); }
-	inline iterator					end() { return data_end(); }
-	inline const_iterator			end() const { return data_end(); }
-	inline reverse_iterator			rbegin() { return reverse_iterator(data_end()); }
-	inline const_reverse_iterator	rbegin() const { return const_reverse_iterator(data_end()); }
-	inline reverse_iterator			rend() { return reverse_iterator(data_begin()); }
-	inline const_reverse_iterator	rend() const { return const_reverse_iterator(data_begin()); }
-
-	inline const_iterator			cbegin() const { return data_begin(); }
-	inline const_iterator			cend() const { return data_end(); }
-	inline const_reverse_iterator	crbegin() const { return const_reverse_iterator(data_end()); }
-	inline const_reverse_iterator	crend() const { return const_reverse_iterator(data_begin()); }
-
-	inline value_type*				data() { return data_begin(); }
-	inline const value_type*		data() const { return data_begin(); }
+	// Calls 'func' with the index of each column (as a std::integral_constant), in order.
+	template<typename FUNC>
+	static inline void for_each_column(FUNC&& func)
+	{
+		[&]<size_t... I>(std::index_sequence<I...>) { (func(std::integral_constant<size_t, I>()), ...); }(indices);
+	}
 
-	inline value_type&				front() { return *data_begin(); }
-	inline const value_type&		front() const { return *data_begin(); }
-	inline value_type&				back() { return *(data_end() - 1); }
-	inline const value_type&		back() const { return *(data_end() - 1); }
+	template<size_t I>
+	inline auto capacity_begin() { return std::get<I>(m_columns).capacity_begin(); }
+	template<size_t I>
+	inline auto capacity_begin() const { return std::get<I>(m_columns).capacity_begin(); }
+	template<size_t I>
+	inline auto data_begin() { return capacity_begin<I>() + m_begin; }
+	template<size_t I>
+	inline auto data_begin() const { return capacity_begin<I>() + m_begin; }
+	template<size_t I>
+	inline auto data_end() { return data_begin<I>() + m_size; }
+	template<size_t I>
+	inline auto data_end() const { return data_begin<I>() + m_size; }
 
-	inline value_type& at(size_t index)
+	inline std::tuple<Ts*...> row_pointers()
 	{
-		if (index >= size()) throw std::out_of_range(std::format(OUT_OF_RANGE_ERROR, index));
-		return *(data_begin() + index);
+		return [&]<size_t... I>(std::index_sequence<I...>) { return std::tuple<Ts*...>(data_begin<I>()...); }(indices);
 	}
-	inline const value_type& at(size_t index) const
+	inline std::tuple<const Ts*...> row_pointers() const
 	{
-		if (index >= size()) throw std::out_of_range(std::format(OUT_OF_RANGE_ERROR, index));
-		return *(data_begin() + index);
+		return [&]<size_t... I>(std::index_sequence<I...>) { return std::tuple<const Ts*...>(data_begin<I>()...); }(indices);
 	}
-	inline value_type& operator[](size_t index) & { return *(data_begin() + index); }
-	inline const value_type& operator[](size_t index) const && { return *(data_begin() + index); }
 
-	inline void reserve(size_t new_capacity)
+	inline void copy_from(const soa_sequence& rhs)
 	{
-		if (!traits.is_variable() || new_capacity > capacity())
-			reallocate(new_capacity);
+		reserve_exactly(rhs.m_size);
+		insert_rows(0, rhs.m_size, [&](auto I, auto gap) { uninitialized_copy_data(rhs.data_begin<I>(), rhs.data_end<I>(), gap); });
 	}
-	inline void shrink_to_fit()
+	inline void move_from(soa_sequence& rhs)
 	{
-		if (auto current_size = size(); current_size == 0)
-			free();
-		else if (traits.is_variable() && current_size < capacity())
-			reallocate(current_size);
+		reserve_exactly(rhs.m_size);
+		insert_rows(0, rhs.m_size, [&](auto I, auto gap) { uninitialized_move_data(rhs.data_begin<I>(), rhs.data_end<I>(), gap); });
 	}
-	template<typename... ARGS>
-	inline void resize(size_type new_size, ARGS&&... args)
+
+	// Makes sure that the capacity will hold 'n' rows, without growing it any more than that (as for sequence).
+	inline void reserve_exactly(size_t n)
 	{
-		auto old_size = size();
+		if (n > capacity())
+			reallocate(std::max<size_t>(n, traits.capacity));
+	}
 
-		if (new_size < old_size)
-			erase(data_end() - (old_size - new_size), data_end());
-		else if (new_size > old_size)
-		{
-			if (new_size > capacity())
-				reallocate(std::max<size_t>(new_size, traits.capacity));
-			add(new_size - old_size, std::forward<ARGS>(args)...);
-		}
+	inline size_t grown_capacity(size_t new_size) const
+	{
+		auto grown = traits.grow(capacity(), row_size);
+		if constexpr (traits.growth == sequence_growth_lits::CUSTOM)
+			if (grown <= capacity())
+				throw std::bad_alloc();
+		return std::max<size_t>(grown, new_size);
 	}
 
-	template< class... ARGS >
-	inline iterator emplace(const_iterator cpos, ARGS&&... args)
+	// Moves the rows to new columns of (at least) 'new_capacity' rows, leaving an uninitialized gap of 'count' rows
+	// before row 'index' (which is counted in the size). All of the new columns are allocated before any field
+	// is moved, and moving cannot fail, so if an allocation fails nothing has changed. A STATIC capacity cannot
+	// change, and a FIXED one is allocated once.
+
+	inline void reallocate(size_t new_capacity, size_t index = 0, size_t count = 0)
 	{
-		if (auto old_capacity = capacity(); size() == old_capacity)
+		if constexpr (is_static)
+			throw std::bad_alloc();
+		else
 		{
-			size_t index = cpos - data_begin();
-			reallocate(traits.grow(old_capacity));
-			cpos = data_begin() + index;
+			if constexpr (!traits.is_variable())
+			{
+				if (capacity() != 0 || new_capacity > traits.capacity)
+					throw std::bad_alloc();
+				new_capacity = traits.capacity;
+			}
+			auto new_columns = [&]<size_t... I>(std::index_sequence<I...>)
+			{
+				return columns_type(column_type<Ts>(new_capacity, std::get<I>(m_columns).get_allocator())...);
+			}(indices);
+			auto new_size = m_size + count;
+			auto new_begin = traits.front_gap(std::apply([](auto&... columns) { return std::min({ columns.capacity()... }); }, new_columns),
+											  new_size, gap_unit);
+
+			for_each_column([&](auto I)
+			{
+				uninitialized_relocate(data_begin<I>(), data_begin<I>() + index, data_end<I>(),
+									   std::get<I>(new_columns).capacity_begin() + new_begin, count);
+				std::get<I>(m_columns).swap(std::get<I>(new_columns));
+			});
+			m_begin = static_cast<index_type>(new_begin);
+			m_size = static_cast<index_type>(new_size);
 		}
-		return add_at(const_cast<iterator>(cpos), std::forward<ARGS>(args)...);
-	}
-	template<typename... ARGS>
-	inline void emplace_front(ARGS&&... args)
-	{
-		if (auto old_capacity = capacity(); size() == old_capacity)
-			reallocate(traits.grow(old_capacity));
-		add_front(std::forward<ARGS>(args)...);
 	}
-	template<typename... ARGS>
-	inline void emplace_back(ARGS&&... args)
+
+	// Opens an uninitialized gap of 'count' rows before row 'index' (reallocating if necessary) and calls
+	// 'fill' with each column index and the start of the gap in that column, to construct the fields there. If
+	// 'fill' throws it must destroy anything it constructed in that column (as the uninitialized memory algorithms
+	// do); the fields constructed in the other columns are then destroyed and the gap is closed again.
+
+	template<typename FUNC>
+	inline void insert_rows(size_t index, size_t count, FUNC fill)
 	{
-		if (auto old_capacity = capacity(); size() == old_capacity)
-			reallocate(traits.grow(old_capacity));
-		add_back(std::forward<ARGS>(args)...);
-	}
+		if (count == 0)
+			return;
+		if (auto new_size = m_size + count; new_size > capacity())
+			reallocate(grown_capacity(new_size), index, count);
+		else
+			open_rows(index, count);
 
-	inline iterator insert(const_iterator cpos, const_reference e) { return emplace(cpos, e); }
-	inline void push_front(const_reference e) { emplace_front(e); }
-	inline void push_back(const_reference e) { emplace_back(e); }
+		size_t filled = 0;
+		try
+		{
+			for_each_column([&](auto I)
+			{
+				fill(I, data_begin<I>() + index);
+				++filled;
+			});
+		}
+		catch (...)
+		{
+			for_each_column([&](auto I)
+			{
+				if (I < filled)
+					destroy_data(data_begin<I>() + index, data_begin<I>() + index + count);
+			});
+			close_rows(index, count);
+			throw;
+		}
+	}
 
-private:
+	// Opens and closes an uninitialized gap of 'count' rows before row 'index' in every column (see open_gap and
+	// close_gap). The rows before the gap move toward the front for BACK location, and for MIDDLE location the
+	// shorter side moves if there is room for it (see middle_gap_begin).
 
-	template<typename... ARGS>
-	inline void add(size_t count, ARGS&&... args)
+	inline void open_rows(size_t index, size_t count)
 	{
-		if (empty())
-			prepare_for(count);
+		size_t new_begin = m_begin;
+		if constexpr (traits.location == sequence_location_lits::BACK)
+			new_begin -= count;
+		else if constexpr (traits.location == sequence_location_lits::MIDDLE)
+		{
+			auto first = capacity_begin<0>();
+			new_begin = middle_gap_begin(first, first + capacity(), first + m_begin, first + m_begin + m_size,
+										 first + m_begin + index, count, traits.front_bias, traits, gap_unit) - first;
+		}
+		for_each_column([&](auto I)
+		{
+			auto first = capacity_begin<I>();
+			open_gap(data_begin<I>(), data_end<I>(), data_begin<I>() + index, first + new_begin, count);
+		});
+		m_begin = static_cast<index_type>(new_begin);
+		m_size = static_cast<index_type>(m_size + count);
+	}
+	inline void close_rows(size_t index, size_t count)
+	{
+		size_t new_begin = m_begin;
+		if constexpr (traits.location == sequence_location_lits::BACK)
+			new_begin += count;
+		else if constexpr (traits.location == sequence_location_lits::MIDDLE)
+		{
+			if (index < m_size - index - count)
+				new_begin += count;
+		}
+		for_each_column([&](auto I)
+		{
+			auto first = capacity_begin<I>();
+			close_gap(data_begin<I>(), data_end<I>(), data_begin<I>() + index, first + new_begin, count);
+		});
+		m_begin = static_cast<index_type>(new_begin);
+		m_size = static_cast<index_type>(m_size - count);
+	}
 
-		while (count--)
-			if constexpr (traits.location == sequence_location_lits::BACK)
-				add_front(std::forward<ARGS>(args)...);
-			else
-				add_back(std::forward<ARGS>(args)...);
+	inline void destroy_rows(size_t index, size_t count)
+	{
+		for_each_column([&](auto I) { destroy_data(data_begin<I>() + index, data_begin<I>() + index + count); });
 	}
 
-	static constexpr auto OUT_OF_RANGE_ERROR = "invalid sequence index {}";
+	columns_type m_columns;
+	index_type m_begin = 0;				// The position of the first row in each column.
+	index_type m_size = 0;
+
+	static constexpr auto OUT_OF_RANGE_ERROR = "invalid soa_sequence index {}";
 };
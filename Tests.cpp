@@ -0,0 +1,843 @@
+#if __has_include(<sys/uio.h>)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+import sequence;
+import life;
+
+import std;
+
+// Tests - Checks the element operations done by the sequence operations against the complexity claims made in
+// README.md, and the placement guarantees made there. The elements are life objects, which count every
+// construction, assignment and destruction (see life_meter). Each failed check is reported, and the exit status
+// is the number of failures, so that the post-build step which runs the tests fails the build.
+
+int failures = 0;
+
+// expect - Checks the operations counted by 'meter' against 'want', and resets the meter.
+
+void expect(life_meter& meter, const life_counts& want, std::string_view what,
+	std::source_location where = std::source_location::current())
+{
+	auto got = meter();
+	meter.reset();
+	if (got == want)
+		return;
+
+	++failures;
+	std::println("{}({}): {}", where.file_name(), where.line(), what);
+	std::println("\twanted {} constructed, {} copied, {} moved, {} copy assigned, {} move assigned, {} destroyed",
+		want.constructions, want.copies, want.moves, want.copy_assignments, want.move_assignments, want.destructions);
+	std::println("\tgot    {} constructed, {} copied, {} moved, {} copy assigned, {} move assigned, {} destroyed",
+		got.constructions, got.copies, got.moves, got.copy_assignments, got.move_assignments, got.destructions);
+}
+
+// check - Checks a condition which is not an operation count.
+
+void check(bool ok, std::string_view what, std::source_location where = std::source_location::current())
+{
+	if (ok)
+		return;
+
+	++failures;
+	std::println("{}({}): {}", where.file_name(), where.line(), what);
+}
+
+using St = sequence_storage_lits;
+using Loc = sequence_location_lits;
+
+// Every configuration has room for 'room' elements without reallocating (the buffer, for BUFFERED storage), and
+// the tests start from sequences of 'n' elements.
+
+constexpr size_t room = 8;
+constexpr int n = 4;
+
+template<St STORAGE, Loc LOCATION>
+using life_sequence = sequence<life, sequence_traits{ .storage = STORAGE, .location = LOCATION, .capacity = room }>;
+
+// make - Returns a sequence of 'count' elements, with room for 'room' elements. MIDDLE elements are added at both
+// ends, so that there is room left at both.
+
+template<typename S>
+S make(int count = n)
+{
+	S s;
+	if constexpr (S::traits.storage == St::VARIABLE)
+		s.reserve(room);
+	for (int i = 0; i < count; ++i)
+	{
+		if (S::traits.location == Loc::MIDDLE && i % 2)
+			s.emplace_front(i);
+		else
+			s.emplace_back(i);
+	}
+	return s;
+}
+
+// test_ends - Adding and removing single elements at the ends.
+
+template<St STORAGE, Loc LOCATION>
+void test_ends()
+{
+	using S = life_sequence<STORAGE, LOCATION>;
+	constexpr bool front_room = LOCATION != Loc::FRONT;
+	constexpr bool back_room = LOCATION != Loc::BACK;
+
+	auto s = make<S>();
+	life_meter meter;
+
+	// With room at the end being added to, this is exactly one construction.
+	if constexpr (back_room)
+	{
+		s.emplace_back(10);
+		expect(meter, { .constructions = 1 }, "emplace_back with room at the back");
+	}
+	if constexpr (front_room)
+	{
+		s.emplace_front(11);
+		expect(meter, { .constructions = 1 }, "emplace_front with room at the front");
+	}
+
+	// Adding at the far end shifts every element once (see front_add_at and back_add_at), and then moves the new
+	// element (which is constructed as a temporary) into place. Nothing is copied.
+	if constexpr (!back_room)
+	{
+		auto size = int(s.size());
+		s.emplace_back(12);
+		auto counts = meter();
+		meter.reset();
+		check(counts.constructions == 1 && counts.copies == 0 && counts.copy_assignments == 0 &&
+			counts.moves + counts.move_assignments == size + 1 && counts.destructions == 1, "BACK emplace_back");
+	}
+	if constexpr (!front_room)
+	{
+		auto size = int(s.size());
+		s.emplace_front(13);
+		auto counts = meter();
+		meter.reset();
+		check(counts.constructions == 1 && counts.copies == 0 && counts.copy_assignments == 0 &&
+			counts.moves + counts.move_assignments == size + 1 && counts.destructions == 1, "FRONT emplace_front");
+	}
+
+	// Removing at an end which can move is exactly one destruction. Removing at the end which cannot shifts the
+	// remaining elements.
+	if constexpr (back_room)
+	{
+		s.pop_back();
+		expect(meter, { .destructions = 1 }, "pop_back");
+	}
+	if constexpr (front_room)
+	{
+		s.pop_front();
+		expect(meter, { .destructions = 1 }, "pop_front");
+	}
+	if constexpr (!back_room)
+	{
+		auto size = int(s.size());
+		s.pop_back();
+		expect(meter, { .move_assignments = size - 1, .destructions = 1 }, "BACK pop_back");
+	}
+	if constexpr (!front_room)
+	{
+		auto size = int(s.size());
+		s.pop_front();
+		expect(meter, { .move_assignments = size - 1, .destructions = 1 }, "FRONT pop_front");
+	}
+}
+
+// test_insert - Inserting or erasing next to the front shifts only the element in front of the position, except
+// for FRONT location, which shifts all of the elements behind it.
+
+template<St STORAGE, Loc LOCATION>
+void test_insert()
+{
+	using S = life_sequence<STORAGE, LOCATION>;
+	constexpr int shifted = LOCATION == Loc::FRONT ? n - 1 : 1;
+
+	auto s = make<S>();
+	life_meter meter;
+
+	s.emplace(s.begin() + 1, 20);
+	auto counts = meter();
+	meter.reset();
+	check(counts.constructions == 1 && counts.copies == 0 && counts.copy_assignments == 0 &&
+		counts.moves + counts.move_assignments == shifted + 1 && counts.destructions == 1, "emplace next to the front");
+
+	s.erase(s.begin() + 1);
+	counts = meter();
+	meter.reset();
+	check(counts.constructions == 0 && counts.copies == 0 && counts.copy_assignments == 0 &&
+		counts.moves + counts.move_assignments == shifted && counts.destructions == 1, "erase next to the front");
+}
+
+// test_copy_move - Copy and move construction, assignment and swap.
+
+template<St STORAGE, Loc LOCATION>
+void test_copy_move()
+{
+	using S = life_sequence<STORAGE, LOCATION>;
+	constexpr bool moves_capacity = STORAGE == St::FIXED || STORAGE == St::VARIABLE;
+
+	auto a = make<S>(n);
+	auto b = make<S>(n - 1);
+	life_meter meter;
+
+	// Copying is linear in the new elements.
+	{
+		S c(a);
+		expect(meter, { .copies = n }, "copy construction");
+	}
+	meter.reset();
+
+	// Copy assignment is linear in the old + new elements.
+	{
+		auto c = make<S>(n - 1);
+		meter.reset();
+		c = a;
+		auto counts = meter();
+		meter.reset();
+		check(counts.moves == 0 && counts.move_assignments == 0 && counts.copies + counts.copy_assignments == n &&
+			counts.destructions <= n - 1, "copy assignment");
+	}
+	meter.reset();
+
+	// A moved capacity moves no elements. A fixed capacity moves each element once.
+	{
+		S c(std::move(b));
+		if constexpr (moves_capacity)
+			expect(meter, {}, "move construction");
+		else
+		{
+			auto counts = meter();
+			meter.reset();
+			check(counts.moves == n - 1 && counts.copies == 0 && counts.copy_assignments == 0 && counts.move_assignments == 0,
+				"move construction");
+		}
+	}
+	meter.reset();
+
+	// Move assignment touches each old element at most once (to destroy it, which may happen when the moved-from
+	// sequence is destroyed). A moved capacity moves none of the new elements, STATIC storage moves each of them once.
+	{
+		auto c = make<S>(n - 1);
+		auto d = make<S>(n);
+		meter.reset();
+		c = std::move(d);
+		auto counts = meter();
+		meter.reset();
+		if constexpr (moves_capacity)
+			check(counts.operations() == counts.destructions && counts.destructions <= n - 1, "move assignment");
+		else
+			check(counts.copies == 0 && counts.copy_assignments == 0 && counts.moves + counts.move_assignments == n &&
+				counts.destructions <= 2 * n - 1, "STATIC move assignment");
+	}
+	meter.reset();
+
+	// O(1) swap moves nothing.
+	if constexpr (moves_capacity)
+	{
+		auto c = make<S>(n - 1);
+		meter.reset();
+		a.swap(c);
+		expect(meter, {}, "swap");
+	}
+}
+
+// test_buffered - BUFFERED move assignment depends on where the elements of each side are. The elements are
+// heap-allocated once there are more of them than the buffer holds.
+
+template<Loc LOCATION>
+void test_buffered()
+{
+	using S = life_sequence<St::BUFFERED, LOCATION>;
+	constexpr int big = int(room) + 2;
+	life_meter meter;
+
+	// Both heap-allocated: the capacity is moved, so only the old elements are touched (O(1) for the new ones).
+	{
+		auto a = make<S>(big);
+		auto b = make<S>(big + 1);
+		meter.reset();
+		a = std::move(b);
+		expect(meter, { .destructions = big }, "BUFFERED move assignment, both heap-allocated");
+		a.clear();
+		auto c = make<S>(big);
+		meter.reset();
+		a = std::move(c);
+		expect(meter, {}, "BUFFERED move assignment, both heap-allocated, no old elements");
+	}
+	meter.reset();
+
+	// LHS buffered, RHS heap-allocated: the capacity is moved.
+	{
+		auto a = make<S>(n);
+		auto b = make<S>(big);
+		meter.reset();
+		a = std::move(b);
+		expect(meter, { .destructions = n }, "BUFFERED move assignment, LHS buffered, RHS heap-allocated");
+	}
+	meter.reset();
+
+	// RHS buffered: each new element is moved once, whichever side the LHS is.
+	{
+		auto a = make<S>(n);
+		auto b = make<S>(n - 1);
+		meter.reset();
+		a = std::move(b);
+		auto counts = meter();
+		check(counts.copies == 0 && counts.copy_assignments == 0 && counts.moves + counts.move_assignments == n - 1,
+			"BUFFERED move assignment, both buffered");
+		auto c = make<S>(big);
+		auto d = make<S>(n);
+		meter.reset();
+		c = std::move(d);
+		counts = meter();
+		check(counts.copies == 0 && counts.copy_assignments == 0 && counts.moves + counts.move_assignments == n,
+			"BUFFERED move assignment, LHS heap-allocated, RHS buffered");
+	}
+	meter.reset();
+
+	// Two heap-allocated sequences swap in O(1).
+	{
+		auto a = make<S>(big);
+		auto b = make<S>(big + 1);
+		meter.reset();
+		a.swap(b);
+		expect(meter, {}, "BUFFERED swap, both heap-allocated");
+	}
+}
+
+// test_growth - Reallocation moves each element once, and recentering shifts each element once. Neither copies.
+
+template<St STORAGE, Loc LOCATION>
+void test_growth()
+{
+	using S = life_sequence<STORAGE, LOCATION>;
+
+	if constexpr (STORAGE == St::VARIABLE)
+	{
+		auto s = make<S>(int(room));
+		life_meter meter;
+		s.reserve(2 * room);
+		expect(meter, { .moves = int(room), .destructions = int(room) }, "reserve");
+	}
+
+	// A MIDDLE sequence which runs out of room at one end is recentered without reallocating.
+	if constexpr (LOCATION == Loc::MIDDLE)
+	{
+		auto s = make<S>(0);
+		while (s.size() < room / 2)
+			s.emplace_front(0);
+		auto capacity = s.capacity();
+		life_meter meter;
+		s.emplace_front(1);
+		auto counts = meter();
+		meter.reset();
+		check(s.capacity() == capacity, "recentering does not reallocate");
+		check(counts.constructions == 1 && counts.copies == 0 && counts.copy_assignments == 0 &&
+			counts.moves + counts.move_assignments <= int(room) / 2, "recentering shifts each element at most once");
+	}
+
+	// A CIRCULAR sequence used as a FIFO never shifts anything.
+	if constexpr (LOCATION == Loc::CIRCULAR)
+	{
+		auto s = make<S>(int(room) - 1);
+		life_meter meter;
+		for (int i = 0; i < int(room) * 3; ++i)
+		{
+			s.emplace_back(i);
+			s.pop_front();
+		}
+		expect(meter, { .constructions = int(room) * 3, .destructions = int(room) * 3 }, "CIRCULAR push_back and pop_front");
+	}
+}
+
+// test_segmented - SEGMENTED growth adds segments, so the elements already in the sequence never move.
+
+void test_segmented()
+{
+	using S = life_sequence<St::SEGMENTED, Loc::FRONT>;
+
+	S s;
+	life_meter meter;
+	for (int i = 0; i < int(room) * 5; ++i)
+		s.emplace_back(i);
+	expect(meter, { .constructions = int(room) * 5 }, "SEGMENTED growth");
+}
+
+template<St STORAGE, Loc LOCATION>
+void test_configuration()
+{
+	test_ends<STORAGE, LOCATION>();
+	test_insert<STORAGE, LOCATION>();
+	test_copy_move<STORAGE, LOCATION>();
+	test_growth<STORAGE, LOCATION>();
+	if constexpr (STORAGE == St::BUFFERED)
+		test_buffered<LOCATION>();
+}
+
+template<St STORAGE>
+void test_storage()
+{
+	test_configuration<STORAGE, Loc::FRONT>();
+	test_configuration<STORAGE, Loc::BACK>();
+	test_configuration<STORAGE, Loc::MIDDLE>();
+	if constexpr (STORAGE != St::BUFFERED)
+		test_configuration<STORAGE, Loc::CIRCULAR>();
+}
+
+// test_alignment - MIDDLE elements are placed at an aligned position whenever they are placed in a capacity: the
+// first elements added to an empty sequence, and the existing elements when they are recentered or reallocated.
+// Adding at the front otherwise moves the start of the data by the number of new elements. The free space is
+// still split according to the front bias, to within the granularity of the alignment (8 doubles).
+
+template<St STORAGE>
+void test_alignment()
+{
+	using T = sequence<double, sequence_traits{ .storage = STORAGE, .location = Loc::MIDDLE, .capacity = 40, .alignment = 64 }>;
+	struct S : T
+	{
+		// The free space at each end before the last element was added at the front or the back.
+		bool balanced(bool front) const
+		{
+			auto fg = double(this->data() - this->capacity_begin()) + front;
+			auto bg = double(this->capacity_end() - (this->data() + this->size())) + !front;
+			return std::abs(fg - T::traits.front_bias * (fg + bg)) <= 8;
+		}
+	};
+	auto aligned = [](const double* p) { return reinterpret_cast<std::uintptr_t>(p) % 64 == 0; };
+	double values[3] = { 1, 2, 3 };
+
+	S a;
+	a.push_back(0);
+	check(aligned(a.data()), "MIDDLE push_back to an empty sequence is aligned");
+	for (int i = 0; i < 30; ++i)
+	{
+		auto old = a.data();
+		a.push_back(i);
+		if (a.data() != old)
+		{
+			check(aligned(a.data()), "MIDDLE push_back which recenters or reallocates is aligned");
+			check(a.balanced(false), "MIDDLE push_back which recenters or reallocates splits the free space");
+		}
+	}
+
+	S b;
+	b.push_front(0);
+	check(aligned(b.data() + 1), "MIDDLE push_front to an empty sequence is next to an aligned position");
+	for (int i = 0; i < 30; ++i)
+	{
+		auto old = b.data();
+		b.push_front(i);
+		if (b.data() != old - 1)
+		{
+			check(aligned(b.data() + 1), "MIDDLE push_front which recenters or reallocates leaves the old elements aligned");
+			check(b.balanced(true), "MIDDLE push_front which recenters or reallocates splits the free space");
+		}
+	}
+
+	S c;
+	c.insert(c.begin(), values, values + 3);
+	check(aligned(c.data()), "MIDDLE insert to an empty sequence is aligned");
+	for (int i = 0; i < 8; ++i)
+	{
+		auto old = c.data();
+		c.insert(c.begin() + 1, values, values + 3);
+		if (c.data() != old && c.data() != old - 3)
+			check(aligned(c.data()), "MIDDLE insert which recenters or reallocates is aligned");
+	}
+}
+
+// test_soa_alignment - The same holds for every column of a MIDDLE soa_sequence, whose rows are placed in units of
+// the greatest common divisor of the field sizes.
+
+void test_soa_alignment()
+{
+	using S = soa_sequence<std::tuple<double, float>, sequence_traits{ .location = Loc::MIDDLE, .alignment = 32 }>;
+	auto aligned = [](const S& s)
+	{
+		return reinterpret_cast<std::uintptr_t>(s.column<0>().data()) % 32 == 0 &&
+			reinterpret_cast<std::uintptr_t>(s.column<1>().data()) % 32 == 0;
+	};
+
+	S s;
+	for (int i = 0; i < 40; ++i)
+	{
+		auto old = s.column<0>().data();
+		s.push_back({ i, float(i) });
+		if (s.column<0>().data() != old)
+			check(aligned(s), "MIDDLE soa_sequence push_back which places the rows is aligned");
+	}
+	for (int i = 0; i < 40; ++i)
+	{
+		auto old = s.column<0>().data();
+		s.insert(s.cbegin() + 1, { i, float(i) });
+		if (s.column<0>().data() != old && s.column<0>().data() != old - 1)
+			check(aligned(s), "MIDDLE soa_sequence insert which places the rows is aligned");
+	}
+}
+
+// test_pool_threads - pool_allocator blocks go back to the pool of the thread which allocated them, so a thread
+// which creates sequences for another thread to destroy keeps reusing the same blocks. The blocks of a thread which
+// has exited are released once they have all been freed.
+
+void test_pool_threads()
+{
+	using S = sequence<int, sequence_traits<std::uint16_t>{ .storage = St::FIXED, .capacity = 30 }, pool_allocator<int>>;
+	constexpr int count = 10000;
+	constexpr int rounds = 10;
+
+	std::vector<S> made;
+	std::set<const int*> blocks;
+	for (int round = 0; round < rounds; ++round)
+	{
+		std::thread([&]{ made.clear(); }).join();
+		for (int i = 0; i < count; ++i)
+		{
+			made.emplace_back(1, i);
+			blocks.insert(made.back().data());
+		}
+	}
+	check(blocks.size() < 2 * count, "pool_allocator reuses the blocks freed by another thread");
+	std::thread([&]{ made.clear(); }).join();
+
+	std::thread([&]
+	{
+		for (int i = 0; i < count; ++i)
+			made.emplace_back(1, i);
+	}).join();
+	check(std::ranges::all_of(made, [](const S& s) { return s.size() == 1; }), "pool_allocator blocks outlive their thread");
+	made.clear();
+}
+
+// test_remove - remove_if and unique compact the kept elements in one pass and keep their order. FRONT and BACK
+// sequences compact toward the end the location keeps them at, and MIDDLE sequences toward whichever end shifts
+// fewer elements, so only the kept elements beyond the first removed one (or before the last) are moved, each of
+// them once. remove_if calls 'pred' once for each element. The life elements take the element by element path,
+// and the int elements the path which shifts runs of kept elements with memmove.
+
+template<typename T, Loc LOCATION>
+void test_remove(std::vector<int> removed)
+{
+	using S = sequence<T, sequence_traits{ .storage = St::VARIABLE, .location = LOCATION }>;
+	constexpr int size = 16;
+	auto what = std::format("{} {} removing {}", std::is_same_v<T, life> ? "life" : "int",
+		LOCATION == Loc::FRONT ? "FRONT" : LOCATION == Loc::BACK ? "BACK" : "MIDDLE", removed.size());
+	auto is_removed = [&](int i) { return std::ranges::find(removed, i) != removed.end(); };
+	auto values = [](const S& s) { return std::vector<int>(s.begin(), s.end()); };
+
+	std::vector<int> kept;
+	for (int i = 0; i < size; ++i)
+		if (!is_removed(i))
+			kept.push_back(i);
+	auto after = std::ranges::count_if(kept, [&](int i) { return i > removed.front(); });
+	auto before = std::ranges::count_if(kept, [&](int i) { return i < removed.back(); });
+	auto shifted = int(LOCATION == Loc::FRONT ? after : LOCATION == Loc::BACK ? before : std::min(after, before));
+
+	// unique removes the elements which equal the one in front of them, so those are given the same value.
+	S r, u;
+	for (int i = 0; i < size; ++i)
+	{
+		r.emplace_back(i);
+		u.emplace_back(is_removed(i) ? int(u.back()) : i);
+	}
+
+	life_meter meter;
+	int calls = 0;
+	auto count = r.remove_if([&](const T& e) { ++calls; return is_removed(int(e)); });
+	if constexpr (std::is_same_v<T, life>)
+		expect(meter, { .move_assignments = shifted, .destructions = int(removed.size()) }, what + " remove_if moves");
+	check(count == removed.size() && values(r) == kept, what + " remove_if keeps the order");
+	check(calls == size, what + " remove_if calls the predicate once for each element");
+
+	count = u.unique();
+	if constexpr (std::is_same_v<T, life>)
+		expect(meter, { .move_assignments = shifted, .destructions = int(removed.size()) }, what + " unique moves");
+	check(count == removed.size() && values(u) == kept, what + " unique keeps the order");
+}
+
+template<typename T>
+void test_removals()
+{
+	// Scattered removals in the back half and in the front half, and a single one. The first element is never
+	// removed, as unique always keeps it.
+	for (auto removed : { std::vector{ 9, 12, 13, 15 }, std::vector{ 1, 2, 4, 7 }, std::vector{ 5 } })
+	{
+		test_remove<T, Loc::FRONT>(removed);
+		test_remove<T, Loc::BACK>(removed);
+		test_remove<T, Loc::MIDDLE>(removed);
+	}
+}
+
+// test_concurrent_ends - A concurrent_sequence is full after 'capacity' pushes and empty after as many pops, at
+// every position. The rounds leave different numbers of elements behind, so the full and empty queues are found
+// across many wraps of the slots (and of the SPSC positions, which wrap at twice the capacity).
+
+template<concurrent_sequence_lits MODE, St STORAGE>
+void test_concurrent_ends()
+{
+	using Q = concurrent_sequence<int, sequence_traits<std::uint32_t>{ .storage = STORAGE, .capacity = 8 }, MODE>;
+	constexpr int cap = int(Q::capacity());
+
+	Q q;
+	int pushed = 0, popped = 0, value;
+	bool full = true, ordered = true;
+	for (int round = 0; round < 5 * cap; ++round)
+	{
+		auto size = int(q.size());
+		auto first = pushed;
+		while (q.try_push(pushed))
+			++pushed;
+		full = full && pushed - first == cap - size && q.size() == cap;
+
+		for (int i = 0; i <= round % cap; ++i)
+		{
+			ordered = ordered && q.try_pop(value) && value == popped;
+			++popped;
+		}
+	}
+	while (q.try_pop(value))
+		ordered = ordered && value == popped++;
+	check(full, "concurrent_sequence try_push fills exactly the capacity");
+	check(ordered && popped == pushed && q.empty(), "concurrent_sequence try_pop empties the queue in order");
+}
+
+// test_concurrent_producers - In MPSC mode several threads push at once. Every value arrives exactly once, and the
+// values of each producer arrive in the order it pushed them.
+
+void test_concurrent_producers()
+{
+	using Q = concurrent_sequence<std::pair<int, int>, sequence_traits<std::uint32_t>{ .storage = St::FIXED, .capacity = 64 },
+		concurrent_sequence_lits::MPSC>;
+	constexpr int producers = 4;
+	constexpr int count = 100000;
+
+	Q q;
+	std::vector<std::jthread> threads;
+	for (int p = 0; p < producers; ++p)
+	{
+		threads.emplace_back([&q, p]
+		{
+			for (int i = 0; i < count; ++i)
+				while (!q.try_push({ p, i }))
+					std::this_thread::yield();
+		});
+	}
+
+	std::vector<int> next(producers);
+	bool ordered = true;
+	for (int received = 0; received < producers * count;)
+	{
+		std::pair<int, int> value;
+		if (!q.try_pop(value))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		ordered = ordered && value.second == next[value.first]++;
+		++received;
+	}
+	threads.clear();
+	check(ordered && std::ranges::all_of(next, [](int n) { return n == count; }) && q.empty(),
+		"MPSC concurrent_sequence delivers every value once, in the order of each producer");
+}
+
+// test_concurrent_destroy - The elements left in a concurrent_sequence are destroyed with it.
+
+template<concurrent_sequence_lits MODE>
+void test_concurrent_destroy()
+{
+	using Q = concurrent_sequence<life, sequence_traits<std::uint32_t>{ .storage = St::STATIC, .capacity = 8 }, MODE>;
+
+	life_meter meter;
+	{
+		Q q;
+		for (int i = 0; i < 6; ++i)
+			q.try_emplace(i);
+		life e;
+		q.try_pop(e);
+		q.try_pop(e);
+		meter.reset();
+	}
+	expect(meter, { .destructions = 5 }, "concurrent_sequence destroys the elements left in it");
+}
+
+// test_serialize - A sequence written to a stream or a file descriptor is read back whole, whatever pieces its
+// elements are in. Reading elements of another size fails, and so does reading elements which were cut short,
+// which leaves the sequence empty.
+
+template<typename S>
+void test_serialize(std::string_view what)
+{
+	using other = sequence<std::int16_t, sequence_traits{}>;
+	constexpr auto cut = sizeof(sequence_header) + 5 * sizeof(int);
+
+	// The CIRCULAR elements wrap around the end of the capacity.
+	S s;
+	for (int i = 0; i < 6; ++i)
+		s.push_back(i);
+	for (int i = 0; i < 3; ++i)
+		s.pop_front();
+	for (int i = 6; i < 18; ++i)
+		s.push_back(i);
+
+	std::stringstream stream;
+	s.write_to(stream);
+	S t{ 99 };
+	t.read_from(stream);
+	check(stream.good() && std::ranges::equal(s, t), std::format("{} stream round trip", what));
+
+	other u;
+	std::istringstream wrong(stream.str());
+	u.read_from(wrong);
+	check(wrong.fail(), std::format("{} stream read of another element size fails", what));
+
+	std::istringstream truncated(stream.str().substr(0, cut));
+	t.read_from(truncated);
+	check(truncated.fail() && t.empty(), std::format("{} truncated stream read leaves the sequence empty", what));
+
+#if __has_include(<sys/uio.h>)
+	auto path = (std::filesystem::temp_directory_path() / "sequence_tests.dat").string();
+	int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	auto threw = [&](auto& sequence)
+	{
+		::lseek(fd, 0, SEEK_SET);
+		try
+		{
+			sequence.read_from(fd);
+		}
+		catch (const std::system_error&)
+		{
+			return true;
+		}
+		return false;
+	};
+
+	s.write_to(fd);
+	s.write_to(fd);
+	::lseek(fd, 0, SEEK_SET);
+	t = { 99 };
+	check(t.read_from(fd) && std::ranges::equal(s, t), std::format("{} file round trip", what));
+	t = { 99 };
+	check(t.read_from(fd) && std::ranges::equal(s, t), std::format("{} second file round trip", what));
+	check(!t.read_from(fd), std::format("{} file read at the end returns false", what));
+
+	check(threw(u), std::format("{} file read of another element size throws", what));
+
+	::ftruncate(fd, cut);
+	t = { 99 };
+	check(threw(t) && t.empty(), std::format("{} truncated file read leaves the sequence empty", what));
+
+	::close(fd);
+	std::filesystem::remove(path);
+#endif
+}
+
+#if __has_include(<sys/mman.h>)
+
+// test_mapped - A file holds the elements of the MAPPED sequence which last used it. Assigning and shrinking must
+// not map the file a second time (which throws), and must leave the file holding the right elements.
+
+template<Loc LOCATION>
+void test_mapped()
+{
+	using S = mapped_sequence<int, sequence_traits{ .storage = St::MAPPED, .location = LOCATION }>;
+	using A = mapped_allocator<int>;
+	auto path = (std::filesystem::temp_directory_path() / "sequence_tests.bin").string();
+	auto contents = [&]{ S s(A(path.c_str())); return std::vector<int>(s.begin(), s.end()); };
+	auto attempt = [&](std::string_view what, auto test)
+	{
+		std::filesystem::remove(path);
+		try
+		{
+			test();
+		}
+		catch (const std::exception& e)
+		{
+			check(false, std::format("{} threw {}", what, e.what()));
+		}
+	};
+
+	// Copy assignment keeps the file, which grows to hold the new elements.
+	attempt("MAPPED copy assignment", [&]
+	{
+		{
+			S s(A(path.c_str()));
+			s = { 1, 2, 3 };
+			S t{ 4, 5, 6, 7, 8, 9, 10, 11, 12, 13 };
+			s = t;
+			check(std::ranges::equal(s, t), "MAPPED copy assignment");
+		}
+		check(contents() == std::vector{ 4, 5, 6, 7, 8, 9, 10, 11, 12, 13 }, "MAPPED file after copy assignment");
+	});
+
+	// Move assignment takes the mapping of the other sequence, so the file keeps the elements it had.
+	attempt("MAPPED move assignment", [&]
+	{
+		{
+			S s(A(path.c_str()));
+			s = { 1, 2, 3 };
+			S t{ 7, 8 };
+			s = std::move(t);
+			check(std::ranges::equal(s, std::vector{ 7, 8 }), "MAPPED move assignment");
+		}
+		check(contents() == std::vector{ 1, 2, 3 }, "MAPPED file after move assignment");
+	});
+
+	// Shrinking cuts the mapping down in place.
+	attempt("MAPPED shrink_to_fit", [&]
+	{
+		{
+			S s(A(path.c_str()));
+			s.reserve(100);
+			s.resize(5, 6);
+			s.shrink_to_fit();
+			check(s.capacity() == 5 && std::ranges::equal(s, std::vector{ 6, 6, 6, 6, 6 }), "MAPPED shrink_to_fit");
+		}
+		check(contents() == std::vector{ 6, 6, 6, 6, 6 }, "MAPPED file after shrink_to_fit");
+	});
+
+	std::filesystem::remove(path);
+}
+
+#endif
+
+int main()
+{
+	life::quiet = true;
+
+	test_storage<St::STATIC>();
+	test_storage<St::FIXED>();
+	test_storage<St::VARIABLE>();
+	test_storage<St::BUFFERED>();
+	test_segmented();
+	test_alignment<St::STATIC>();
+	test_alignment<St::VARIABLE>();
+	test_soa_alignment();
+	test_pool_threads();
+	test_concurrent_ends<concurrent_sequence_lits::SPSC, St::STATIC>();
+	test_concurrent_ends<concurrent_sequence_lits::SPSC, St::FIXED>();
+	test_concurrent_ends<concurrent_sequence_lits::MPSC, St::STATIC>();
+	test_concurrent_ends<concurrent_sequence_lits::MPSC, St::FIXED>();
+	test_concurrent_producers();
+	test_concurrent_destroy<concurrent_sequence_lits::SPSC>();
+	test_concurrent_destroy<concurrent_sequence_lits::MPSC>();
+	test_removals<life>();
+	test_removals<int>();
+	test_serialize<sequence<int>>("contiguous");
+	test_serialize<sequence<int, sequence_traits{ .storage = St::STATIC, .location = Loc::CIRCULAR, .capacity = 16 }>>("CIRCULAR");
+	test_serialize<sequence<int, sequence_traits{ .storage = St::SEGMENTED, .capacity = 4 }>>("SEGMENTED");
+#if __has_include(<sys/mman.h>)
+	test_mapped<Loc::FRONT>();
+	test_mapped<Loc::BACK>();
+	test_mapped<Loc::MIDDLE>();
+	test_mapped<Loc::CIRCULAR>();
+#endif
+
+	if (failures)
+		std::println("{} checks failed", failures);
+	else
+		std::println("All checks passed");
+	return failures;
+}
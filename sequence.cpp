@@ -46,55 +46,37 @@ void show(const SEQ& seq)
 	std::println();
 }
 
-// foo - Instrumented debugging type for life cycle testing.
+// foo - Instrumented debugging type for exception safety testing. It is a life (so its operations are counted,
+// and shown unless a life_meter is in scope), but moving the value 86 throws, and its move constructor is not
+// noexcept.
 
 struct no_answers{};
 
-struct foo {
-	foo() : i(42) { std::println("  foo() {}", i); }
-	foo(int i) : i(i) { std::println("  foo(int) {}", i); }
-	foo(const foo& f) : i(f.i)
-	{
-		std::println("  foo(const foo&) {}", i);
-	}
-	foo(foo&& f) : i(f.i)
-	{
-		if (i == 86)
-		{
-			std::println("  foo(foo&&) BAD");
-			throw no_answers();
-		}
-		std::println("  foo(foo&&) {}", i);
-		f.i = 666;
-	}
-	~foo()
-	{
-		std::println("  ~foo {}", i);
-		i = 99999;
-	}
+struct foo : life
+{
+	using life::life;
+	foo(const foo&) = default;
+	foo(foo&& f) : life(checked(std::move(f), "  foo(foo&&) BAD")) {}
 
-	foo& operator=(const foo& f)
+	foo& operator=(const foo&) = default;
+	foo& operator=(foo&& f)
 	{
-		i = f.i;
-		std::println("  foo(const foo&) {}", i);
+		life::operator=(checked(std::move(f), "  op=(foo&&) BAD"));
 		return *this;
 	}
-	foo& operator=(foo&& f)
+
+private:
+
+	static foo&& checked(foo&& f, const char* what)
 	{
-		i = f.i;
-		if (i == 86)
+		if (f.i == 86)
 		{
-			std::println("  op=(foo&&) BAD");
+			if (!life::quiet)
+				std::println("{}", what);
 			throw no_answers();
 		}
-		std::println("  op=(foo&&) {}", i);
-		f.i = 666;
-		return *this;
+		return std::move(f);
 	}
-
-	operator int() const { return i; }
-
-	int i;
 };
 
 
@@ -133,6 +115,16 @@ void show_cap(const std::vector<T>& seq)
 	std::println();
 }
 
+// show_counts - Shows the life operations measured by a life_meter.
+
+void show_counts(const life_meter& meter)
+{
+	auto counts = meter();
+	std::println("{} ops:\t{} constructed, {} copied, {} moved, {} copy assigned, {} move assigned, {} destroyed",
+		counts.operations(), counts.constructions, counts.copies, counts.moves,
+		counts.copy_assignments, counts.move_assignments, counts.destructions);
+}
+
 template<typename T, long long CAP, std::unsigned_integral SIZE = size_t> requires ( CAP > 0 )
 using static_vector = sequence<T, sequence_traits<SIZE>{ .storage = sequence_storage_lits::STATIC, .capacity = CAP }>;
 
@@ -197,6 +189,14 @@ int main()
 	show_cap(x);
 	show_elems(x);
 
+	std::println("{:-^50}","counts");
+	{
+		life_meter meter;			// With room at the front, this is exactly one construction.
+		x.emplace_front(7);
+		show_counts(meter);
+	}
+	show_elems(x);
+
 //	v = std::move(w);
 /*
 	std::println("{:-^50}","w=v");